@@ -38,6 +38,49 @@ private Q_SLOTS:
         QCOMPARE(task.data.size(), data.size());
     }
 
+    void testInProcess()
+    {
+        KIO::ConnectionBackend server;
+        KIO::ConnectionBackend clientConnection;
+
+        QVERIFY(server.listenInProcess().success);
+        QCOMPARE(server.address.scheme(), QStringLiteral("thread"));
+        auto spy = std::make_unique<QSignalSpy>(&server, &KIO::ConnectionBackend::newConnection);
+        QVERIFY(clientConnection.connectToRemote(server.address));
+        QVERIFY(spy->wait());
+        auto serverConnection = std::unique_ptr<KIO::ConnectionBackend>(server.nextPendingConnection());
+        QVERIFY(serverConnection);
+        serverConnection->setSuspended(false);
+
+        // client -> server, event driven; the payload must not be copied
+        spy = std::make_unique<QSignalSpy>(serverConnection.get(), &KIO::ConnectionBackend::commandReceived);
+        constexpr auto cmd = 64;
+        const auto data = randomByteArray(clientConnection.StandardBufferSize * 4L);
+        QVERIFY(clientConnection.sendCommand(cmd, data));
+        QVERIFY(spy->wait());
+        auto task = spy->at(0).at(0).value<KIO::Task>();
+        QCOMPARE(task.cmd, cmd);
+        QCOMPARE(task.data, data);
+        QCOMPARE(task.data.constData(), data.constData());
+
+        // server -> client, polled like a worker does
+        spy = std::make_unique<QSignalSpy>(&clientConnection, &KIO::ConnectionBackend::commandReceived);
+        QVERIFY(serverConnection->sendCommand(cmd + 1, QByteArrayLiteral("reply")));
+        QVERIFY(clientConnection.waitForIncomingTask(1000));
+        QCOMPARE(spy->count(), 1);
+        QCOMPARE(spy->at(0).at(0).value<KIO::Task>().data, QByteArrayLiteral("reply"));
+
+        // the application end doesn't block, even if the worker doesn't read
+        const auto bigData = randomByteArray(KIO::ConnectionBackend::MaxQueuedBytes);
+        QVERIFY(serverConnection->sendCommand(cmd, bigData));
+        QVERIFY(serverConnection->sendCommand(cmd, bigData));
+
+        // closing one end disconnects the other
+        serverConnection.reset();
+        QVERIFY(!clientConnection.waitForIncomingTask(1000));
+        QVERIFY(clientConnection.state == KIO::ConnectionBackend::Idle);
+    }
+
 private:
     QByteArray randomByteArray(qsizetype size)
     {
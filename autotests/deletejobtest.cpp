@@ -8,6 +8,7 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QSignalSpy>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
@@ -81,6 +82,82 @@ void DeleteJobTest::deleteDirectoryTestCase()
     }
 }
 
+void DeleteJobTest::deleteTreeTestCase()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    // A few levels of subdirectories, with files and symlinks at each level.
+    // kio_file deletes recursively: it gets the whole tree in one go and
+    // removes it in several batches
+    const QString root = tempDir.path() + QLatin1String("/tree");
+    qulonglong entries = 0; // below root
+    QString dir = root;
+    for (int depth = 0; depth < 4; ++depth) {
+        for (int sub = 0; sub < 3; ++sub) {
+            const QString subDir = dir + QLatin1String("/dir") + QString::number(sub);
+            QVERIFY(QDir().mkpath(subDir));
+            createEmptyTestFiles({QStringLiteral("a.txt"), QStringLiteral("b.txt")}, subDir);
+            QVERIFY(QFile::link(subDir + QLatin1String("/a.txt"), subDir + QLatin1String("/link")));
+            entries += 4;
+        }
+        dir += QLatin1String("/dir0");
+    }
+
+    KIO::DeleteJob *job = KIO::del(QUrl::fromLocalFile(root), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+
+    QSignalSpy spy(job, &KJob::result);
+    QVERIFY(spy.isValid());
+    QVERIFY(spy.wait(100000));
+    QCOMPARE(job->error(), KJOB_NO_ERROR);
+    QVERIFY(!QDir(root).exists());
+    // The progress covers the whole tree, as reported by the worker
+    QCOMPARE(job->totalAmount(KJob::Items), entries);
+    QCOMPARE(job->processedAmount(KJob::Items), entries);
+    QCOMPARE(job->processedAmount(KJob::Directories), 1ULL);
+    QCOMPARE(job->percent(), 100UL);
+}
+
+void DeleteJobTest::deleteManyFilesTestCase()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    // Files and symlinks selected in two directories, removed by DeleteJob's IO worker
+    QList<QUrl> urls;
+    for (const QString &dirName : {QStringLiteral("a"), QStringLiteral("b")}) {
+        const QString dir = tempDir.path() + QLatin1Char('/') + dirName;
+        QVERIFY(QDir().mkpath(dir));
+        QStringList fileNames;
+        for (int i = 0; i < 50; ++i) {
+            fileNames.append(QString::number(i) + QLatin1String(".txt"));
+            urls.append(QUrl::fromLocalFile(dir + QLatin1Char('/') + fileNames.last()));
+        }
+        createEmptyTestFiles(fileNames, dir);
+        QVERIFY(QFile::link(dir + QLatin1String("/0.txt"), dir + QLatin1String("/link")));
+        urls.append(QUrl::fromLocalFile(dir + QLatin1String("/link")));
+    }
+
+    KIO::DeleteJob *job = KIO::del(urls, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+
+    // The progress shows the items being deleted, not their directory
+    QSignalSpy deletingSpy(job, &KIO::DeleteJob::deleting);
+    QSignalSpy spy(job, &KJob::result);
+    QVERIFY(spy.isValid());
+    QVERIFY(spy.wait(100000));
+    QCOMPARE(job->error(), KJOB_NO_ERROR);
+    for (const QList<QVariant> &args : std::as_const(deletingSpy)) {
+        QVERIFY(urls.contains(args.at(1).toUrl()));
+    }
+    for (const QUrl &url : std::as_const(urls)) {
+        QVERIFY(!QFileInfo::exists(url.toLocalFile()));
+    }
+    QCOMPARE(job->processedAmount(KJob::Files), qulonglong(urls.count()));
+    QVERIFY(QDir(tempDir.path() + QLatin1String("/a")).isEmpty());
+}
+
 void DeleteJobTest::createEmptyTestFiles(const QStringList &fileNames, const QString &path) const
 {
     QStringListIterator iterator(fileNames);
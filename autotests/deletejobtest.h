@@ -17,6 +17,8 @@ private Q_SLOTS:
     void deleteFileTestCase();
     void deleteDirectoryTestCase_data() const;
     void deleteDirectoryTestCase();
+    void deleteTreeTestCase();
+    void deleteManyFilesTestCase();
 
 private:
     void createEmptyTestFiles(const QStringList &fileNames, const QString &path) const;
@@ -5,12 +5,16 @@
 */
 
 #include <kio/copyjob.h>
+#include <kio/deletejob.h>
+#include <kio/listjob.h>
+#include <kio/statjob.h>
 #include <kio/storedtransferjob.h>
 
 #include <QBuffer>
 #include <QProcess>
 #include <QStandardPaths>
 #include <QTest>
+#include <QTimeZone>
 
 class FTPTest : public QObject
 {
@@ -27,13 +31,19 @@ public:
     QTemporaryDir m_remoteDir;
     QProcess m_daemonProc;
     QUrl m_url = QUrl("ftp://localhost");
+    // Whether the daemon supports MLST and MLSD, otherwise the worker uses LIST
+    const bool m_mlsx = qEnvironmentVariableIntValue("KIO_FTPTEST_MLSX") == 1;
 
 private Q_SLOTS:
-    static void runDaemon(QProcess &proc, QUrl &url, const QTemporaryDir &remoteDir)
+    static void runDaemon(QProcess &proc, QUrl &url, const QTemporaryDir &remoteDir, bool mlsx)
     {
         QVERIFY(remoteDir.isValid());
         proc.setProgram(RubyExe_EXECUTABLE);
-        proc.setArguments({QFINDTESTDATA("ftpd"), QStringLiteral("0"), remoteDir.path()});
+        QStringList arguments{QFINDTESTDATA("ftpd"), QStringLiteral("0"), remoteDir.path()};
+        if (mlsx) {
+            arguments << QStringLiteral("mlsx");
+        }
+        proc.setArguments(arguments);
         proc.setProcessChannelMode(QProcess::ForwardedOutputChannel);
         qDebug() << proc.arguments();
         proc.start();
@@ -66,7 +76,7 @@ private Q_SLOTS:
         qputenv("QT_PLUGIN_PATH", QCoreApplication::applicationDirPath().toUtf8());
 
         // Run ftpd to talk to.
-        runDaemon(m_daemonProc, m_url, m_remoteDir);
+        runDaemon(m_daemonProc, m_url, m_remoteDir, m_mlsx);
         // Once it's started we can simply forward the output. Possibly should do the
         // same for stdout so it has a prefix.
         connect(&m_daemonProc, &QProcess::readyReadStandardError, this, [this] {
@@ -215,6 +225,97 @@ private Q_SLOTS:
         QVERIFY(file.open(QFile::ReadOnly));
         QCOMPARE(file.readAll(), QByteArray("testOverwriteCopy1\n")); // not 2!
     }
+
+    void testMlsxFacts()
+    {
+        // The daemon advertises MLST in FEAT, so stat and listDir use MLST and MLSD
+        if (!m_mlsx) {
+            QSKIP("LIST has no seconds in its times, run with KIO_FTPTEST_MLSX=1");
+        }
+        const QString dirPath("/testMlsxFacts");
+        QVERIFY(QDir(m_remoteDir.path()).mkdir(dirPath.mid(1)));
+        const QString remotePath = m_remoteDir.path() + dirPath + "/file";
+        QFile file(remotePath);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("testMlsxFacts");
+        const QDateTime mtime(QDate(2024, 1, 2), QTime(3, 4, 5), QTimeZone::UTC);
+        QVERIFY(file.setFileTime(mtime, QFileDevice::FileModificationTime));
+        file.close();
+
+        auto statJob = KIO::stat(url(dirPath + "/file"), KIO::HideProgressInfo);
+        statJob->setUiDelegate(nullptr);
+        QVERIFY2(statJob->exec(), qUtf8Printable(statJob->errorString()));
+        const KIO::UDSEntry entry = statJob->statResult();
+        QVERIFY(!entry.isDir());
+        QCOMPARE(entry.numberValue(KIO::UDSEntry::UDS_SIZE), 13LL);
+        QCOMPARE(entry.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME), mtime.toSecsSinceEpoch());
+
+        KIO::UDSEntryList entries;
+        auto listJob = KIO::listDir(url(dirPath), KIO::HideProgressInfo);
+        listJob->setUiDelegate(nullptr);
+        connect(listJob, &KIO::ListJob::entries, this, [&entries](KIO::Job *, const KIO::UDSEntryList &list) {
+            entries += list;
+        });
+        QVERIFY2(listJob->exec(), qUtf8Printable(listJob->errorString()));
+        const auto it = std::find_if(entries.cbegin(), entries.cend(), [](const KIO::UDSEntry &listed) {
+            return listed.stringValue(KIO::UDSEntry::UDS_NAME) == QLatin1String("file");
+        });
+        QVERIFY(it != entries.cend());
+        QCOMPARE(it->numberValue(KIO::UDSEntry::UDS_SIZE), 13LL);
+        QCOMPARE(it->numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME), mtime.toSecsSinceEpoch());
+    }
+
+    void testStatFromListing()
+    {
+        // A stat right after listing the parent directory is answered from that listing
+        const QString dirPath("/testStatFromListing");
+        QVERIFY(QDir(m_remoteDir.path()).mkdir(dirPath.mid(1)));
+        QFile file(m_remoteDir.path() + dirPath + "/file");
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("testStatFromListing");
+        file.close();
+
+        auto listJob = KIO::listDir(url(dirPath), KIO::HideProgressInfo);
+        listJob->setUiDelegate(nullptr);
+        QVERIFY2(listJob->exec(), qUtf8Printable(listJob->errorString()));
+
+        // Removed behind the worker's back, so only the cached listing still knows it
+        QVERIFY(file.remove());
+
+        auto statJob = KIO::stat(url(dirPath + "/file"), KIO::HideProgressInfo);
+        statJob->setUiDelegate(nullptr);
+        QVERIFY2(statJob->exec(), qUtf8Printable(statJob->errorString()));
+        QCOMPARE(statJob->statResult().numberValue(KIO::UDSEntry::UDS_SIZE), 19LL);
+    }
+
+    void testListingInvalidatedByDelete()
+    {
+        // Changing a directory through the worker drops its cached listing
+        const QString dirPath("/testListingInvalidatedByDelete");
+        QVERIFY(QDir(m_remoteDir.path()).mkdir(dirPath.mid(1)));
+        for (const QString name : {QStringLiteral("a"), QStringLiteral("b")}) {
+            QFile file(m_remoteDir.path() + dirPath + QLatin1Char('/') + name);
+            QVERIFY(file.open(QFile::WriteOnly));
+        }
+
+        auto listJob = KIO::listDir(url(dirPath), KIO::HideProgressInfo);
+        listJob->setUiDelegate(nullptr);
+        QVERIFY2(listJob->exec(), qUtf8Printable(listJob->errorString()));
+
+        auto delJob = KIO::del(url(dirPath + "/a"), KIO::HideProgressInfo);
+        delJob->setUiDelegate(nullptr);
+        QVERIFY2(delJob->exec(), qUtf8Printable(delJob->errorString()));
+        QVERIFY(!QFile::exists(m_remoteDir.path() + dirPath + "/a"));
+
+        // Had the listing survived, "b" would still be found in it
+        QVERIFY(QFile::remove(m_remoteDir.path() + dirPath + "/b"));
+        for (const QString name : {QStringLiteral("a"), QStringLiteral("b")}) {
+            auto statJob = KIO::stat(url(dirPath + QLatin1Char('/') + name), KIO::HideProgressInfo);
+            statJob->setUiDelegate(nullptr);
+            QVERIFY(!statJob->exec());
+            QCOMPARE(statJob->error(), KIO::ERR_DOES_NOT_EXIST);
+        }
+    }
 };
 
 QTEST_MAIN(FTPTest)
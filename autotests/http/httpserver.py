@@ -137,6 +137,15 @@ def put_redirect_308():
     return redirect('/put/permanent_redirected', code=308)
 
 
+# foo -> foo/
+@app.route("/put/collection", methods = ['PUT'])
+def put_collection():
+    return redirect('/put/collection/', code=301)
+
+@app.route("/put/collection/", methods = ['PUT'])
+def put_collection_slash():
+    return request.data
+
 @app.route("/put/bla", methods = ['PUT'])
 def put_bla():
 
@@ -205,6 +214,61 @@ def verify_password(username, password):
 def index():
     return "Hello"
 
+auth_challenges = 0
+
+@auth.error_handler
+def auth_error(*args):
+    global auth_challenges
+    auth_challenges += 1
+    return "Unauthorized"
+
+@app.route("/auth/challenges", methods = ['GET'])
+def auth_challenges_sent():
+    return str(auth_challenges)
+
+auth_first_challenged = False
+
+# Asks for credentials once, even those sent by the request
+@app.route("/auth/challengefirst", methods = ['GET'])
+def auth_challenge_first():
+    global auth_first_challenged
+    credentials = request.authorization
+    if auth_first_challenged and credentials and verify_password(credentials.username, credentials.password):
+        return "Hello"
+    auth_first_challenged = True
+    return Response("Unauthorized", status=401, headers={'WWW-Authenticate': 'Basic realm="Authentication Required"'})
+
+@app.route("/public/authorization", methods = ['GET'])
+def public_authorization():
+    return request.headers.get('Authorization', '')
+
+# Cache
+
+cache_hits = {}
+
+@app.route("/cache/<name>", methods = ['GET'])
+def cache_entry(name):
+    cache_hits[name] = cache_hits.get(name, 0) + 1
+    etag = '"' + name + '-1"'
+    if request.headers.get('If-None-Match') == etag:
+        resp = Response(status=304)
+    else:
+        resp = Response("Cached " + name + "\n", mimetype='text/plain')
+    resp.headers['ETag'] = etag
+    resp.headers['Cache-Control'] = 'max-age=3600'
+    return resp
+
+@app.route("/cachehits/<name>", methods = ['GET'])
+def cache_hits_for(name):
+    return str(cache_hits.get(name, 0))
+
+@app.route('/auth/cached/<name>')
+@auth.login_required
+def auth_cached(name):
+    resp = Response("Secret " + name + "\n", mimetype='text/plain')
+    resp.headers['Cache-Control'] = 'max-age=3600'
+    return resp
+
 @app.route("/useragent/enforce")
 def useragent_enforce():
     ua = request.headers.get('User-Agent')
@@ -16,6 +16,9 @@ class PutTest : public QObject
 private Q_SLOTS:
     void testGet();
     void testGet_data();
+    void testStreamedPut();
+    void testStreamedPutSizeMismatch_data();
+    void testStreamedPutSizeMismatch();
 };
 
 void PutTest::testGet_data()
@@ -55,6 +58,62 @@ void PutTest::testGet()
     QCOMPARE(job->error(), KJob::NoError);
 }
 
+void PutTest::testStreamedPut()
+{
+    // With a known size the body is streamed, one chunk at a time
+    const QByteArray chunk(1024, 'x');
+    const int chunkCount = 64;
+    auto *job = KIO::put(QUrl(QStringLiteral("http://localhost:5000/put/bla")), -1, KIO::HideProgressInfo);
+    job->addMetaData(QStringLiteral("content-type"), QStringLiteral("text/html"));
+    job->addMetaData(QStringLiteral("size"), QString::number(chunk.size() * chunkCount));
+
+    int dataReqCounter = 0;
+    connect(job, &KIO::TransferJob::dataReq, this, [&chunk, &dataReqCounter](KJob * /*job*/, QByteArray &data) {
+        if (dataReqCounter < chunkCount) {
+            data = chunk;
+        }
+        dataReqCounter++;
+    });
+
+    QByteArray receivedData;
+    connect(job, &KIO::TransferJob::data, this, [&receivedData](KIO::Job * /*job*/, const QByteArray &data) {
+        receivedData += data;
+    });
+
+    QVERIFY(job->exec());
+    QCOMPARE(receivedData, chunk.repeated(chunkCount));
+}
+
+void PutTest::testStreamedPutSizeMismatch_data()
+{
+    QTest::addColumn<int>("announcedSize");
+
+    QTest::addRow("less data than announced") << 4096;
+    QTest::addRow("more data than announced") << 1024;
+}
+
+void PutTest::testStreamedPutSizeMismatch()
+{
+    QFETCH(int, announcedSize);
+
+    // The source changed since it was stat'ed: that's an error, not a truncated upload
+    const QByteArray chunk(1024, 'x');
+    auto *job = KIO::put(QUrl(QStringLiteral("http://localhost:5000/put/bla")), -1, KIO::HideProgressInfo);
+    job->addMetaData(QStringLiteral("content-type"), QStringLiteral("text/html"));
+    job->addMetaData(QStringLiteral("size"), QString::number(announcedSize));
+
+    int dataReqCounter = 0;
+    connect(job, &KIO::TransferJob::dataReq, this, [&chunk, &dataReqCounter](KJob * /*job*/, QByteArray &data) {
+        if (dataReqCounter < 2) {
+            data = chunk;
+        }
+        dataReqCounter++;
+    });
+
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), KIO::ERR_CANNOT_WRITE);
+}
+
 QTEST_GUILESS_MAIN(PutTest)
 
 #include "puttest.moc"
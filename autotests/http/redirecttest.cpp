@@ -28,6 +28,8 @@ private Q_SLOTS:
     void testRedirectPut_data();
     void testPermanentRedirectPut();
     void testPermanentRedirectPut_data();
+
+    void testTrailingSlashRedirectStreamedPut();
 };
 
 void RedirectTest::testRedirectGet_data()
@@ -301,6 +303,28 @@ void RedirectTest::testPermanentRedirectPut()
     QCOMPARE(actualData, expectedData);
 }
 
+void RedirectTest::testTrailingSlashRedirectStreamedPut()
+{
+    const QByteArray inputData("<p>Hello, World!</p>");
+    auto *job = KIO::put(QUrl(QStringLiteral("http://localhost:5000/put/collection")), -1, KIO::HideProgressInfo);
+    job->addMetaData(QStringLiteral("size"), QString::number(inputData.size()));
+
+    bool sent = false;
+    connect(job, &KIO::TransferJob::dataReq, this, [&inputData, &sent](KJob * /*job*/, QByteArray &data) {
+        if (!sent) {
+            data = inputData;
+            sent = true;
+        }
+    });
+
+    // The streamed body is gone by the time the foo -> foo/ redirect comes in:
+    // the job must fail rather than restart and send an empty body
+    QSignalSpy redirectSpy(job, &KIO::TransferJob::redirection);
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), KIO::ERR_CANNOT_WRITE);
+    QCOMPARE(redirectSpy.count(), 0);
+}
+
 QTEST_GUILESS_MAIN(RedirectTest)
 
 #include "redirecttest.moc"
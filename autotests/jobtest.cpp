@@ -18,6 +18,7 @@
 #include <kio/listjob.h>
 #include <kio/mimetypejob.h>
 #include <kio/statjob.h>
+#include <kio/statmultiplejob.h>
 #include <kio/storedtransferjob.h>
 #include <kmountpoint.h>
 #include <kprotocolinfo.h>
@@ -810,6 +811,51 @@ void JobTest::copyDirectoryToExistingDirectory()
     copyLocalDirectory(src, dest, AlreadyExists);
 }
 
+void JobTest::copyFilesInParallel()
+{
+    const QString src = homeTmpDir() + "parallelSrc";
+    const QString dest = homeTmpDir() + "parallelDest";
+    QVERIFY(QDir().mkpath(src));
+    QList<QUrl> srcUrls;
+    const int fileCount = 20;
+    for (int i = 0; i < fileCount; ++i) {
+        const QString filePath = src + "/file" + QString::number(i);
+        createTestFile(filePath);
+        srcUrls.append(QUrl::fromLocalFile(filePath));
+    }
+    QVERIFY(QDir().mkpath(dest));
+
+    KIO::CopyJob *job = KIO::copy(srcUrls, QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setMaxParallelTransfers(4);
+    QSignalSpy spyCopyingDone(job, &KIO::CopyJob::copyingDone);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(spyCopyingDone.count(), fileCount);
+    QCOMPARE(job->processedAmount(KJob::Files), fileCount);
+    for (int i = 0; i < fileCount; ++i) {
+        QVERIFY(QFileInfo(dest + "/file" + QString::number(i)).isFile());
+    }
+
+    // Again: every file conflicts now, and is skipped
+    job = KIO::copy(srcUrls, QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setMaxParallelTransfers(4);
+    job->setAutoSkip(true);
+    QSignalSpy spyCopyingDoneAgain(job, &KIO::CopyJob::copyingDone);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(spyCopyingDoneAgain.count(), 0);
+
+    // And without any way to resolve the conflict, the job fails
+    job = KIO::copy(srcUrls, QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setMaxParallelTransfers(4);
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), KIO::ERR_FILE_ALREADY_EXIST);
+}
+
 void JobTest::copyDirectoryToExistingSymlinkedDirectory()
 {
     // qDebug();
@@ -1422,6 +1468,77 @@ void JobTest::multipleListRecursive()
     QCOMPARE(joinedNames.toLatin1(), ref_names);
 }
 
+void JobTest::listRecursiveHidden()
+{
+    QTemporaryDir tempDir;
+    const QString src = tempDir.path();
+    QVERIFY(QDir().mkpath(src + "/dir/.hiddenDir"));
+    QVERIFY(QDir().mkpath(src + "/.hiddenTopDir"));
+    createTestFile(src + "/dir/file");
+    createTestFile(src + "/dir/.hiddenFile");
+    createTestFile(src + "/dir/.hiddenDir/file");
+    createTestFile(src + "/.hiddenTopDir/file");
+
+    auto listNames = [this, &src](KIO::ListJob::ListFlags listFlags) {
+        m_names.clear();
+        KIO::ListJob *job = KIO::listRecursive(QUrl::fromLocalFile(src), KIO::HideProgressInfo, listFlags);
+        job->setUiDelegate(nullptr);
+        connect(job, &KIO::ListJob::entries, this, &JobTest::slotEntries);
+        const bool ok = job->exec();
+        m_names.sort();
+        return ok ? m_names.join(QLatin1Char(',')) : job->errorString();
+    };
+
+    QCOMPARE(listNames(KIO::ListJob::ListFlags{}), QStringLiteral("dir,dir/file"));
+    QCOMPARE(listNames(KIO::ListJob::ListFlag::IncludeHidden),
+             QStringLiteral(".,..,.hiddenTopDir,.hiddenTopDir/file,dir,dir/.hiddenDir,dir/.hiddenDir/file,dir/.hiddenFile,dir/file"));
+}
+
+void JobTest::listRecursiveUnreadableDir()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Skipping unaccessible folder test on Windows, cannot remove all permissions from a folder");
+#endif
+    QTemporaryDir tempDir;
+    const QString src = tempDir.path();
+    QVERIFY(QDir().mkpath(src + "/dir/unreadable"));
+    createTestFile(src + "/dir/file");
+    createTestFile(src + "/dir/unreadable/file");
+    QFile(src + "/dir/unreadable").setPermissions(QFile::Permissions());
+    ScopedCleaner cleaner([&] {
+        QFile(src + "/dir/unreadable").setPermissions(QFile::Permissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+    });
+    if (QDir(src + "/dir/unreadable").isReadable()) {
+        QSKIP("Running as root, all folders are readable");
+    }
+
+    m_names.clear();
+    QStringList displayNames;
+    QList<QUrl> subErrorUrls;
+    KIO::ListJob *job = KIO::listRecursive(QUrl::fromLocalFile(src), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    connect(job, &KIO::ListJob::entries, this, &JobTest::slotEntries);
+    connect(job, &KIO::ListJob::entries, this, [&displayNames](KIO::Job *, const KIO::UDSEntryList &list) {
+        for (const KIO::UDSEntry &entry : list) {
+            if (entry.stringValue(KIO::UDSEntry::UDS_NAME).contains(QLatin1Char('/'))) {
+                displayNames.append(entry.stringValue(KIO::UDSEntry::UDS_DISPLAY_NAME));
+            }
+        }
+    });
+    connect(job, &KIO::ListJob::subError, this, [&subErrorUrls](KIO::ListJob *, KIO::ListJob *subJob) {
+        QCOMPARE(subJob->error(), int(KIO::ERR_CANNOT_ENTER_DIRECTORY));
+        subErrorUrls.append(subJob->url());
+    });
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    // The listing succeeds, the unreadable folder is reported like a failing sub-job
+    m_names.sort();
+    QCOMPARE(m_names.join(QLatin1Char(',')), QStringLiteral(".,..,dir,dir/file,dir/unreadable"));
+    QCOMPARE(subErrorUrls, QList<QUrl>{QUrl::fromLocalFile(src + "/dir/unreadable")});
+    displayNames.sort();
+    QCOMPARE(displayNames, (QStringList{"dir/file", "dir/unreadable"}));
+}
+
 void JobTest::listFile()
 {
     const QString filePath = homeTmpDir() + "fileFromHome";
@@ -1909,6 +2026,33 @@ void JobTest::statWithInode()
     }
 }
 
+void JobTest::statMultiple()
+{
+    const QString filePath = homeTmpDir() + "fileFromHome";
+    createTestFile(filePath);
+    const QString dirPath = homeTmpDir() + "dirFromHome";
+    createTestDirectory(dirPath);
+    const QList<QUrl> urls{QUrl::fromLocalFile(filePath), QUrl::fromLocalFile(homeTmpDir() + "doesNotExist"), QUrl::fromLocalFile(dirPath)};
+
+    KIO::StatMultipleJob *job = KIO::statMultiple(urls, KIO::StatJob::SourceSide, KIO::StatDefaultDetails, KIO::HideProgressInfo);
+    QSignalSpy spy(job, &KIO::StatMultipleJob::statResult);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(spy.count(), urls.count());
+
+    QCOMPARE(job->urls(), urls);
+    const QList<KIO::UDSEntry> entries = job->statResults();
+    const QList<int> errors = job->errors();
+    QCOMPARE(entries.count(), urls.count());
+    QCOMPARE(errors, QList<int>({0, KIO::ERR_DOES_NOT_EXIST, 0}));
+
+    QCOMPARE(entries.at(0).stringValue(KIO::UDSEntry::UDS_NAME), QStringLiteral("fileFromHome"));
+    QVERIFY(!entries.at(0).isDir());
+    QCOMPARE(entries.at(0).numberValue(KIO::UDSEntry::UDS_SIZE), QFileInfo(filePath).size());
+    QCOMPARE(entries.at(1).count(), 0);
+    QCOMPARE(entries.at(2).stringValue(KIO::UDSEntry::UDS_NAME), QStringLiteral("dirFromHome"));
+    QVERIFY(entries.at(2).isDir());
+}
+
 #ifndef Q_OS_WIN
 void JobTest::statSymlink()
 {
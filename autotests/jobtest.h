@@ -50,6 +50,7 @@ private Q_SLOTS:
     void testCopyFilePermissionsToSamePartition();
     void copyDirectoryToSamePartition();
     void copyDirectoryToExistingDirectory();
+    void copyFilesInParallel();
     void copyDirectoryToExistingSymlinkedDirectory();
     void copyFileToOtherPartition();
     void copyDirectoryToOtherPartition();
@@ -61,6 +62,8 @@ private Q_SLOTS:
     void suspendCopy();
     void listRecursive();
     void multipleListRecursive();
+    void listRecursiveHidden();
+    void listRecursiveUnreadableDir();
     void listFile();
     void killJob();
     void killJobBeforeStart();
@@ -89,6 +92,7 @@ private Q_SLOTS:
     void statDetailsBasic();
     void statDetailsBasicSetDetails();
     void statWithInode();
+    void statMultiple();
 #ifndef Q_OS_WIN
     void statSymlink();
     void statTimeResolution();
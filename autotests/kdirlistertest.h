@@ -103,6 +103,7 @@ private Q_SLOTS:
     void testWatchingAfterCopyJob();
     void testRemoveWatchedDirectory();
     void testDirPermissionChange();
+    void testUpdatesByName();
     void testCopyAfterListingAndMove(); // #353195
     void testRenameDirectory(); // #401552
     void testRequestMimeType();
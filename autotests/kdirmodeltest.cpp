@@ -5,6 +5,7 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 
+#include <algorithm>
 #include <array>
 
 #include "jobuidelegatefactory.h"
@@ -20,8 +21,12 @@
 
 #include <QDebug>
 #include <QMimeData>
+#include <QProxyStyle>
+#include <QStyleOption>
+#include <QTreeView>
 #include <QSignalSpy>
 #include <QUrl>
+#include <qplatformdefs.h>
 
 #ifdef Q_OS_UNIX
 #include <utime.h>
@@ -1421,12 +1426,20 @@ void KDirModelTest::testHasChildren()
         m_dirModel->fetchMore(index);
         return completedSpy.wait();
     };
+    // The directories that aren't listed are looked into in a thread
+    auto probedHasChildren = [this](const QModelIndex &index) {
+        m_dirModel->hasChildren(index);
+        QTest::qWaitFor([&]() {
+            return m_dirModel->data(index, KDirModel::ChildCountRole).toInt() != KDirModel::ChildCountUnknown;
+        });
+        return m_dirModel->hasChildren(index);
+    };
     // Now list subdir/
     QVERIFY(listDir(m_dirIndex));
 
     const QModelIndex subsubdirIndex = findDir(m_dirIndex, "subsubdir");
     QVERIFY(subsubdirIndex.isValid());
-    QCOMPARE(m_dirModel->hasChildren(subsubdirIndex), !dirsOnly);
+    QCOMPARE(probedHasChildren(subsubdirIndex), !dirsOnly);
 
     const QModelIndex hasChildrenDirIndex = findDir(m_dirIndex, "hasChildren");
     QVERIFY(hasChildrenDirIndex.isValid());
@@ -1437,28 +1450,125 @@ void KDirModelTest::testHasChildren()
 
     QModelIndex testDirIndex = findDir(hasChildrenDirIndex, "emptyDir");
     QVERIFY(testDirIndex.isValid());
-    QVERIFY(!m_dirModel->hasChildren(testDirIndex));
+    QVERIFY(!probedHasChildren(testDirIndex));
 
     testDirIndex = findDir(hasChildrenDirIndex, "hiddenfileDir");
     QVERIFY(testDirIndex.isValid());
-    QCOMPARE(m_dirModel->hasChildren(testDirIndex), !dirsOnly && withHidden);
+    QCOMPARE(probedHasChildren(testDirIndex), !dirsOnly && withHidden);
 
     testDirIndex = findDir(hasChildrenDirIndex, "hiddenDirDir");
     QVERIFY(testDirIndex.isValid());
-    QCOMPARE(m_dirModel->hasChildren(testDirIndex), withHidden);
+    QCOMPARE(probedHasChildren(testDirIndex), withHidden);
 
     testDirIndex = findDir(hasChildrenDirIndex, "pipeDir");
     QVERIFY(testDirIndex.isValid());
-    QCOMPARE(m_dirModel->hasChildren(testDirIndex), !dirsOnly);
+    QCOMPARE(probedHasChildren(testDirIndex), !dirsOnly);
 
     testDirIndex = findDir(hasChildrenDirIndex, "symlinkDir");
     QVERIFY(testDirIndex.isValid());
-    QCOMPARE(m_dirModel->hasChildren(testDirIndex), !dirsOnly);
+    QCOMPARE(probedHasChildren(testDirIndex), !dirsOnly);
 
     m_dirModel->dirLister()->setDirOnlyMode(false);
     m_dirModel->dirLister()->setShowHiddenFiles(false);
 }
 
+// Records which rows QTreeView draws with an expander
+class BranchRecordingStyle : public QProxyStyle
+{
+public:
+    void drawPrimitive(PrimitiveElement element, const QStyleOption *option, QPainter *painter, const QWidget *widget) const override
+    {
+        if (element == PE_IndicatorBranch && (option->state & State_Item)) {
+            m_branches.append({option->rect, bool(option->state & State_Children)});
+        }
+        QProxyStyle::drawPrimitive(element, option, painter, widget);
+    }
+
+    // Paints @p view and returns whether @p index was drawn with an expander
+    bool hasExpander(QTreeView *view, const QModelIndex &index) const
+    {
+        m_branches.clear();
+        view->grab();
+        const int y = view->visualRect(index).center().y();
+        return std::any_of(m_branches.cbegin(), m_branches.cend(), [y](const QPair<QRect, bool> &branch) {
+            return branch.second && branch.first.top() <= y && y <= branch.first.bottom();
+        });
+    }
+
+private:
+    mutable QList<QPair<QRect, bool>> m_branches;
+};
+
+void KDirModelTest::testChildCountRole()
+{
+    QTemporaryDir tempDir;
+    const QString path = tempDir.path() + "/dir";
+    createTestDirectory(path, Empty);
+    createTestFile(path + "/file");
+    createTestFile(path + "/.hidden");
+    createTestDirectory(path + "/subdir", Empty);
+
+    KDirModel dirModel;
+    QSignalSpy completedSpy(dirModel.dirLister(), qOverload<>(&KCoreDirLister::completed));
+    dirModel.openUrl(QUrl::fromLocalFile(tempDir.path()));
+    QVERIFY(completedSpy.wait());
+    const QModelIndex dirIndex = dirModel.indexForUrl(QUrl::fromLocalFile(path));
+    QVERIFY(dirIndex.isValid());
+
+    // Not listed, so the directory is read in a thread, then dataChanged is emitted
+    QSignalSpy dataChangedSpy(&dirModel, &QAbstractItemModel::dataChanged);
+    QCOMPARE(dirModel.data(dirIndex, KDirModel::ChildCountRole).toInt(), int(KDirModel::ChildCountUnknown));
+    QVERIFY(dirModel.hasChildren(dirIndex));
+    QVERIFY(dataChangedSpy.wait());
+    QCOMPARE(dataChangedSpy.at(0).at(0).value<QModelIndex>(), dirIndex);
+
+    QCOMPARE(dirModel.data(dirIndex, KDirModel::ChildCountRole).toInt(), 3);
+    QVERIFY(dirModel.hasChildren(dirIndex));
+    dirModel.dirLister()->setDirOnlyMode(true);
+    QVERIFY(dirModel.hasChildren(dirIndex));
+
+    // The result is reused, as long as the directory doesn't change
+    KDirModel otherDirModel;
+    QSignalSpy otherCompletedSpy(otherDirModel.dirLister(), qOverload<>(&KCoreDirLister::completed));
+    otherDirModel.openUrl(QUrl::fromLocalFile(tempDir.path()));
+    QVERIFY(otherCompletedSpy.wait());
+    QCOMPARE(otherDirModel.data(otherDirModel.indexForUrl(QUrl::fromLocalFile(path)), KDirModel::ChildCountRole).toInt(), 3);
+
+    // The expanders of a QTreeView follow the probes
+    QTemporaryDir viewTempDir;
+    createTestDirectory(viewTempDir.path() + "/empty", Empty);
+    createTestDirectory(viewTempDir.path() + "/full", Empty);
+    createTestFile(viewTempDir.path() + "/full/file");
+    KDirModel viewDirModel;
+    QSignalSpy viewCompletedSpy(viewDirModel.dirLister(), qOverload<>(&KCoreDirLister::completed));
+    viewDirModel.openUrl(QUrl::fromLocalFile(viewTempDir.path()));
+    QVERIFY(viewCompletedSpy.wait());
+    const QModelIndex emptyIndex = viewDirModel.indexForUrl(QUrl::fromLocalFile(viewTempDir.path() + "/empty"));
+    const QModelIndex fullIndex = viewDirModel.indexForUrl(QUrl::fromLocalFile(viewTempDir.path() + "/full"));
+    QVERIFY(emptyIndex.isValid());
+    QVERIFY(fullIndex.isValid());
+
+    BranchRecordingStyle style;
+    QTreeView view;
+    view.setStyle(&style);
+    view.resize(400, 300);
+    QSignalSpy viewDataChangedSpy(&viewDirModel, &QAbstractItemModel::dataChanged);
+    view.setModel(&viewDirModel);
+    // Laying the rows out asks for hasChildren(), which starts the probes
+    QVERIFY(style.hasExpander(&view, emptyIndex));
+    QVERIFY(style.hasExpander(&view, fullIndex));
+
+    // QTreeView only looks at hasChildren() again for a dataChanged of a single row, starting at column 0
+    auto rowChanged = [&viewDataChangedSpy](const QModelIndex &index) {
+        return std::any_of(viewDataChangedSpy.cbegin(), viewDataChangedSpy.cend(), [&index](const QList<QVariant> &args) {
+            return args.at(0).value<QModelIndex>() == index && args.at(1).value<QModelIndex>().row() == index.row();
+        });
+    };
+    QTRY_VERIFY(rowChanged(emptyIndex) && rowChanged(fullIndex));
+    QVERIFY(!style.hasExpander(&view, emptyIndex));
+    QVERIFY(style.hasExpander(&view, fullIndex));
+}
+
 void KDirModelTest::testInvalidUrl()
 {
     QSignalSpy completedSpy(m_dirModel->dirLister(), qOverload<>(&KCoreDirLister::completed));
@@ -1752,6 +1862,83 @@ void KDirModelTest::testDeleteCurrentDirectory()
     QVERIFY(!fileIndex.isValid());
 }
 
+// Adds @p count fake files to the directory @p dirUrl listed by @p model,
+// straight through the signals of its lister, without touching the disk
+static KFileItemList addFakeItems(KDirModel &model, const QUrl &dirUrl, int count)
+{
+    KFileItemList items;
+    items.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QUrl url = dirUrl;
+        url.setPath(dirUrl.path() + QLatin1String("/file_") + QString::number(i));
+        items.append(KFileItem(url, QStringLiteral("text/plain"), S_IFREG));
+    }
+    Q_EMIT model.dirLister()->itemsAdded(dirUrl, items);
+    return items;
+}
+
+void KDirModelTest::benchmarkDeleteManyItems()
+{
+    QTemporaryDir tempDir;
+    const QUrl dirUrl = QUrl::fromLocalFile(tempDir.path());
+    KDirModel model;
+    model.openUrl(dirUrl);
+    QTRY_VERIFY(model.dirLister()->isFinished());
+
+    const int count = 20000;
+    const KFileItemList items = addFakeItems(model, dirUrl, count);
+    QCOMPARE(model.rowCount(), count);
+
+    // Delete every other item: the worst case, with as many ranges of rows as deleted items
+    KFileItemList deletedItems;
+    for (int i = 0; i < count; i += 2) {
+        deletedItems.append(items.at(i));
+    }
+
+    QBENCHMARK_ONCE {
+        Q_EMIT model.dirLister()->itemsDeleted(deletedItems);
+    }
+
+    QCOMPARE(model.rowCount(), count / 2);
+    for (int i = 1; i < count; i += 2) {
+        QCOMPARE(model.indexForItem(items.at(i)).row(), i / 2);
+    }
+}
+
+void KDirModelTest::benchmarkRefreshManyItems()
+{
+    QTemporaryDir tempDir;
+    const QUrl dirUrl = QUrl::fromLocalFile(tempDir.path());
+    KDirModel model;
+    model.openUrl(dirUrl);
+    QTRY_VERIFY(model.dirLister()->isFinished());
+
+    const int count = 20000;
+    const KFileItemList items = addFakeItems(model, dirUrl, count);
+
+    // Refresh all the items, every tenth file becoming a directory, which replaces its node
+    QList<QPair<KFileItem, KFileItem>> refreshedItems;
+    refreshedItems.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const bool isDir = i % 10 == 0;
+        const KFileItem &oldItem = items.at(i);
+        refreshedItems.append({oldItem, KFileItem(oldItem.url(), isDir ? QStringLiteral("inode/directory") : QStringLiteral("text/plain"), isDir ? S_IFDIR : S_IFREG)});
+    }
+
+    QSignalSpy spyDataChanged(&model, &QAbstractItemModel::dataChanged);
+    QBENCHMARK_ONCE {
+        Q_EMIT model.dirLister()->refreshItems(refreshedItems);
+    }
+
+    QCOMPARE(spyDataChanged.count(), 1);
+    QCOMPARE(model.rowCount(), count);
+    for (int i = 0; i < count; ++i) {
+        const QModelIndex index = model.indexForItem(items.at(i));
+        QCOMPARE(index.row(), i);
+        QCOMPARE(model.itemForIndex(index).isDir(), i % 10 == 0);
+    }
+}
+
 void KDirModelTest::testQUrlHash()
 {
     const int count = 3000;
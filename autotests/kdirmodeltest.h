@@ -64,6 +64,7 @@ private Q_SLOTS:
     void testShowRootAndExpandToUrl();
     void testHasChildren_data();
     void testHasChildren();
+    void testChildCountRole();
     void testInvalidUrl();
 
     // These tests must be done last
@@ -75,6 +76,10 @@ private Q_SLOTS:
     void testDeleteDirectory();
     void testDeleteCurrentDirectory();
 
+    // With a model of their own, filled with fake items
+    void benchmarkDeleteManyItems();
+    void benchmarkRefreshManyItems();
+
     // Somewhat unrelated
     void testQUrlHash();
 
@@ -7,10 +7,15 @@
 #include "kmountpointtest.h"
 
 #include "kmountpoint.h"
+#include "kmountpoint_p.h"
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QTest>
 #include <qplatformdefs.h>
 
+#include <algorithm>
+
 QTEST_MAIN(KMountPointTest)
 
 void KMountPointTest::initTestCase()
@@ -134,6 +139,87 @@ void KMountPointTest::testCurrentMountPointOptions()
     }
 }
 
+// What KMountPoint::List::findByPath() does, by looking at each mount point in turn
+static KMountPoint::Ptr scanByPath(const KMountPoint::List &mountPoints, const QString &path)
+{
+    const QFileInfo fileInfo(path);
+    const QString realPath = fileInfo.exists() ? fileInfo.canonicalFilePath() : fileInfo.absolutePath();
+    QT_STATBUF buff;
+    if (QT_LSTAT(QFile::encodeName(realPath).constData(), &buff) != 0) {
+        return KMountPoint::Ptr();
+    }
+    for (const KMountPoint::Ptr &mountPoint : mountPoints) {
+        if (mountPoint->deviceId() == buff.st_dev && realPath.startsWith(mountPoint->mountPoint())) {
+            return mountPoint;
+        }
+    }
+    return KMountPoint::Ptr();
+}
+
+// What KMountPoint::List::findByDevice() does, by looking at each mount point in turn
+static KMountPoint::Ptr scanByDevice(const KMountPoint::List &mountPoints, const QString &device)
+{
+    const QString realDevice = QFileInfo(device).canonicalFilePath();
+    if (realDevice.isEmpty()) {
+        return KMountPoint::Ptr();
+    }
+    for (const KMountPoint::Ptr &mountPoint : mountPoints) {
+        if (realDevice == mountPoint->realDeviceName() || realDevice == mountPoint->mountedFrom()) {
+            return mountPoint;
+        }
+    }
+    return KMountPoint::Ptr();
+}
+
+void KMountPointTest::testCurrentMountPointsCache()
+{
+    if (!_invalidateMountTableCache()) {
+        QSKIP("The mount table isn't cached on this system");
+    }
+    const KMountPoint::List mountPoints = KMountPoint::currentMountPoints();
+    if (mountPoints.isEmpty()) { // can happen in chroot jails
+        QSKIP("mtab is empty");
+    }
+    const bool hasGvfs = std::any_of(mountPoints.cbegin(), mountPoints.cend(), [](const KMountPoint::Ptr &mountPoint) {
+        return mountPoint->mountedFrom() == QLatin1String("gvfsd-fuse");
+    });
+    if (hasGvfs) {
+        QSKIP("The gvfs mounts are resolved by each call");
+    }
+
+    // Without any mount in between, all the callers share the same table
+    QCOMPARE(KMountPoint::currentMountPoints().constData(), mountPoints.constData());
+    // ... one per set of details
+    const KMountPoint::List withDevices = KMountPoint::currentMountPoints(KMountPoint::NeedRealDeviceName);
+    QVERIFY(withDevices.constData() != mountPoints.constData());
+    QCOMPARE(KMountPoint::currentMountPoints(KMountPoint::NeedRealDeviceName).constData(), withDevices.constData());
+
+    // Once invalidated, the table is read again
+    QVERIFY(_invalidateMountTableCache());
+    const KMountPoint::List rebuilt = KMountPoint::currentMountPoints();
+    QVERIFY(rebuilt.constData() != mountPoints.constData());
+    QCOMPARE(rebuilt.size(), mountPoints.size());
+    QVERIFY(rebuilt.first().data() != mountPoints.first().data());
+    for (int i = 0; i < rebuilt.size(); ++i) {
+        QCOMPARE(rebuilt.at(i)->mountPoint(), mountPoints.at(i)->mountPoint());
+    }
+    QCOMPARE(KMountPoint::currentMountPoints().constData(), rebuilt.constData());
+
+    // Looking up the cached table gives what looking at each mount point gives
+    QStringList paths{QStringLiteral("/"), QDir::homePath(), QDir::tempPath(), QStringLiteral("/proc/self")};
+    for (const KMountPoint::Ptr &mountPoint : rebuilt) {
+        paths.append(mountPoint->mountPoint());
+    }
+    for (const QString &path : std::as_const(paths)) {
+        QCOMPARE(rebuilt.findByPath(path).data(), scanByPath(rebuilt, path).data());
+    }
+    for (const KMountPoint::Ptr &mountPoint : withDevices) {
+        for (const QString &device : {mountPoint->realDeviceName(), mountPoint->mountedFrom()}) {
+            QCOMPARE(withDevices.findByDevice(device).data(), scanByDevice(withDevices, device).data());
+        }
+    }
+}
+
 void KMountPointTest::testPossibleMountPoints()
 {
     const KMountPoint::List mountPoints = KMountPoint::possibleMountPoints(KMountPoint::NeedRealDeviceName | KMountPoint::NeedMountOptions);
@@ -17,6 +17,7 @@ private Q_SLOTS:
 
     void testCurrentMountPoints();
     void testCurrentMountPointOptions();
+    void testCurrentMountPointsCache();
     void testPossibleMountPoints();
 
 private:
@@ -13,6 +13,8 @@
 #include <QTemporaryDir>
 #include <QTest>
 
+#include <algorithm>
+
 QTEST_MAIN(ListDirTest)
 
 void ListDirTest::numFilesTestCase_data()
@@ -45,6 +47,78 @@ void ListDirTest::numFilesTestCase()
     QCOMPARE(m_receivedEntryCount, numOfFiles);
 }
 
+// Lists @p url with the given number of stat threads in kio_file, entries sorted by name
+static QList<KIO::UDSEntry> listWithStatThreads(const QUrl &url, bool recursive, int statThreads)
+{
+    KIO::ListJob *job = recursive ? KIO::listRecursive(url, KIO::HideProgressInfo) : KIO::listDir(url, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->addMetaData(QStringLiteral("ListStatThreads"), QString::number(statThreads));
+    QList<KIO::UDSEntry> entries;
+    QObject::connect(job, &KIO::ListJob::entries, job, [&entries](KIO::Job *, const KIO::UDSEntryList &list) {
+        entries += list;
+    });
+    if (!job->exec()) {
+        return {};
+    }
+    std::sort(entries.begin(), entries.end(), [](const KIO::UDSEntry &a, const KIO::UDSEntry &b) {
+        return a.stringValue(KIO::UDSEntry::UDS_NAME) < b.stringValue(KIO::UDSEntry::UDS_NAME);
+    });
+    return entries;
+}
+
+void ListDirTest::statThreadsTestCase_data()
+{
+    QTest::addColumn<bool>("recursive");
+    QTest::newRow("listDir") << false;
+    QTest::newRow("listRecursive") << true;
+}
+
+void ListDirTest::statThreadsTestCase()
+{
+    QFETCH(bool, recursive);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.path();
+    createEmptyTestFiles(200, path);
+    QVERIFY(QDir(path).mkpath(QStringLiteral("subdir/subsubdir")));
+    createEmptyTestFiles(50, path + QLatin1String("/subdir"));
+    QVERIFY(QFile::link(path + QLatin1String("/0.txt"), path + QLatin1String("/link")));
+    QVERIFY(QFile::link(path + QLatin1String("/missing"), path + QLatin1String("/subdir/brokenlink")));
+
+    // One thread doesn't use the thread pool at all, four do
+    const QUrl url = QUrl::fromLocalFile(path);
+    const QList<KIO::UDSEntry> serialEntries = listWithStatThreads(url, recursive, 1);
+    const QList<KIO::UDSEntry> pooledEntries = listWithStatThreads(url, recursive, 4);
+    const auto countRealEntries = [](const QList<KIO::UDSEntry> &entries) {
+        return int(std::count_if(entries.cbegin(), entries.cend(), [](const KIO::UDSEntry &entry) {
+            const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME).section(QLatin1Char('/'), -1);
+            return name != QLatin1String(".") && name != QLatin1String("..");
+        }));
+    };
+    QCOMPARE(countRealEntries(serialEntries), recursive ? 200 + 2 + 50 + 2 : 200 + 2);
+    QCOMPARE(pooledEntries.count(), serialEntries.count());
+
+    for (int i = 0; i < serialEntries.count(); ++i) {
+        const KIO::UDSEntry &serial = serialEntries.at(i);
+        const KIO::UDSEntry &pooled = pooledEntries.at(i);
+        QCOMPARE(pooled.stringValue(KIO::UDSEntry::UDS_NAME), serial.stringValue(KIO::UDSEntry::UDS_NAME));
+        // The listing could update the access time of the directories
+        const QList<uint> fields = serial.fields();
+        QCOMPARE(pooled.fields(), fields);
+        for (uint field : fields) {
+            if (field == KIO::UDSEntry::UDS_ACCESS_TIME) {
+                continue;
+            }
+            if (field & KIO::UDSEntry::UDS_STRING) {
+                QCOMPARE(pooled.stringValue(field), serial.stringValue(field));
+            } else {
+                QCOMPARE(pooled.numberValue(field), serial.numberValue(field));
+            }
+        }
+    }
+}
+
 void ListDirTest::slotEntries(KIO::Job *, const KIO::UDSEntryList &entries)
 {
     m_receivedEntryCount += entries.count();
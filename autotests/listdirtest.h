@@ -21,6 +21,8 @@ class ListDirTest : public QObject
 private Q_SLOTS:
     void numFilesTestCase_data();
     void numFilesTestCase();
+    void statThreadsTestCase_data();
+    void statThreadsTestCase();
 
     void slotEntries(KIO::Job *job, const KIO::UDSEntryList &entries);
 
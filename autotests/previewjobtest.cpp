@@ -0,0 +1,231 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KIO/PreviewJob>
+
+#include <QColor>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <sys/stat.h>
+
+// Not handled by any thumbnailer plugin, so that the ones of the test are used
+static const char s_mimeType[] = "application/x-zerosize";
+// Handled by the thumbnail worker of the test, see thumbnail/thumbnailworker.cpp
+static const char s_workerMimeType[] = "application/x-trash";
+
+class PreviewJobTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void testEmitInOrder();
+    void testRemoveItemWhileRunning();
+    void testThumbnailWorkerBuffers();
+
+private:
+    // Creates a file that the thumbnailer of the test takes @p delay seconds to create
+    // a thumbnail for, or fails for if @p delay is "fail"
+    KFileItem createItem(const QString &name, const QByteArray &delay, const char *mimeType = s_mimeType);
+    static bool isStarted(const KFileItem &item);
+    static bool isDone(const KFileItem &item);
+
+    QTemporaryDir m_tempDir;
+    QString m_thumbnailerPath;
+    const QStringList m_plugins{QStringLiteral("kiopreviewjobtest")};
+};
+
+void PreviewJobTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_tempDir.isValid());
+
+    // Use the thumbnail worker and plugin of the test rather than those of kio-extras
+    QCoreApplication::addLibraryPath(QStringLiteral(PREVIEWJOBTEST_PLUGIN_DIR));
+
+    QImage thumbnail(16, 16, QImage::Format_ARGB32);
+    thumbnail.fill(Qt::red);
+    QVERIFY(thumbnail.save(m_tempDir.filePath(QStringLiteral("thumbnail.png"))));
+
+    // The thumbnailer notes when it starts and when it is done, next to the file
+    QFile script(m_tempDir.filePath(QStringLiteral("thumbnailer.sh")));
+    QVERIFY(script.open(QIODevice::WriteOnly));
+    script.write(
+        "touch \"$1.started\"\n"
+        "delay=$(cat \"$1\")\n"
+        "if [ \"$delay\" = fail ]; then exit 1; fi\n"
+        "sleep \"$delay\"\n"
+        "cp \""
+        + QFile::encodeName(m_tempDir.filePath(QStringLiteral("thumbnail.png")))
+        + "\" \"$2\"\n"
+          "touch \"$1.done\"\n");
+    script.close();
+
+    const QString thumbnailersDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/thumbnailers");
+    QVERIFY(QDir().mkpath(thumbnailersDir));
+    m_thumbnailerPath = thumbnailersDir + QLatin1String("/kiopreviewjobtest.thumbnailer");
+    QFile thumbnailer(m_thumbnailerPath);
+    QVERIFY(thumbnailer.open(QIODevice::WriteOnly));
+    thumbnailer.write(
+        "[Thumbnailer Entry]\n"
+        "Exec=sh \""
+        + QFile::encodeName(script.fileName())
+        + "\" %i %o\n"
+          "MimeType="
+        + s_mimeType + ";\n");
+}
+
+void PreviewJobTest::cleanupTestCase()
+{
+    QFile::remove(m_thumbnailerPath);
+}
+
+KFileItem PreviewJobTest::createItem(const QString &name, const QByteArray &delay, const char *mimeType)
+{
+    const QString path = m_tempDir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return KFileItem();
+    }
+    file.write(delay);
+    return KFileItem(QUrl::fromLocalFile(path), QString::fromLatin1(mimeType), S_IFREG);
+}
+
+bool PreviewJobTest::isStarted(const KFileItem &item)
+{
+    return QFile::exists(item.localPath() + QLatin1String(".started"));
+}
+
+bool PreviewJobTest::isDone(const KFileItem &item)
+{
+    return QFile::exists(item.localPath() + QLatin1String(".done"));
+}
+
+void PreviewJobTest::testEmitInOrder()
+{
+    const KFileItem slow = createItem(QStringLiteral("inorder-slow"), "1");
+    const KFileItem failing = createItem(QStringLiteral("inorder-failing"), "fail");
+    const KFileItem fast = createItem(QStringLiteral("inorder-fast"), "0");
+    const KFileItem medium = createItem(QStringLiteral("inorder-medium"), "0.3");
+    const KFileItemList items{slow, failing, fast, medium};
+
+    auto *job = KIO::filePreview(items, QSize(64, 64), &m_plugins);
+    job->setScaleType(KIO::PreviewJob::Scaled);
+    job->setMaximumParallelItems(items.count());
+    job->setEmitInOrder();
+
+    QList<QUrl> emitted;
+    QList<QUrl> failures;
+    bool othersDoneFirst = false;
+    connect(job, &KIO::PreviewJob::gotPreview, this, [&](const KFileItem &item, const QPixmap &preview) {
+        emitted.append(item.url());
+        if (!preview.isNull() && item == slow) {
+            // The items after the slow one were processed alongside it, yet they wait for it
+            othersDoneFirst = isDone(fast) && isDone(medium);
+        }
+    });
+    connect(job, &KIO::PreviewJob::failed, this, [&](const KFileItem &item) {
+        emitted.append(item.url());
+        failures.append(item.url());
+    });
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    QCOMPARE(emitted, items.urlList());
+    QCOMPARE(failures, QList<QUrl>{failing.url()});
+    QVERIFY(othersDoneFirst);
+}
+
+void PreviewJobTest::testRemoveItemWhileRunning()
+{
+    const KFileItem first = createItem(QStringLiteral("remove-first"), "0.2");
+    const KFileItem removed = createItem(QStringLiteral("remove-removed"), "10");
+    const KFileItem third = createItem(QStringLiteral("remove-third"), "0.2");
+    const KFileItem queued = createItem(QStringLiteral("remove-queued"), "0");
+    const KFileItemList items{first, removed, third, queued};
+
+    auto *job = KIO::filePreview(items, QSize(64, 64), &m_plugins);
+    job->setScaleType(KIO::PreviewJob::Scaled);
+    job->setMaximumParallelItems(3);
+    job->setEmitInOrder();
+
+    QList<QUrl> emitted;
+    QList<QUrl> failures;
+    int error = -1;
+    connect(job, &KIO::PreviewJob::gotPreview, this, [&](const KFileItem &item) {
+        emitted.append(item.url());
+    });
+    connect(job, &KIO::PreviewJob::failed, this, [&](const KFileItem &item) {
+        emitted.append(item.url());
+        failures.append(item.url());
+    });
+    connect(job, &KJob::result, this, [&](KJob *finishedJob) {
+        error = finishedJob->error();
+    });
+
+    QTRY_VERIFY(isStarted(removed));
+    job->removeItem(removed.url());
+
+    // Its thumbnailer was stopped, so the job is done long before it would have been
+    QTRY_COMPARE_WITH_TIMEOUT(error, 0, 8000);
+    QVERIFY(!isDone(removed));
+    // Like a failure, in its turn
+    QCOMPARE(emitted, (QList<QUrl>{first.url(), removed.url(), third.url(), queued.url()}));
+    QCOMPARE(failures, QList<QUrl>{removed.url()});
+}
+
+void PreviewJobTest::testThumbnailWorkerBuffers()
+{
+    const QStringList plugins{QStringLiteral("thumbnailtestcreator")};
+    const QColor sent(Qt::red);
+    const QColor inSegment(Qt::green);
+    const QColor inMemfd(Qt::blue);
+
+    auto createPreviews = [&](const QString &prefix) {
+        KFileItemList items;
+        for (int i = 0; i < 3; ++i) {
+            items.append(createItem(prefix + QString::number(i), "0", s_workerMimeType));
+        }
+        auto *job = KIO::filePreview(items, QSize(64, 64), &plugins);
+        job->setScaleType(KIO::PreviewJob::Scaled);
+        // One after the other, each one reusing the buffer of the previous one
+        job->setMaximumParallelItems(1);
+        QList<QColor> colors;
+        connect(job, &KIO::PreviewJob::gotPreview, this, [&colors](const KFileItem &, const QPixmap &preview) {
+            colors.append(preview.toImage().pixelColor(0, 0));
+        });
+        if (!job->exec()) {
+            qWarning() << job->errorString();
+        }
+        return colors;
+    };
+
+    // SysV segments are used until the worker says it takes memfds. It only writes
+    // into memfds sealed against resizing, and fails to shrink them
+    QList<QColor> colors = createPreviews(QStringLiteral("buffers-first-"));
+    QCOMPARE(colors.size(), 3);
+    QVERIFY2(colors.at(0) == inSegment || colors.at(0) == sent, qPrintable(colors.at(0).name()));
+#ifdef Q_OS_LINUX
+    QCOMPARE(colors.at(1), inMemfd);
+    QCOMPARE(colors.at(2), inMemfd);
+
+    // Known for the whole process
+    colors = createPreviews(QStringLiteral("buffers-second-"));
+    QCOMPARE(colors, (QList<QColor>{inMemfd, inMemfd, inMemfd}));
+#endif
+}
+
+QTEST_MAIN(PreviewJobTest)
+
+#include "previewjobtest.moc"
@@ -0,0 +1,16 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QObject>
+
+// Only the metadata is used: the thumbnail worker of the test creates the thumbnails itself
+class ThumbCreatorForMetaData : public QObject
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.KPluginFactory" FILE "thumbcreator.json")
+};
+
+#include "thumbcreator.moc"
@@ -0,0 +1,154 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// A thumbnail worker taking SysV segments and memfds like the one of kio-extras,
+// see "shmid" and "memfd" in docs/metadata.txt. Its thumbnails are filled with a color
+// telling how they were handed over: red when sent, green in a SysV segment, blue in a memfd.
+
+#include <KIO/WorkerBase>
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QImage>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../src/sharefd_p.h"
+
+class KIOPluginForMetaData : public QObject
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.kio.worker.thumbnail" FILE "thumbnailworker.json")
+};
+
+class ThumbnailWorker : public KIO::WorkerBase
+{
+public:
+    ThumbnailWorker(const QByteArray &pool, const QByteArray &app)
+        : WorkerBase("thumbnail", pool, app)
+    {
+    }
+
+    KIO::WorkerResult get(const QUrl &url) override;
+
+private:
+    // Returns the memfd handed over on the local socket at @p path, or -1
+    static int receiveMemfd(const QString &path);
+    static bool writeToMemfd(int memfd, const QImage &image);
+    static bool writeToSegment(int shmid, const QImage &image);
+};
+
+extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kio_thumbnailtest"));
+
+    ThumbnailWorker worker(argv[2], argv[3]);
+    worker.dispatchLoop();
+    return 0;
+}
+
+KIO::WorkerResult ThumbnailWorker::get(const QUrl &url)
+{
+    Q_UNUSED(url)
+    QImage image(metaData(QStringLiteral("width")).toInt(), metaData(QStringLiteral("height")).toInt(), QImage::Format_ARGB32);
+    if (image.isNull()) {
+        return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, QStringLiteral("No thumbnail size"));
+    }
+
+    bool written = false;
+    const QString memfdSocket = metaData(QStringLiteral("memfd"));
+    if (!memfdSocket.isEmpty()) {
+        const int memfd = receiveMemfd(memfdSocket);
+        if (memfd != -1) {
+            image.fill(Qt::blue);
+            written = writeToMemfd(memfd, image);
+            ::close(memfd);
+        }
+    } else if (hasMetaData(QStringLiteral("shmid"))) {
+        image.fill(Qt::green);
+        written = writeToSegment(metaData(QStringLiteral("shmid")).toInt(), image);
+    }
+
+    QByteArray imageData;
+    QDataStream stream(&imageData, QIODevice::WriteOnly);
+    if (written) {
+        stream << image.width() << image.height() << image.format() << image.devicePixelRatio();
+    } else {
+        image.fill(Qt::red);
+        stream << image;
+    }
+    // Says it takes memfds, unless it was given one it couldn't use
+    if (memfdSocket.isEmpty() || written) {
+        setMetaData(QStringLiteral("memfd"), QStringLiteral("1"));
+    }
+    data(imageData);
+    return KIO::WorkerResult::pass();
+}
+
+int ThumbnailWorker::receiveMemfd(const QString &path)
+{
+    const SocketAddress addr(QFile::encodeName(path).toStdString());
+    if (!addr.address()) {
+        return -1;
+    }
+    const int socketDes = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socketDes == -1) {
+        return -1;
+    }
+    int memfd = -1;
+    if (::connect(socketDes, addr.address(), addr.length()) == 0) {
+        FDMessageHeader msg;
+        if (::recvmsg(socketDes, msg.message(), 0) == 2 && msg.cmsgHeader()) {
+            ::memcpy(&memfd, CMSG_DATA(msg.cmsgHeader()), sizeof memfd);
+        }
+    }
+    ::close(socketDes);
+    return memfd;
+}
+
+bool ThumbnailWorker::writeToMemfd(int memfd, const QImage &image)
+{
+    // PreviewJob maps it at its size, it must not be resizable from here
+    const int seals = ::fcntl(memfd, F_GET_SEALS);
+    if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW) || ::ftruncate(memfd, 0) == 0) {
+        return false;
+    }
+    struct stat buff;
+    if (::fstat(memfd, &buff) != 0 || buff.st_size < image.sizeInBytes()) {
+        return false;
+    }
+    void *addr = ::mmap(nullptr, image.sizeInBytes(), PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    ::memcpy(addr, image.constBits(), image.sizeInBytes());
+    ::munmap(addr, image.sizeInBytes());
+    return true;
+}
+
+bool ThumbnailWorker::writeToSegment(int shmid, const QImage &image)
+{
+    shmid_ds info;
+    if (::shmctl(shmid, IPC_STAT, &info) != 0 || info.shm_segsz < size_t(image.sizeInBytes())) {
+        return false;
+    }
+    void *addr = ::shmat(shmid, nullptr, 0);
+    if (addr == reinterpret_cast<void *>(-1)) {
+        return false;
+    }
+    ::memcpy(addr, image.constBits(), image.sizeInBytes());
+    ::shmdt(addr);
+    return true;
+}
+
+#include "thumbnailworker.moc"
@@ -42,18 +42,21 @@ private Q_SLOTS:
     void testAnotherV2Fill();
     void testTwoVectorsFill();
     void testUDSEntryHSFill();
+    void testSlotsFill();
 
     void testAnotherCompare();
     void testTwoVectorKindEntryCompare();
     void testAnotherV2Compare();
     void testTwoVectorsCompare();
     void testUDSEntryHSCompare();
+    void testSlotsCompare();
 
     void testAnotherApp();
     void testTwoVectorKindEntryApp();
     void testAnotherV2App();
     void testTwoVectorsApp();
     void testUDSEntryHSApp();
+    void testSlotsApp();
 
     void testspaceUsed();
 
@@ -553,6 +556,157 @@ public:
 };
 Q_DECLARE_TYPEINFO(TwoVectorKindEntry, Q_MOVABLE_TYPE);
 
+// Fixed slots for the fields kio_file always sets, and a vector for the others
+// KF 6.10
+class SlotsUDSEntry
+{
+private:
+    // Same layout as UDSEntryPrivate
+    enum Slot {
+        NameSlot,
+        UserSlot,
+        GroupSlot,
+        LinkDestSlot,
+        SizeSlot,
+        FileTypeSlot,
+        AccessSlot,
+        ModificationTimeSlot,
+        AccessTimeSlot,
+        CreationTimeSlot,
+        LocalUserIdSlot,
+        LocalGroupIdSlot,
+        DeviceIdSlot,
+        InodeSlot,
+        SlotCount,
+        FirstNumberSlot = SizeSlot,
+    };
+    static int slotOf(uint udsField)
+    {
+        switch (udsField) {
+        case KIO::UDSEntry::UDS_NAME:
+            return NameSlot;
+        case KIO::UDSEntry::UDS_USER:
+            return UserSlot;
+        case KIO::UDSEntry::UDS_GROUP:
+            return GroupSlot;
+        case KIO::UDSEntry::UDS_LINK_DEST:
+            return LinkDestSlot;
+        case KIO::UDSEntry::UDS_SIZE:
+            return SizeSlot;
+        case KIO::UDSEntry::UDS_FILE_TYPE:
+            return FileTypeSlot;
+        case KIO::UDSEntry::UDS_ACCESS:
+            return AccessSlot;
+        case KIO::UDSEntry::UDS_MODIFICATION_TIME:
+            return ModificationTimeSlot;
+        case KIO::UDSEntry::UDS_ACCESS_TIME:
+            return AccessTimeSlot;
+        case KIO::UDSEntry::UDS_CREATION_TIME:
+            return CreationTimeSlot;
+        case KIO::UDSEntry::UDS_LOCAL_USER_ID:
+            return LocalUserIdSlot;
+        case KIO::UDSEntry::UDS_LOCAL_GROUP_ID:
+            return LocalGroupIdSlot;
+        case KIO::UDSEntry::UDS_DEVICE_ID:
+            return DeviceIdSlot;
+        case KIO::UDSEntry::UDS_INODE:
+            return InodeSlot;
+        default:
+            return -1;
+        }
+    }
+    struct Field {
+        inline Field(const uint index, const QString &value)
+            : m_str(value)
+            , m_index(index)
+        {
+        }
+        inline Field(const uint index, long long value = 0)
+            : m_long(value)
+            , m_index(index)
+        {
+        }
+
+        QString m_str;
+        long long m_long = LLONG_MIN;
+        uint m_index = 0;
+    };
+    QString m_strings[FirstNumberSlot];
+    long long m_numbers[SlotCount - FirstNumberSlot] = {};
+    quint32 m_present = 0;
+    std::vector<Field> overflow;
+
+public:
+    void reserve(int size)
+    {
+        if (size > SlotCount) {
+            overflow.reserve(size - SlotCount);
+        }
+    }
+    void insert(uint udsField, const QString &value)
+    {
+        Q_ASSERT(udsField & KIO::UDSEntry::UDS_STRING);
+        const int slot = slotOf(udsField);
+        if (slot != -1 && slot < FirstNumberSlot) {
+            m_strings[slot] = value;
+            m_present |= 1u << slot;
+            return;
+        }
+        overflow.emplace_back(udsField, value);
+    }
+    void insert(uint udsField, long long value)
+    {
+        Q_ASSERT(udsField & KIO::UDSEntry::UDS_NUMBER);
+        const int slot = slotOf(udsField);
+        if (slot >= FirstNumberSlot) {
+            m_numbers[slot - FirstNumberSlot] = value;
+            m_present |= 1u << slot;
+            return;
+        }
+        overflow.emplace_back(udsField, value);
+    }
+    int count() const
+    {
+        return qPopulationCount(m_present) + int(overflow.size());
+    }
+    QString stringValue(uint udsField) const
+    {
+        const int slot = slotOf(udsField);
+        if (slot != -1 && (m_present & (1u << slot))) {
+            return slot < FirstNumberSlot ? m_strings[slot] : QString();
+        }
+        auto it = std::find_if(overflow.cbegin(), overflow.cend(), [udsField](const Field &entry) {
+            return entry.m_index == udsField;
+        });
+        if (it != overflow.cend()) {
+            return it->m_str;
+        }
+        return QString();
+    }
+    long long numberValue(uint udsField, long long defaultValue = -1) const
+    {
+        const int slot = slotOf(udsField);
+        if (slot != -1 && (m_present & (1u << slot))) {
+            return slot >= FirstNumberSlot ? m_numbers[slot - FirstNumberSlot] : LLONG_MIN;
+        }
+        auto it = std::find_if(overflow.cbegin(), overflow.cend(), [udsField](const Field &entry) {
+            return entry.m_index == udsField;
+        });
+        if (it != overflow.cend()) {
+            return it->m_long;
+        }
+        return defaultValue;
+    }
+    QString spaceUsed()
+    {
+        const size_t slots = sizeof(m_strings) + sizeof(m_numbers) + sizeof(m_present);
+        return QStringLiteral("size:%1 space used:%2")
+            .arg(slots + overflow.size() * sizeof(Field) + sizeof(std::vector<Field>))
+            .arg(slots + overflow.capacity() * sizeof(Field) + sizeof(std::vector<Field>));
+    }
+};
+Q_DECLARE_TYPEINFO(SlotsUDSEntry, Q_RELOCATABLE_TYPE);
+
 template<class T>
 static void fillUDSEntries(T &entry, time_t now_time_t, const QString &nameStr, const QString &groupStr)
 {
@@ -655,6 +809,10 @@ void UdsEntryBenchmark::testUDSEntryHSFill()
 {
     testFill<UDSEntryHS>(this);
 }
+void UdsEntryBenchmark::testSlotsFill()
+{
+    testFill<SlotsUDSEntry>(this);
+}
 
 void UdsEntryBenchmark::testAnotherCompare()
 {
@@ -676,6 +834,10 @@ void UdsEntryBenchmark::testUDSEntryHSCompare()
 {
     testCompare<UDSEntryHS>(this);
 }
+void UdsEntryBenchmark::testSlotsCompare()
+{
+    testCompare<SlotsUDSEntry>(this);
+}
 
 void UdsEntryBenchmark::testTwoVectorKindEntryApp()
 {
@@ -697,6 +859,10 @@ void UdsEntryBenchmark::testUDSEntryHSApp()
 {
     testApp<UDSEntryHS>(this);
 }
+void UdsEntryBenchmark::testSlotsApp()
+{
+    testApp<SlotsUDSEntry>(this);
+}
 
 template<class T>
 void printSpaceUsed(UdsEntryBenchmark *bench)
@@ -713,6 +879,7 @@ void UdsEntryBenchmark::testspaceUsed()
     printSpaceUsed<AnotherV2UDSEntry>(this);
     printSpaceUsed<TwoVectorKindEntry>(this);
     printSpaceUsed<UDSEntryHS>(this);
+    printSpaceUsed<SlotsUDSEntry>(this);
 }
 
 QTEST_MAIN(UdsEntryBenchmark)
@@ -5,6 +5,7 @@
 */
 
 #include <kio/udsentry.h>
+#include <udsentry_p.h>
 
 #include <QTest>
 
@@ -23,6 +24,9 @@
  *
  * (d)  Load a UDSEntryList from a QDataStream.
  *
+ * (e)  Encode and decode a UDSEntryList with the compact encoding that
+ *      workers use for listings, see KIO::encodeUDSEntryList().
+ *
  * This is done for two different data sets:
  *
  * 1.   UDSEntries containing the entries which are provided by kio_file.
@@ -52,12 +56,20 @@ private Q_SLOTS:
     void saveLargeEntries();
     void loadSmallEntries();
     void loadLargeEntries();
+    void encodeSmallEntries();
+    void encodeLargeEntries();
+    void decodeSmallEntries();
+    void decodeLargeEntries();
 
 private:
+    static void printBytesPerEntry(const char *format, const QByteArray &data, qsizetype count);
+
     KIO::UDSEntryList m_smallEntries;
     KIO::UDSEntryList m_largeEntries;
     QByteArray m_savedSmallEntries;
     QByteArray m_savedLargeEntries;
+    QByteArray m_encodedSmallEntries;
+    QByteArray m_encodedLargeEntries;
 
     QList<uint> m_fieldsForLargeEntries;
 };
@@ -283,6 +295,83 @@ void UDSEntryBenchmark::loadLargeEntries()
     QCOMPARE(entries, m_largeEntries);
 }
 
+void UDSEntryBenchmark::printBytesPerEntry(const char *format, const QByteArray &data, qsizetype count)
+{
+    qDebug("%s: %lld bytes, %.1f bytes per entry", format, static_cast<long long>(data.size()), double(data.size()) / count);
+}
+
+void UDSEntryBenchmark::encodeSmallEntries()
+{
+    // Create the entries if they do not exist yet.
+    if (m_smallEntries.isEmpty()) {
+        createSmallEntries();
+    }
+
+    QBENCHMARK {
+        m_encodedSmallEntries = KIO::encodeUDSEntryList(m_smallEntries);
+    }
+
+    if (m_savedSmallEntries.isEmpty()) {
+        saveSmallEntries();
+    }
+    printBytesPerEntry("QDataStream", m_savedSmallEntries, m_smallEntries.count());
+    printBytesPerEntry("compact", m_encodedSmallEntries, m_smallEntries.count());
+    QVERIFY(m_encodedSmallEntries.size() < m_savedSmallEntries.size());
+}
+
+void UDSEntryBenchmark::encodeLargeEntries()
+{
+    // Create the entries if they do not exist yet.
+    if (m_largeEntries.isEmpty()) {
+        createLargeEntries();
+    }
+
+    QBENCHMARK {
+        m_encodedLargeEntries = KIO::encodeUDSEntryList(m_largeEntries);
+    }
+
+    if (m_savedLargeEntries.isEmpty()) {
+        saveLargeEntries();
+    }
+    printBytesPerEntry("QDataStream", m_savedLargeEntries, m_largeEntries.count());
+    printBytesPerEntry("compact", m_encodedLargeEntries, m_largeEntries.count());
+    QVERIFY(m_encodedLargeEntries.size() < m_savedLargeEntries.size());
+}
+
+void UDSEntryBenchmark::decodeSmallEntries()
+{
+    // Encode the entries if that has not been done yet.
+    if (m_encodedSmallEntries.isEmpty()) {
+        encodeSmallEntries();
+    }
+
+    KIO::UDSEntryList entries;
+
+    QBENCHMARK {
+        entries.clear();
+        QVERIFY(KIO::decodeUDSEntryList(m_encodedSmallEntries, entries));
+    }
+
+    QCOMPARE(entries, m_smallEntries);
+}
+
+void UDSEntryBenchmark::decodeLargeEntries()
+{
+    // Encode the entries if that has not been done yet.
+    if (m_encodedLargeEntries.isEmpty()) {
+        encodeLargeEntries();
+    }
+
+    KIO::UDSEntryList entries;
+
+    QBENCHMARK {
+        entries.clear();
+        QVERIFY(KIO::decodeUDSEntryList(m_encodedLargeEntries, entries));
+    }
+
+    QCOMPARE(entries, m_largeEntries);
+}
+
 QTEST_MAIN(UDSEntryBenchmark)
 
 #include "udsentry_benchmark.moc"
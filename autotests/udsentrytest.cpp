@@ -15,6 +15,7 @@
 
 #include <kfileitem.h>
 #include <udsentry.h>
+#include <udsentry_p.h>
 
 #include "kiotesthelper.h"
 
@@ -192,6 +193,55 @@ void UDSEntryTest::testSaveLoad()
     }
 }
 
+/**
+ * Test that the compact encoding used for listings round-trips, including
+ * values shared through its string table, negative numbers and non-ASCII names.
+ */
+void UDSEntryTest::testCompactEncoding()
+{
+    KIO::UDSEntryList list;
+    for (int i = 0; i < 3; ++i) {
+        KIO::UDSEntry entry;
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("f\u00efle%1 \U0001F600").arg(i));
+        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, 1LL << (20 * i));
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1 - i);
+        entry.fastInsert(KIO::UDSEntry::UDS_USER, QStringLiteral("user%1").arg(i % 2));
+        entry.fastInsert(KIO::UDSEntry::UDS_GROUP, QStringLiteral("group"));
+        entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QString());
+        entry.fastInsert(KIO::UDSEntry::UDS_EXTRA + i, QStringLiteral("extra"));
+        list.append(entry);
+    }
+    list.append(KIO::UDSEntry());
+
+    const QByteArray data = KIO::encodeUDSEntryList(list);
+    KIO::UDSEntryList decoded;
+    QVERIFY(KIO::decodeUDSEntryList(data, decoded));
+    QCOMPARE(decoded, list);
+
+    // Equal strings from the string table are shared between the entries
+    QCOMPARE(decoded.at(0).stringValue(KIO::UDSEntry::UDS_GROUP).constData(), decoded.at(2).stringValue(KIO::UDSEntry::UDS_GROUP).constData());
+
+    // Truncated data is rejected, keeping what could be decoded
+    decoded.clear();
+    QVERIFY(!KIO::decodeUDSEntryList(data.left(data.size() - 1), decoded));
+    QCOMPARE(decoded.size(), 3);
+    QCOMPARE(decoded.first(), list.first());
+
+    // So is an unknown version
+    decoded.clear();
+    QVERIFY(!KIO::decodeUDSEntryList(QByteArray(1, char(KIO::UDSEntryListFormatVersion + 1)) + data.mid(1), decoded));
+    QVERIFY(decoded.isEmpty());
+
+    // A field sent twice by the worker keeps the last value: version, 1 entry of 2 fields, UDS_NAME "a" then "b"
+    const char nameTag = char(((KIO::UDSEntry::UDS_NAME & 0xffffff) << 3) | (KIO::UDSEntry::UDS_STRING >> 24));
+    const char repeated[] = {char(KIO::UDSEntryListFormatVersion), 1, 2, nameTag, 1, 'a', nameTag, 1, 'b'};
+    decoded.clear();
+    QVERIFY(KIO::decodeUDSEntryList(QByteArray(repeated, sizeof(repeated)), decoded));
+    QCOMPARE(decoded.size(), 1);
+    QCOMPARE(decoded.first().count(), 1);
+    QCOMPARE(decoded.first().stringValue(KIO::UDSEntry::UDS_NAME), QStringLiteral("b"));
+}
+
 /**
  * Test to verify that move semantics work. This is only useful when ran through callgrind.
  */
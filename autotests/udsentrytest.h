@@ -16,6 +16,7 @@ class UDSEntryTest : public QObject
 
 private Q_SLOTS:
     void testSaveLoad();
+    void testCompactEncoding();
     void testMove();
     void testEquality();
 };
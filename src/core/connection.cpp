@@ -138,7 +138,7 @@ void Connection::connectToRemote(const QUrl &address)
     // qDebug() << "Connection requested to" << address;
     const QString scheme = address.scheme();
 
-    if (scheme == QLatin1String("local")) {
+    if (scheme == QLatin1String("local") || scheme == QLatin1String("thread")) {
         d->setBackend(new ConnectionBackend(this));
     } else {
         qCWarning(KIO_CORE) << "Unknown protocol requested:" << scheme << "(" << address << ")";
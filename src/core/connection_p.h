@@ -53,7 +53,7 @@ public:
 
     /**
      * Connects to the remote address.
-     * @param address a local:// or tcp:// URL.
+     * @param address a local:// URL, or a thread:// URL for workers running in-process.
      */
     void connectToRemote(const QUrl &address);
 
@@ -11,19 +11,58 @@
 #include "connectionbackend_p.h"
 #include <KLocalizedString>
 #include <QCoreApplication>
+#include <QDeadlineTimer>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QHash>
 #include <QLocalServer>
 #include <QLocalSocket>
+#include <QMutex>
 #include <QPointer>
 #include <QStandardPaths>
 #include <QTemporaryFile>
+#include <QWaitCondition>
 #include <cerrno>
+#include <deque>
 
 #include "kiocoreconnectiondebug.h"
 
 using namespace KIO;
 
+namespace KIO
+{
+/*
+ * State shared by the two ends of an in-process connection.
+ * Side 0 is the listening (application) end, side 1 the connecting (worker) end;
+ * queues are indexed by the receiving side.
+ */
+struct InProcessChannel {
+    QMutex mutex;
+    QWaitCondition condition;
+    std::deque<Task> queues[2];
+    qsizetype queuedBytes[2] = {0, 0};
+    ConnectionBackend *ends[2] = {nullptr, nullptr};
+    bool wakeupPosted[2] = {false, false};
+    bool closed = false;
+};
+}
+
+namespace
+{
+struct InProcessListener {
+    ConnectionBackend *server = nullptr;
+    QList<ConnectionBackend *> pendingConnections;
+};
+
+struct InProcessRegistry {
+    QMutex mutex;
+    QHash<QString, InProcessListener> listeners; // keyed by address path
+};
+Q_GLOBAL_STATIC(InProcessRegistry, s_inProcessRegistry)
+
+const QLatin1String s_threadScheme("thread");
+}
+
 ConnectionBackend::ConnectionBackend(QObject *parent)
     : QObject(parent)
     , state(Idle)
@@ -35,6 +74,20 @@ ConnectionBackend::ConnectionBackend(QObject *parent)
 
 ConnectionBackend::~ConnectionBackend()
 {
+    if (state == Listening && isInProcess()) {
+        QList<ConnectionBackend *> pending;
+        {
+            QMutexLocker locker(&s_inProcessRegistry->mutex);
+            pending = s_inProcessRegistry->listeners.take(address.path()).pendingConnections;
+        }
+        qDeleteAll(pending);
+    }
+    closeChannel();
+}
+
+bool ConnectionBackend::isInProcess() const
+{
+    return address.scheme() == s_threadScheme;
 }
 
 void ConnectionBackend::setSuspended(bool enable)
@@ -42,6 +95,18 @@ void ConnectionBackend::setSuspended(bool enable)
     if (state != Connected) {
         return;
     }
+    if (channel) {
+        channelSuspended = enable;
+        if (!enable) {
+            QMetaObject::invokeMethod(
+                this,
+                [this]() {
+                    drainChannel();
+                },
+                Qt::QueuedConnection);
+        }
+        return;
+    }
     Q_ASSERT(socket);
     Q_ASSERT(!localServer); // !tcpServer as well
 
@@ -75,6 +140,10 @@ bool ConnectionBackend::connectToRemote(const QUrl &url)
     Q_ASSERT(!socket);
     Q_ASSERT(!localServer); // !tcpServer as well
 
+    if (url.scheme() == s_threadScheme) {
+        return connectToThread(url);
+    }
+
     QLocalSocket *sock = new QLocalSocket(this);
     QString path = url.path();
     sock->connectToServer(path);
@@ -86,6 +155,94 @@ bool ConnectionBackend::connectToRemote(const QUrl &url)
     return true;
 }
 
+bool ConnectionBackend::connectToThread(const QUrl &url)
+{
+    QMutexLocker locker(&s_inProcessRegistry->mutex);
+    auto it = s_inProcessRegistry->listeners.find(url.path());
+    if (it == s_inProcessRegistry->listeners.end()) {
+        errorString = i18n("No in-process KIO connection listening on %1", url.toString());
+        return false;
+    }
+
+    auto newChannel = std::make_shared<InProcessChannel>();
+
+    // The application end is created here and handed over to the listening thread,
+    // it only starts delivering tasks once its Connection resumes it.
+    auto *peer = new ConnectionBackend();
+    peer->state = Connected;
+    peer->address = url;
+    peer->channel = newChannel;
+    peer->channelSide = 0;
+    peer->channelSuspended = true;
+    peer->moveToThread(it->server->thread());
+
+    newChannel->ends[0] = peer;
+    newChannel->ends[1] = this;
+    channel = newChannel;
+    channelSide = 1;
+    address = url;
+    state = Connected;
+
+    it->pendingConnections.append(peer);
+    QMetaObject::invokeMethod(it->server, &ConnectionBackend::newConnection, Qt::QueuedConnection);
+    return true;
+}
+
+void ConnectionBackend::closeChannel()
+{
+    if (!channel) {
+        return;
+    }
+    QMutexLocker locker(&channel->mutex);
+    channel->closed = true;
+    channel->ends[channelSide] = nullptr;
+    if (ConnectionBackend *peer = channel->ends[1 - channelSide]) {
+        QMetaObject::invokeMethod(peer, &ConnectionBackend::socketDisconnected, Qt::QueuedConnection);
+    }
+    channel->condition.wakeAll();
+}
+
+void ConnectionBackend::channelReadyRead()
+{
+    if (!channel) {
+        return;
+    }
+    {
+        QMutexLocker locker(&channel->mutex);
+        channel->wakeupPosted[channelSide] = false;
+    }
+    drainChannel();
+}
+
+void ConnectionBackend::drainChannel()
+{
+    QPointer<ConnectionBackend> that = this;
+    // Take one task at a time, a receiver may suspend us in response to any of them
+    while (!channelSuspended) {
+        Task task;
+        {
+            QMutexLocker locker(&channel->mutex);
+            auto &queue = channel->queues[channelSide];
+            if (queue.empty()) {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+            channel->queuedBytes[channelSide] -= task.data.size();
+            channel->condition.wakeAll();
+        }
+
+        signalEmitted = true;
+        qCDebug(KIO_CORE_CONNECTION) << "emitting in-process task" << task.cmd << task.data.size();
+        Q_EMIT commandReceived(task);
+
+        // If we're dead, better don't try anything.
+        if (that.isNull()) {
+            return;
+        }
+    }
+}
+
 void ConnectionBackend::socketDisconnected()
 {
     state = Idle;
@@ -128,9 +285,51 @@ ConnectionBackend::ConnectionResult ConnectionBackend::listenForRemote()
     return {true, QString()};
 }
 
+ConnectionBackend::ConnectionResult ConnectionBackend::listenInProcess()
+{
+    Q_ASSERT(state == Idle);
+    Q_ASSERT(!socket);
+    Q_ASSERT(!localServer);
+
+    static QBasicAtomicInt s_channelCounter = Q_BASIC_ATOMIC_INITIALIZER(1);
+    address.clear();
+    address.setScheme(s_threadScheme);
+    address.setPath(QStringLiteral("/kioworker.%1").arg(s_channelCounter.fetchAndAddAcquire(1)));
+
+    QMutexLocker locker(&s_inProcessRegistry->mutex);
+    s_inProcessRegistry->listeners.insert(address.path(), InProcessListener{.server = this, .pendingConnections = {}});
+
+    state = Listening;
+    return {true, QString()};
+}
+
 bool ConnectionBackend::waitForIncomingTask(int ms)
 {
     Q_ASSERT(state == Connected);
+    if (channel) {
+        signalEmitted = false;
+        bool closed = false;
+        {
+            QMutexLocker locker(&channel->mutex);
+            const QDeadlineTimer deadline(ms);
+            while (channel->queues[channelSide].empty() && !channel->closed) {
+                if (!channel->condition.wait(&channel->mutex, deadline)) {
+                    break;
+                }
+            }
+            closed = channel->closed;
+        }
+        // Tasks sent before the peer went away are still delivered
+        drainChannel();
+        if (signalEmitted) {
+            return true;
+        }
+        if (closed) {
+            state = Idle;
+        }
+        return false;
+    }
+
     Q_ASSERT(socket);
     if (socket->state() != QLocalSocket::LocalSocketState::ConnectedState) {
         state = Idle;
@@ -167,6 +366,34 @@ bool ConnectionBackend::waitForIncomingTask(int ms)
 bool ConnectionBackend::sendCommand(int cmd, const QByteArray &data) const
 {
     Q_ASSERT(state == Connected);
+
+    if (channel) {
+        const int peerSide = 1 - channelSide;
+        QMutexLocker locker(&channel->mutex);
+        // The worker blocks while the application hasn't caught up, like a full socket buffer would.
+        // The application never does: it may be the GUI thread, and the worker may be waiting for it
+        while (channelSide == 1 && !channel->closed && channel->queuedBytes[peerSide] >= MaxQueuedBytes) {
+            channel->condition.wait(&channel->mutex);
+        }
+        if (channel->closed) {
+            qCWarning(KIO_CORE_CONNECTION) << "In-process channel closed";
+            return false;
+        }
+
+        // QByteArray is implicitly shared, the receiver gets the very same buffer
+        channel->queues[peerSide].push_back(Task{.cmd = cmd, .len = static_cast<long>(data.size()), .data = data});
+        channel->queuedBytes[peerSide] += data.size();
+        channel->condition.wakeAll();
+
+        // One pending wakeup is enough, the receiver drains the whole queue
+        ConnectionBackend *peer = channel->ends[peerSide];
+        if (peer && !channel->wakeupPosted[peerSide]) {
+            channel->wakeupPosted[peerSide] = true;
+            QMetaObject::invokeMethod(peer, &ConnectionBackend::channelReadyRead, Qt::QueuedConnection);
+        }
+        return true;
+    }
+
     Q_ASSERT(socket);
 
     char buffer[HeaderSize + 2];
@@ -193,6 +420,17 @@ bool ConnectionBackend::sendCommand(int cmd, const QByteArray &data) const
 ConnectionBackend *ConnectionBackend::nextPendingConnection()
 {
     Q_ASSERT(state == Listening);
+
+    if (isInProcess()) {
+        QMutexLocker locker(&s_inProcessRegistry->mutex);
+        auto &pending = s_inProcessRegistry->listeners[address.path()].pendingConnections;
+        if (pending.isEmpty()) {
+            return nullptr;
+        }
+        qCDebug(KIO_CORE_CONNECTION) << "Got a new in-process connection";
+        return pending.takeFirst();
+    }
+
     Q_ASSERT(localServer);
     Q_ASSERT(!socket);
 
@@ -12,6 +12,8 @@
 #include <QObject>
 #include <QUrl>
 
+#include <memory>
+
 class QLocalServer;
 class QLocalSocket;
 
@@ -25,6 +27,8 @@ struct Task {
     QByteArray data{};
 };
 
+struct InProcessChannel;
+
 class ConnectionBackend : public QObject
 {
     Q_OBJECT
@@ -40,6 +44,9 @@ public:
 
     static const int HeaderSize = 10;
     static const int StandardBufferSize = 32 * 1024;
+    // How many bytes the application end of an in-process connection may have queued
+    // before the worker blocks in sendCommand, mimicking the socket buffer
+    static const int MaxQueuedBytes = 8 * StandardBufferSize;
 
 private:
     QLocalSocket *socket;
@@ -47,6 +54,16 @@ private:
     std::optional<Task> pendingTask = std::nullopt;
     bool signalEmitted;
 
+    // Only set for in-process (thread://) connections, see listenInProcess()
+    std::shared_ptr<InProcessChannel> channel;
+    int channelSide = 0;
+    bool channelSuspended = false;
+
+    bool isInProcess() const;
+    bool connectToThread(const QUrl &url);
+    void closeChannel();
+    void drainChannel();
+
 Q_SIGNALS:
     void disconnected();
     void commandReceived(const KIO::Task &task);
@@ -64,6 +81,12 @@ public:
     void setSuspended(bool enable);
     bool connectToRemote(const QUrl &url);
     ConnectionResult listenForRemote();
+    /**
+     * Listens for a worker running in a thread of this process. Instead of a
+     * socket, tasks are handed over through an in-memory queue, so data is
+     * neither serialized nor copied.
+     */
+    ConnectionResult listenInProcess();
     bool waitForIncomingTask(int ms);
     bool sendCommand(int command, const QByteArray &data) const;
     ConnectionBackend *nextPendingConnection();
@@ -71,6 +94,7 @@ public:
 public Q_SLOTS:
     void socketReadyRead();
     void socketDisconnected();
+    void channelReadyRead();
 };
 }
 
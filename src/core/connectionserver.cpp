@@ -34,6 +34,19 @@ void ConnectionServer::listenForRemote()
     // qDebug() << "Listening on" << d->backend->address;
 }
 
+void ConnectionServer::listenInProcess()
+{
+    backend = new ConnectionBackend(this);
+    if (auto result = backend->listenInProcess(); !result.success) {
+        qCWarning(KIO_CORE) << "ConnectionServer::listenInProcess failed:" << result.error;
+        delete backend;
+        backend = nullptr;
+        return;
+    }
+
+    connect(backend, &ConnectionBackend::newConnection, this, &ConnectionServer::newConnection);
+}
+
 QUrl ConnectionServer::address() const
 {
     if (backend) {
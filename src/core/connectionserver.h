@@ -34,6 +34,11 @@ public:
      * address this is listening on.
      */
     void listenForRemote();
+    /**
+     * Like listenForRemote(), but for a worker running in a thread of this
+     * process. The resulting connection bypasses the socket entirely.
+     */
+    void listenInProcess();
     bool isListening() const;
 
     /**
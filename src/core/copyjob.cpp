@@ -44,6 +44,7 @@
 #include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QPointer>
 #include <QQueue>
 #include <QTemporaryFile>
@@ -58,6 +59,7 @@
 #include <KIO/FileSystemFreeSpaceJob>
 
 #include <list>
+#include <optional>
 #include <set>
 
 #include <QLoggingCategory>
@@ -332,6 +334,18 @@ public:
     std::set<QString> m_parentDirs;
     bool m_ignoreSourcePermissions = false;
 
+    // File copies running concurrently, see CopyJob::setMaxParallelTransfers
+    struct ParallelCopy {
+        CopyInfo info;
+        KIO::filesize_t processedSize;
+    };
+    int m_maxParallelTransfers = 1;
+    QHash<KJob *, ParallelCopy> m_parallelCopies;
+    // Set when the first entry in files has to go through the one-at-a-time code path,
+    // e.g. to show a conflict dialog
+    bool m_serialCopyPending = false;
+    std::optional<bool> m_destHasMsdosQuirks;
+
     void statCurrentSrc();
     void statNextSrc();
 
@@ -355,6 +369,16 @@ public:
     bool handleMsdosFsQuirks(QList<CopyInfo>::Iterator it, KFileSystemType::Type fsType);
     void copyNextFile();
     void processCopyNextFile(const QList<CopyInfo>::Iterator &it, int result, SkipType skipType);
+    JobFlags fileCopyFlags(const CopyInfo &info) const;
+    int fileCopyPermissions(const CopyInfo &info) const;
+    KIO::FileCopyJob *startFileCopyJob(const CopyInfo &info);
+    // Bookkeeping after a file (not a link) was copied or moved successfully
+    void fileCopied(const CopyInfo &info);
+
+    bool canCopyInParallel(const CopyInfo &info);
+    // Starts as many file copies as allowed, returns false if the one-at-a-time path should take over
+    bool startParallelCopies();
+    void slotResultParallelCopy(KJob *job);
 
     void slotResultDeletingDirs(KJob *job);
     void deleteNextDir();
@@ -1611,24 +1635,13 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
             return; // Don't move to next file yet !
         }
 
-        const QUrl finalUrl = finalDestUrl((*it).uSource, (*it).uDest);
-
         if (m_bCurrentOperationIsLink) {
+            const QUrl finalUrl = finalDestUrl((*it).uSource, (*it).uDest);
             QString target = (m_mode == CopyJob::Link ? (*it).uSource.path() : (*it).linkDest);
             // required for the undo feature
             Q_EMIT q->copyingLinkDone(q, (*it).uSource, target, finalUrl);
         } else {
-            // required for the undo feature
-            Q_EMIT q->copyingDone(q, (*it).uSource, finalUrl, (*it).mtime, false, false);
-            if (m_mode == CopyJob::Move) {
-#ifdef WITH_QTDBUS
-                org::kde::KDirNotify::emitFileMoved((*it).uSource, finalUrl);
-#endif
-            }
-            m_successSrcList.append((*it).uSource);
-            if (m_freeSpace != KIO::invalidFilesize && (*it).size != KIO::invalidFilesize) {
-                m_freeSpace -= (*it).size;
-            }
+            fileCopied(*it);
         }
         // remove from list, to move on to next file
         files.erase(it);
@@ -1650,6 +1663,76 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
     copyNextFile();
 }
 
+void CopyJobPrivate::fileCopied(const CopyInfo &info)
+{
+    Q_Q(CopyJob);
+    const QUrl finalUrl = finalDestUrl(info.uSource, info.uDest);
+    // required for the undo feature
+    Q_EMIT q->copyingDone(q, info.uSource, finalUrl, info.mtime, false, false);
+    if (m_mode == CopyJob::Move) {
+#ifdef WITH_QTDBUS
+        org::kde::KDirNotify::emitFileMoved(info.uSource, finalUrl);
+#endif
+    }
+    m_successSrcList.append(info.uSource);
+    if (m_freeSpace != KIO::invalidFilesize && info.size != KIO::invalidFilesize) {
+        m_freeSpace -= info.size;
+    }
+}
+
+void CopyJobPrivate::slotResultParallelCopy(KJob *job)
+{
+    Q_Q(CopyJob);
+    const ParallelCopy copy = m_parallelCopies.take(job);
+    CopyInfo info = copy.info;
+
+    // Merge metadata from subjob
+    KIO::Job *kiojob = qobject_cast<KIO::Job *>(job);
+    Q_ASSERT(kiojob);
+    m_incomingMetaData += kiojob->metaData();
+    q->removeSubjob(job);
+
+    const int error = job->error();
+    if (!error) {
+        fileCopied(info);
+        ++m_processedFiles;
+        m_processedSize += copy.processedSize;
+    } else if (error == ERR_USER_CANCELED) {
+        for (auto it = m_parallelCopies.cbegin(); it != m_parallelCopies.cend(); ++it) {
+            q->removeSubjob(it.key());
+            it.key()->kill(KJob::Quietly);
+        }
+        m_parallelCopies.clear();
+        q->setError(ERR_USER_CANCELED);
+        q->emitResult();
+        return;
+    } else if (m_bAutoSkipFiles) {
+        skip(info.uSource, false);
+        m_processedSize += info.size;
+    } else if (m_bAutoRenameFiles && (error == ERR_FILE_ALREADY_EXIST || error == ERR_DIR_ALREADY_EXIST || error == ERR_IDENTICAL_FILES)) {
+        QUrl destDirectory = info.uDest.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+        const QString newName = KFileUtils::suggestName(destDirectory, info.uDest.fileName());
+        QUrl newDest(destDirectory);
+        newDest.setPath(Utils::concatPaths(newDest.path(), newName));
+        Q_EMIT q->renamed(q, info.uDest, newDest); // for e.g. kpropsdlg
+        info.uDest = newDest;
+        files.prepend(info);
+    } else {
+        // Conflicts and errors need the user (or end the job): retry this file on its own
+        // once the other transfers are done, so the usual dialogs can be shown.
+        files.prepend(info);
+        m_serialCopyPending = true;
+    }
+
+    m_fileProcessedSize = 0;
+    for (const ParallelCopy &running : std::as_const(m_parallelCopies)) {
+        m_fileProcessedSize += running.processedSize;
+    }
+
+    qCDebug(KIO_COPYJOB_DEBUG) << files.count() << "files remaining," << m_parallelCopies.count() << "in flight";
+    copyNextFile();
+}
+
 void CopyJobPrivate::slotResultErrorCopyingFiles(KJob *job)
 {
     Q_Q(CopyJob);
@@ -1956,12 +2039,60 @@ bool CopyJobPrivate::handleMsdosFsQuirks(QList<CopyInfo>::Iterator it, KFileSyst
     return false; // Not handled, move on
 }
 
+bool CopyJobPrivate::canCopyInParallel(const CopyInfo &info)
+{
+    if (m_mode == CopyJob::Link || !info.linkDest.isEmpty()) {
+        return false;
+    }
+    // FAT and NTFS need per-file checks and possibly dialogs, see handleMsdosFsQuirks
+    if (!m_destHasMsdosQuirks.has_value()) {
+        m_destHasMsdosQuirks = m_globalDest.isLocalFile() && isFatOrNtfs(KFileSystemType::fileSystemType(m_globalDest.toLocalFile()));
+    }
+    return !m_destHasMsdosQuirks.value();
+}
+
+bool CopyJobPrivate::startParallelCopies()
+{
+    if (m_serialCopyPending) {
+        return !m_parallelCopies.isEmpty();
+    }
+
+    while (m_parallelCopies.count() < m_maxParallelTransfers && !files.isEmpty()) {
+        const CopyInfo &info = files.constFirst();
+        if (shouldSkip(info.uDest.path())) {
+            files.removeFirst();
+            continue;
+        }
+        if (!canCopyInParallel(info)) {
+            break;
+        }
+        if (m_freeSpace != KIO::invalidFilesize && info.size != KIO::invalidFilesize) {
+            KIO::filesize_t reserved = info.size;
+            for (const ParallelCopy &running : std::as_const(m_parallelCopies)) {
+                reserved += running.info.size;
+            }
+            if (m_freeSpace < reserved) {
+                break; // once the others are done, processCopyNextFile reports ERR_DISK_FULL if it still doesn't fit
+            }
+        }
+
+        KIO::FileCopyJob *job = startFileCopyJob(info);
+        m_parallelCopies.insert(job, ParallelCopy{files.takeFirst(), 0});
+    }
+
+    return !m_parallelCopies.isEmpty();
+}
+
 void CopyJobPrivate::copyNextFile()
 {
     Q_Q(CopyJob);
     bool bCopyFile = false;
     qCDebug(KIO_COPYJOB_DEBUG);
 
+    if (m_maxParallelTransfers > 1 && startParallelCopies()) {
+        return;
+    }
+
     bool isDestLocal = m_globalDest.isLocalFile();
 
     // Take the first file in the list
@@ -2006,9 +2137,65 @@ void CopyJobPrivate::copyNextFile()
     }
 }
 
+JobFlags CopyJobPrivate::fileCopyFlags(const CopyInfo &info) const
+{
+    // Do we set overwrite ?
+    if (info.uDest == info.uSource) {
+        return DefaultFlags;
+    }
+    return shouldOverwriteFile(info.uDest.path()) ? Overwrite : DefaultFlags;
+}
+
+int CopyJobPrivate::fileCopyPermissions(const CopyInfo &info) const
+{
+    // If source isn't local and target is local, we ignore the original permissions
+    // Otherwise, files downloaded from HTTP end up with -r--r--r--
+    if (m_defaultPermissions || (m_ignoreSourcePermissions && info.uDest.isLocalFile())) {
+        return -1;
+    }
+    return info.permissions;
+}
+
+KIO::FileCopyJob *CopyJobPrivate::startFileCopyJob(const CopyInfo &info)
+{
+    Q_Q(CopyJob);
+    const QUrl &uSource = info.uSource;
+    const QUrl &uDest = info.uDest;
+    const int permissions = fileCopyPermissions(info);
+    const JobFlags flags = fileCopyFlags(info);
+
+    KIO::FileCopyJob *newjob = nullptr;
+    if (m_mode == CopyJob::Move) { // Moving a file
+        newjob = KIO::file_move(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
+        qCDebug(KIO_COPYJOB_DEBUG) << "Moving" << uSource << "to" << uDest;
+    } else { // Copying a file
+        newjob = KIO::file_copy(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
+        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << uSource << "to" << uDest;
+    }
+    newjob->setParentJob(q); // in case of rename dialog
+    newjob->setSourceSize(info.size);
+    newjob->setModificationTime(info.mtime); // #55804
+    m_currentSrcURL = uSource;
+    m_currentDestURL = uDest;
+    m_bURLDirty = true;
+
+    // speed is computed locally
+    QObject::disconnect(newjob, &KJob::speed, q, nullptr);
+    q->addSubjob(newjob);
+    q->connect(newjob, &Job::processedSize, q, [this](KJob *job, qulonglong processedSize) {
+        slotProcessedSize(job, processedSize);
+    });
+    q->connect(newjob, &Job::totalSize, q, [this](KJob *job, qulonglong totalSize) {
+        slotTotalSize(job, totalSize);
+    });
+    return newjob;
+}
+
 void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, int result, SkipType skipType)
 {
     Q_Q(CopyJob);
+    // Whatever happens now, the entry that had to be handled on its own is dealt with
+    m_serialCopyPending = false;
 
     switch (result) {
     case Result_Cancel:
@@ -2054,23 +2241,8 @@ void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, in
 
     const QUrl &uSource = (*it).uSource;
     const QUrl &uDest = (*it).uDest;
-    // Do we set overwrite ?
-    bool bOverwrite;
-    const QString destFile = uDest.path();
-    qCDebug(KIO_COPYJOB_DEBUG) << "copying" << destFile;
-    if (uDest == uSource) {
-        bOverwrite = false;
-    } else {
-        bOverwrite = shouldOverwriteFile(destFile);
-    }
-
-    // If source isn't local and target is local, we ignore the original permissions
-    // Otherwise, files downloaded from HTTP end up with -r--r--r--
-    int permissions = (*it).permissions;
-    if (m_defaultPermissions || (m_ignoreSourcePermissions && uDest.isLocalFile())) {
-        permissions = -1;
-    }
-    const JobFlags flags = bOverwrite ? Overwrite : DefaultFlags;
+    qCDebug(KIO_COPYJOB_DEBUG) << "copying" << uDest.path();
+    const JobFlags flags = fileCopyFlags(*it);
 
     m_bCurrentOperationIsLink = false;
     KIO::Job *newjob = nullptr;
@@ -2094,28 +2266,9 @@ void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, in
         // Observer::self()->slotCopying( this, m_currentSrcURL, uDest ); // should be slotLinking perhaps
         m_bCurrentOperationIsLink = true;
         // NOTE: if we are moving stuff, the deletion of the source will be done in slotResultCopyingFiles
-    } else if (m_mode == CopyJob::Move) { // Moving a file
-        KIO::FileCopyJob *moveJob = KIO::file_move(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
-        moveJob->setParentJob(q);
-        moveJob->setSourceSize((*it).size);
-        moveJob->setModificationTime((*it).mtime); // #55804
-        newjob = moveJob;
-        qCDebug(KIO_COPYJOB_DEBUG) << "Moving" << uSource << "to" << uDest;
-        // emit moving( this, uSource, uDest );
-        m_currentSrcURL = uSource;
-        m_currentDestURL = uDest;
-        m_bURLDirty = true;
-        // Observer::self()->slotMoving( this, uSource, uDest );
-    } else { // Copying a file
-        KIO::FileCopyJob *copyJob = KIO::file_copy(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
-        copyJob->setParentJob(q); // in case of rename dialog
-        copyJob->setSourceSize((*it).size);
-        copyJob->setModificationTime((*it).mtime);
-        newjob = copyJob;
-        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << uSource << "to" << uDest;
-        m_currentSrcURL = uSource;
-        m_currentDestURL = uDest;
-        m_bURLDirty = true;
+    } else { // Moving or copying a file
+        startFileCopyJob(*it);
+        return;
     }
 
     // speed is computed locally
@@ -2206,11 +2359,17 @@ void CopyJob::emitResult()
     Job::emitResult();
 }
 
-void CopyJobPrivate::slotProcessedSize(KJob *, qulonglong data_size)
+void CopyJobPrivate::slotProcessedSize(KJob *job, qulonglong data_size)
 {
     Q_Q(CopyJob);
     qCDebug(KIO_COPYJOB_DEBUG) << data_size;
-    m_fileProcessedSize = data_size;
+    if (auto parallelIt = m_parallelCopies.find(job); parallelIt != m_parallelCopies.end()) {
+        // Sum of all transfers in flight
+        m_fileProcessedSize += data_size - parallelIt->processedSize;
+        parallelIt->processedSize = data_size;
+    } else {
+        m_fileProcessedSize = data_size;
+    }
 
     if (m_processedSize + m_fileProcessedSize > m_totalSize) {
         // Example: download any attachment from bugs.kde.org
@@ -2589,7 +2748,11 @@ void CopyJob::slotResult(KJob *job)
         d->slotResultConflictCreatingDirs(job);
         break;
     case STATE_COPYING_FILES:
-        d->slotResultCopyingFiles(job);
+        if (d->m_parallelCopies.contains(job)) {
+            d->slotResultParallelCopy(job);
+        } else {
+            d->slotResultCopyingFiles(job);
+        }
         break;
     case STATE_CONFLICT_COPYING_FILES:
         d->slotResultErrorCopyingFiles(job);
@@ -2632,6 +2795,11 @@ void KIO::CopyJob::setWriteIntoExistingDirectories(bool overwriteAll) // #65926
     d_func()->m_bOverwriteAllDirs = overwriteAll;
 }
 
+void KIO::CopyJob::setMaxParallelTransfers(int maxTransfers)
+{
+    d_func()->m_maxParallelTransfers = std::max(1, maxTransfers);
+}
+
 CopyJob *KIO::copy(const QUrl &src, const QUrl &dest, JobFlags flags)
 {
     qCDebug(KIO_COPYJOB_DEBUG) << "src=" << src << "dest=" << dest;
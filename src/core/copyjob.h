@@ -106,6 +106,23 @@ public:
      */
     void setWriteIntoExistingDirectories(bool overwriteAllDirs);
 
+    /**
+     * Sets how many files may be transferred at the same time.
+     *
+     * The default is 1, i.e. files are copied one after the other. Higher values
+     * keep up to @p maxTransfers file copies in flight, which helps a lot with
+     * many small files or high latency destinations. The effective concurrency
+     * is still bounded by the number of workers the scheduler allows per host.
+     *
+     * Symlinks, links to URLs and copies to FAT or NTFS filesystems are always
+     * done one at a time. A file that needs a decision from the user (e.g. because
+     * it already exists) is retried on its own, once the other transfers finished.
+     *
+     * Must be called before the job starts copying files.
+     * \since 6.10
+     */
+    void setMaxParallelTransfers(int maxTransfers);
+
     /**
      * Reimplemented for internal reasons
      */
@@ -9,6 +9,7 @@
 
 #include "deletejob.h"
 
+#include "../dirunlinker_p.h"
 #include "../utils_p.h"
 #include "job.h" // buildErrorString
 #include "kcoredirlister.h"
@@ -24,10 +25,14 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QMetaObject>
 #include <QPointer>
 #include <QThread>
+#include <QThreadPool>
 #include <QTimer>
+#include <QtConcurrentMap>
+#include <qplatformdefs.h>
 
 #include "job_p.h"
 
@@ -46,33 +51,92 @@ enum DeleteJobState {
     DELETEJOB_STATE_DELETING_DIRS,
 };
 
+// The entries of one directory, removed in one go by the IO worker
+struct DeleteJobBatch {
+    QString dirPath;
+    QStringList names;
+};
+
 class DeleteJobIOWorker : public QObject
 {
     Q_OBJECT
 
+public:
+    DeleteJobIOWorker()
+    {
+        m_pool.setMaxThreadCount(DirUnlinker::maxThreadCount());
+    }
+
+    /// Number of files removed so far, safe to call from any thread
+    int removedFiles() const
+    {
+        return m_removedFiles.loadRelaxed();
+    }
+
+    /// Makes the batches being processed stop as soon as possible, safe to call from any thread
+    void cancel()
+    {
+        m_cancelled.storeRelaxed(1);
+    }
+
 Q_SIGNALS:
-    void rmfileResult(bool succeeded, bool isLink);
-    void rmddirResult(bool succeeded);
+    void filesRemoved(const QStringList &failedPaths);
 
 public Q_SLOTS:
 
     /**
-     * Deletes the file @p url points to
-     * The file must be a LocalFile
+     * Deletes the files (or symlinks) of @p batches, several directories in parallel.
+     * Emits filesRemoved() with the paths that couldn't be deleted.
      */
-    void rmfile(const QUrl &url, bool isLink)
+    void removeFiles(const QList<DeleteJobBatch> &batches)
     {
-        Q_EMIT rmfileResult(QFile::remove(url.toLocalFile()), isLink);
+        const QList<QStringList> failed = QtConcurrent::blockingMapped<QList<QStringList>>(&m_pool, batches, [this](const DeleteJobBatch &batch) {
+            return removeBatch(batch);
+        });
+        QStringList failedPaths;
+        for (const QStringList &paths : failed) {
+            failedPaths += paths;
+        }
+        Q_EMIT filesRemoved(failedPaths);
     }
 
-    /**
-     * Deletes the directory @p url points to
-     * The directory must be a LocalFile
-     */
-    void rmdir(const QUrl &url)
+private:
+    // Runs on a thread of m_pool
+    QStringList removeBatch(const DeleteJobBatch &batch)
     {
-        Q_EMIT rmddirResult(QDir().rmdir(url.toLocalFile()));
+        QStringList failedPaths;
+#ifdef Q_OS_UNIX
+        // The files of a batch are siblings, see localBatches()
+        const DirUnlinker::Dir dir(QFile::encodeName(batch.dirPath));
+        for (const QString &name : batch.names) {
+            if (m_cancelled.loadRelaxed()) {
+                break;
+            }
+            if (dir.unlink(QFile::encodeName(name).constData())) {
+                m_removedFiles.ref();
+            } else {
+                failedPaths.append(Utils::concatPaths(batch.dirPath, name));
+            }
+        }
+#else
+        for (const QString &name : batch.names) {
+            if (m_cancelled.loadRelaxed()) {
+                break;
+            }
+            const QString path = Utils::concatPaths(batch.dirPath, name);
+            if (QFile::remove(path)) {
+                m_removedFiles.ref();
+            } else {
+                failedPaths.append(path);
+            }
+        }
+#endif
+        return failedPaths;
     }
+
+    QThreadPool m_pool;
+    QAtomicInt m_removedFiles;
+    QAtomicInt m_cancelled;
 };
 
 class DeleteJobPrivate : public KIO::JobPrivate
@@ -102,6 +166,14 @@ public:
     QTimer *m_reportTimer;
     DeleteJobIOWorker *m_ioworker = nullptr;
     QThread *m_thread = nullptr;
+    // Whether the local files were already handed to the IO worker;
+    // the ones it couldn't delete are then deleted using a job
+    bool m_localFilesBatched = false;
+    // What the IO worker is currently removing, in about the order it does it
+    QList<QUrl> m_batchedUrls;
+    // Progress of the worker deleting the current directory recursively, in entries
+    KIO::filesize_t m_treeEntries = 0;
+    KIO::filesize_t m_removedTreeEntries = 0;
 
     void statNextSrc();
     DeleteJobIOWorker *worker();
@@ -113,11 +185,11 @@ public:
     void slotReport();
     void slotStart();
     void slotEntries(KIO::Job *, const KIO::UDSEntryList &list);
+    int processedFiles() const;
 
-    /// Callback of worker rmfile
-    void rmFileResult(bool result, bool isLink);
-    /// Callback of worker rmdir
-    void rmdirResult(bool result);
+    bool removeLocalFiles();
+    /// Callback of worker removeFiles
+    void localFilesRemoved(const QStringList &failedPaths);
     void deleteFileUsingJob(const QUrl &url, bool isLink);
     void deleteDirUsingJob(const QUrl &url);
 
@@ -168,6 +240,7 @@ DeleteJob::~DeleteJob()
 DeleteJobPrivate::~DeleteJobPrivate()
 {
     if (m_thread) {
+        m_ioworker->cancel();
         m_thread->quit();
         m_thread->wait();
         delete m_thread;
@@ -194,11 +267,8 @@ DeleteJobIOWorker *DeleteJobPrivate::worker()
         m_ioworker = new DeleteJobIOWorker;
         m_ioworker->moveToThread(m_thread);
         QObject::connect(m_thread, &QThread::finished, m_ioworker, &QObject::deleteLater);
-        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmfileResult, q, [=, this](bool result, bool isLink) {
-            this->rmFileResult(result, isLink);
-        });
-        QObject::connect(m_ioworker, &DeleteJobIOWorker::rmddirResult, q, [=, this](bool result) {
-            this->rmdirResult(result);
+        QObject::connect(m_ioworker, &DeleteJobIOWorker::filesRemoved, q, [this](const QStringList &failedPaths) {
+            localFilesRemoved(failedPaths);
         });
         m_thread->start();
     }
@@ -206,9 +276,18 @@ DeleteJobIOWorker *DeleteJobPrivate::worker()
     return m_ioworker;
 }
 
+int DeleteJobPrivate::processedFiles() const
+{
+    return m_processedFiles + (m_ioworker ? m_ioworker->removedFiles() : 0);
+}
+
 void DeleteJobPrivate::slotReport()
 {
     Q_Q(DeleteJob);
+    if (!m_batchedUrls.isEmpty()) {
+        // The IO worker removes them in parallel, show roughly where it is
+        m_currentURL = m_batchedUrls.at(qMin<qsizetype>(m_ioworker->removedFiles(), m_batchedUrls.size() - 1));
+    }
     Q_EMIT q->deleting(q, m_currentURL);
 
     // TODO: maybe we could skip everything else when (flags & HideProgressInfo) ?
@@ -221,11 +300,14 @@ void DeleteJobPrivate::slotReport()
         break;
     case DELETEJOB_STATE_DELETING_DIRS:
         q->setProcessedAmount(KJob::Directories, m_processedDirs);
-        q->emitPercent(m_processedFiles + m_processedDirs, m_totalFilesDirs);
+        // The entries below a directory deleted recursively are only known to the worker
+        q->setTotalAmount(KJob::Items, m_treeEntries);
+        q->setProcessedAmount(KJob::Items, m_removedTreeEntries);
+        q->emitPercent(processedFiles() + m_processedDirs + m_removedTreeEntries, m_totalFilesDirs + m_treeEntries);
         break;
     case DELETEJOB_STATE_DELETING_FILES:
-        q->setProcessedAmount(KJob::Files, m_processedFiles);
-        q->emitPercent(m_processedFiles, m_totalFilesDirs);
+        q->setProcessedAmount(KJob::Files, processedFiles());
+        q->emitPercent(processedFiles(), m_totalFilesDirs);
         break;
     }
 }
@@ -334,22 +416,82 @@ void DeleteJobPrivate::finishedStatPhase()
     deleteNextFile();
 }
 
-void DeleteJobPrivate::rmFileResult(bool result, bool isLink)
+static QString localPath(const QUrl &url)
 {
-    if (result) {
-        m_processedFiles++;
+    return url.adjusted(QUrl::StripTrailingSlash).toLocalFile();
+}
 
-        if (isLink) {
-            symlinks.removeFirst();
-        } else {
-            files.removeFirst();
+// Whether @p url can be deleted by the IO worker, i.e. relative to its parent directory ("/" can't)
+static bool isBatchable(const QUrl &url)
+{
+    if (!url.isLocalFile()) {
+        return false;
+    }
+    const QString path = localPath(url);
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    return slash != -1 && slash != path.size() - 1;
+}
+
+// Groups the local URLs of @p urls by parent directory
+static QList<DeleteJobBatch> localBatches(const QList<QUrl> &urls)
+{
+    QList<DeleteJobBatch> batches;
+    QHash<QString, qsizetype> batchForDir;
+    for (const QUrl &url : urls) {
+        if (!isBatchable(url)) {
+            continue;
         }
+        const QString path = localPath(url);
+        const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+        const QString dirPath = slash == 0 ? QStringLiteral("/") : path.left(slash);
+        auto it = batchForDir.constFind(dirPath);
+        if (it == batchForDir.cend()) {
+            it = batchForDir.insert(dirPath, batches.size());
+            batches.append({dirPath, {}});
+        }
+        batches[*it].names.append(path.mid(slash + 1));
+    }
+    return batches;
+}
 
-        deleteNextFile();
-    } else {
-        // fallback if QFile::remove() failed (we'll use the job's error handling in that case)
-        deleteFileUsingJob(m_currentURL, isLink);
+bool DeleteJobPrivate::removeLocalFiles()
+{
+    for (const QUrl &url : files + symlinks) {
+        if (isBatchable(url)) {
+            m_batchedUrls.append(url);
+        }
     }
+    if (m_batchedUrls.isEmpty()) {
+        return false;
+    }
+
+    const QList<DeleteJobBatch> batches = localBatches(m_batchedUrls);
+    m_currentURL = m_batchedUrls.first();
+    // Hand all the local files over at once, the worker reports back when they're all done
+    DeleteJobIOWorker *w = worker();
+    QMetaObject::invokeMethod(
+        w,
+        [w, batches]() {
+            w->removeFiles(batches);
+        },
+        Qt::QueuedConnection);
+    return true;
+}
+
+void DeleteJobPrivate::localFilesRemoved(const QStringList &failedPaths)
+{
+    // Keep the remote files, and the local ones the worker couldn't delete:
+    // deleting them using a job gives proper error handling
+    const QSet<QUrl> batched(m_batchedUrls.cbegin(), m_batchedUrls.cend());
+    const QSet<QString> failed(failedPaths.cbegin(), failedPaths.cend());
+    const auto wasRemoved = [&batched, &failed](const QUrl &url) {
+        return batched.contains(url) && !failed.contains(localPath(url));
+    };
+    files.removeIf(wasRemoved);
+    symlinks.removeIf(wasRemoved);
+    m_batchedUrls.clear();
+
+    deleteNextFile();
 }
 
 void DeleteJobPrivate::deleteFileUsingJob(const QUrl &url, bool isLink)
@@ -377,8 +519,15 @@ void DeleteJobPrivate::deleteNextFile()
 {
     // qDebug();
 
+    if (!m_localFilesBatched) {
+        m_localFilesBatched = true;
+        if (removeLocalFiles()) {
+            return;
+        }
+    }
+
     // if there is something else to delete
-    // the loop is run using callbacks slotResult and rmFileResult
+    // the loop is run using callbacks slotResult
     if (!files.isEmpty() || !symlinks.isEmpty()) {
         // Take first file to delete out of list
         QList<QUrl>::iterator it = files.begin();
@@ -387,19 +536,7 @@ void DeleteJobPrivate::deleteNextFile()
             it = symlinks.begin(); // Pick up a symlink to delete
         }
         m_currentURL = (*it);
-
-        // If local file, try do it directly
-        if (m_currentURL.isLocalFile()) {
-            // separate thread will do the work
-            DeleteJobIOWorker *w = worker();
-            auto rmfileFunc = [this, w, isLink]() {
-                w->rmfile(m_currentURL, isLink);
-            };
-            QMetaObject::invokeMethod(w, rmfileFunc, Qt::QueuedConnection);
-        } else {
-            // if remote, use a job
-            deleteFileUsingJob(m_currentURL, isLink);
-        }
+        deleteFileUsingJob(m_currentURL, isLink);
         return;
     }
 
@@ -407,18 +544,6 @@ void DeleteJobPrivate::deleteNextFile()
     deleteNextDir();
 }
 
-void DeleteJobPrivate::rmdirResult(bool result)
-{
-    if (result) {
-        m_processedDirs++;
-        dirs.removeLast();
-        deleteNextDir();
-    } else {
-        // fallback
-        deleteDirUsingJob(m_currentURL);
-    }
-}
-
 void DeleteJobPrivate::deleteDirUsingJob(const QUrl &url)
 {
     Q_Q(DeleteJob);
@@ -428,6 +553,20 @@ void DeleteJobPrivate::deleteDirUsingJob(const QUrl &url)
     SimpleJob *job = KIO::rmdir(url);
     job->setParentJob(q);
     job->addMetaData(QStringLiteral("recurse"), QStringLiteral("true"));
+    // A worker deleting recursively reports how many entries it found and removed so far
+    // as the total and processed size of the job
+    const KIO::filesize_t treeEntriesBefore = m_treeEntries;
+    const KIO::filesize_t removedTreeEntriesBefore = m_removedTreeEntries;
+    QObject::connect(job, &KJob::totalAmountChanged, q, [this, treeEntriesBefore](KJob *, KJob::Unit unit, qulonglong amount) {
+        if (unit == KJob::Bytes) {
+            m_treeEntries = treeEntriesBefore + amount;
+        }
+    });
+    QObject::connect(job, &KJob::processedAmountChanged, q, [this, removedTreeEntriesBefore](KJob *, KJob::Unit unit, qulonglong amount) {
+        if (unit == KJob::Bytes) {
+            m_removedTreeEntries = removedTreeEntriesBefore + amount;
+        }
+    });
     dirs.removeLast();
     q->addSubjob(job);
 }
@@ -438,21 +577,11 @@ void DeleteJobPrivate::deleteNextDir()
 
     if (!dirs.isEmpty()) { // some dirs to delete ?
 
-        // the loop is run using callbacks slotResult and rmdirResult
+        // the loop is run using callbacks slotResult
         // Take first dir to delete out of list - last ones first !
         QList<QUrl>::iterator it = --dirs.end();
         m_currentURL = (*it);
-        // If local dir, try to rmdir it directly
-        if (m_currentURL.isLocalFile()) {
-            // delete it on separate worker thread
-            DeleteJobIOWorker *w = worker();
-            auto rmdirFunc = [this, w]() {
-                w->rmdir(m_currentURL);
-            };
-            QMetaObject::invokeMethod(w, rmdirFunc, Qt::QueuedConnection);
-        } else {
-            deleteDirUsingJob(m_currentURL);
-        }
+        deleteDirUsingJob(m_currentURL);
         return;
     }
 
@@ -471,8 +600,10 @@ void DeleteJobPrivate::deleteNextDir()
     }
     // display final numbers
     q->setProcessedAmount(KJob::Directories, m_processedDirs);
-    q->setProcessedAmount(KJob::Files, m_processedFiles);
-    q->emitPercent(m_processedFiles + m_processedDirs, m_totalFilesDirs);
+    q->setProcessedAmount(KJob::Files, processedFiles());
+    q->setTotalAmount(KJob::Items, m_treeEntries);
+    q->setProcessedAmount(KJob::Items, m_removedTreeEntries);
+    q->emitPercent(processedFiles() + m_processedDirs + m_removedTreeEntries, m_totalFilesDirs + m_treeEntries);
 
     q->emitResult();
 }
@@ -324,6 +324,10 @@ void FileCopyJobPrivate::startDataPump()
     if (m_modificationTime.isValid()) {
         m_putJob->setModificationTime(m_modificationTime);
     }
+    if (m_sourceSize != (KIO::filesize_t)-1) {
+        // Lets e.g. kio_http send the data as it comes, with a Content-Length
+        m_putJob->addMetaData(QStringLiteral("size"), KIO::number(m_sourceSize));
+    }
 
     // The first thing the put job will tell us is whether we can
     // resume or not (this is always emitted)
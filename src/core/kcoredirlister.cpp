@@ -16,6 +16,7 @@
 #include "kiocoredebug.h"
 #include "kmountpoint.h"
 #include <kio/listjob.h>
+#include <kio/statmultiplejob.h>
 
 #include <KJobUiDelegate>
 #include <KLocalizedString>
@@ -27,6 +28,7 @@
 #include <QRegularExpression>
 #include <QTextStream>
 #include <QThreadStorage>
+#include <qplatformdefs.h>
 
 #include <QLoggingCategory>
 Q_DECLARE_LOGGING_CATEGORY(KIO_CORE_DIRLISTER)
@@ -1047,6 +1049,8 @@ void KCoreDirListerCache::slotFileDirty(const QString &path)
     if (isDir) {
         const QList<QUrl> urls = directoriesForCanonicalPath(url);
         for (const QUrl &dir : urls) {
+            // We don't know which entries changed in there
+            unnamedDirectoryEvents.insert(dir.toLocalFile());
             handleDirDirty(dir);
         }
     }
@@ -1062,23 +1066,9 @@ void KCoreDirListerCache::slotFileDirty(const QString &path)
 // Called by slotFileDirty
 void KCoreDirListerCache::handleDirDirty(const QUrl &url)
 {
-    // A dir: launch an update job if anyone cares about it
-
-    // This also means we can forget about pending updates to individual files in that dir
+    // A dir: update it if anyone cares about it
+    // (processPendingUpdates decides between syncing it by name and listing it again)
     const QString dir = url.toLocalFile();
-    const QString dirPath = Utils::slashAppended(dir);
-
-    for (auto pendingIt = pendingUpdates.cbegin(); pendingIt != pendingUpdates.cend(); /* */) {
-        const QString updPath = *pendingIt;
-        qCDebug(KIO_CORE_DIRLISTER) << "had pending update" << updPath;
-        if (updPath.startsWith(dirPath) && updPath.indexOf(QLatin1Char('/'), dirPath.length()) == -1) { // direct child item
-            qCDebug(KIO_CORE_DIRLISTER) << "forgetting about individual update to" << updPath;
-            pendingIt = pendingUpdates.erase(pendingIt);
-        } else {
-            ++pendingIt;
-        }
-    }
-
     if (checkUpdate(url)) {
         const auto [it, isInserted] = pendingDirectoryUpdates.insert(dir);
         if (isInserted && !pendingUpdateTimer.isActive()) {
@@ -1094,8 +1084,11 @@ void KCoreDirListerCache::handleFileDirty(const QUrl &url)
     const KFileItem &existingItem = findByUrl(nullptr, url);
     const QUrl dir = url.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
     if (existingItem.isNull()) {
-        // No - update the parent dir then
+        // No - update the parent dir then, we know the name of the new entry
+        namedDirectoryEvents[dir.toLocalFile()].insert(url.fileName());
         handleDirDirty(dir);
+    } else {
+        namedDirectoryEvents[dir.toLocalFile()];
     }
 
     // Delay updating the file, FAM is flooding us with events
@@ -1111,10 +1104,21 @@ void KCoreDirListerCache::handleFileDirty(const QUrl &url)
 void KCoreDirListerCache::slotFileCreated(const QString &path) // from KDirWatch
 {
     qCDebug(KIO_CORE_DIRLISTER) << path;
-    // XXX: how to avoid a complete rescan here?
-    // We'd need to stat that one file separately and refresh the item(s) for it.
-    QUrl fileUrl(QUrl::fromLocalFile(path));
-    itemsAddedInDirectory(fileUrl.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash));
+    const QUrl fileUrl = QUrl::fromLocalFile(path);
+    const QUrl dirUrl = fileUrl.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+    bool handled = false;
+    const QList<QUrl> urls = directoriesForCanonicalPath(dirUrl);
+    for (const QUrl &dir : urls) {
+        // We know the name of the new entry, so only that one will need a stat
+        if (itemsInUse.contains(dir)) {
+            namedDirectoryEvents[dir.toLocalFile()].insert(fileUrl.fileName());
+            handleDirDirty(dir);
+            handled = true;
+        }
+    }
+    if (!handled) {
+        itemsAddedInDirectory(dirUrl);
+    }
 }
 
 void KCoreDirListerCache::slotFileDeleted(const QString &path) // from KDirWatch
@@ -1125,6 +1129,8 @@ void KCoreDirListerCache::slotFileDeleted(const QString &path) // from KDirWatch
     QStringList fileUrls;
     const QList<QUrl> urls = directoriesForCanonicalPath(dirUrl.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash));
     for (const QUrl &url : urls) {
+        // Nothing more to do for that directory than removing the item
+        namedDirectoryEvents[url.toLocalFile()];
         QUrl urlInfo(url);
         urlInfo.setPath(Utils::concatPaths(urlInfo.path(), fileName));
         fileUrls << urlInfo.toString();
@@ -1994,6 +2000,46 @@ void KCoreDirListerCache::deleteDir(const QUrl &_dirUrl)
 // delayed updating of files, FAM is flooding us with events
 void KCoreDirListerCache::processPendingUpdates()
 {
+    // Directories for which KDirWatch told us which entries changed are synced by name.
+    // Those it only told us changed get the names of their entries compared with the items.
+    // The others (not listed yet, or being listed) have to be listed again.
+    std::map<QUrl, std::set<QString>> dirsToSync; // with the names of the new entries
+    QList<QUrl> dirsToCompare;
+    QList<QUrl> dirsToRelist;
+    for (const QString &dir : pendingDirectoryUpdates) {
+        const QUrl dirUrl = QUrl::fromLocalFile(dir);
+        const DirItem *dirItem = itemsInUse.value(dirUrl);
+        if (dirItem && dirItem->complete && !jobForUrl(dirUrl)) {
+            if (unnamedDirectoryEvents.find(dir) != unnamedDirectoryEvents.end()) {
+                dirsToCompare.append(dirUrl);
+                continue;
+            }
+            const auto namedIt = namedDirectoryEvents.find(dir);
+            if (namedIt != namedDirectoryEvents.end()) {
+                if (!namedIt->second.empty()) {
+                    dirsToSync.emplace(dirUrl, std::move(namedIt->second));
+                }
+                continue;
+            }
+        }
+        dirsToRelist.append(dirUrl);
+
+        // The listing will refresh the files in that dir, forget about pending updates to them
+        const QString dirPath = Utils::slashAppended(dir);
+        for (auto pendingIt = pendingUpdates.cbegin(); pendingIt != pendingUpdates.cend(); /* */) {
+            const QString updPath = *pendingIt;
+            if (updPath.startsWith(dirPath) && updPath.indexOf(QLatin1Char('/'), dirPath.length()) == -1) { // direct child item
+                qCDebug(KIO_CORE_DIRLISTER) << "forgetting about individual update to" << updPath;
+                pendingIt = pendingUpdates.erase(pendingIt);
+            } else {
+                ++pendingIt;
+            }
+        }
+    }
+    pendingDirectoryUpdates.clear();
+    namedDirectoryEvents.clear();
+    unnamedDirectoryEvents.clear();
+
     std::set<KCoreDirLister *> listers;
     QList<QUrl> removedUrls;
     for (const QString &file : pendingUpdates) { // always a local path
@@ -2026,10 +2072,129 @@ void KCoreDirListerCache::processPendingUpdates()
     }
 
     // Directories in need of updating
-    for (const QString &dir : pendingDirectoryUpdates) {
-        updateDirectory(QUrl::fromLocalFile(dir));
+    for (const auto &[dir, names] : dirsToSync) {
+        addLocalEntries(dir, names);
+    }
+    for (const QUrl &dir : std::as_const(dirsToCompare)) {
+        syncLocalEntries(dir);
+    }
+    for (const QUrl &dir : std::as_const(dirsToRelist)) {
+        updateDirectory(dir);
+    }
+}
+
+// Reads the names of the entries of the local directory @p path, without stat'ing them
+static bool readEntryNames(const QString &path, std::set<QString> &names)
+{
+#ifdef Q_OS_UNIX
+    QT_DIR *dp = QT_OPENDIR(QFile::encodeName(path).constData());
+    if (!dp) {
+        return false;
+    }
+    while (const QT_DIRENT *ep = QT_READDIR(dp)) {
+        if (qstrcmp(ep->d_name, ".") != 0 && qstrcmp(ep->d_name, "..") != 0) {
+            names.insert(QFile::decodeName(ep->d_name));
+        }
+    }
+    QT_CLOSEDIR(dp);
+    return true;
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(names)
+    return false;
+#endif
+}
+
+void KCoreDirListerCache::syncLocalEntries(const QUrl &dirUrl)
+{
+    DirItem *dirItem = itemsInUse.value(dirUrl);
+    std::set<QString> names;
+    if (!dirItem || !readEntryNames(dirUrl.toLocalFile(), names)) {
+        updateDirectory(dirUrl);
+        return;
+    }
+
+    // What's left of the names once those of the items are taken out is new
+    QList<QUrl> removedUrls;
+    for (const KFileItem &item : std::as_const(dirItem->lstItems)) {
+        if (names.erase(item.name()) == 0) {
+            removedUrls.append(item.url());
+        }
+    }
+    qCDebug(KIO_CORE_DIRLISTER) << dirUrl << removedUrls.size() << "entries gone";
+
+    if (!removedUrls.isEmpty()) {
+        slotFilesRemoved(removedUrls);
+    }
+    if (!names.empty()) {
+        addLocalEntries(dirUrl, names);
+    }
+}
+
+void KCoreDirListerCache::addLocalEntries(const QUrl &dirUrl, const std::set<QString> &names)
+{
+    qCDebug(KIO_CORE_DIRLISTER) << dirUrl << names.size() << "new entries";
+
+    QList<QUrl> urls;
+    urls.reserve(names.size());
+    for (const QString &name : names) {
+        QUrl url(dirUrl);
+        url.setPath(Utils::concatPaths(url.path(), name));
+        urls.append(url);
+    }
+
+    // Stat them all in one go, and not in this thread
+    KIO::StatMultipleJob *job = KIO::statMultiple(urls, KIO::StatJob::SourceSide, KIO::StatDefaultDetails, KIO::HideProgressInfo);
+    connect(job, &KJob::result, this, [this, dirUrl, job]() {
+        slotLocalEntriesStated(dirUrl, job);
+    });
+}
+
+void KCoreDirListerCache::slotLocalEntriesStated(const QUrl &dirUrl, KIO::StatMultipleJob *job)
+{
+    DirItem *dirItem = itemsInUse.value(dirUrl);
+    if (job->error() || !dirItem || !dirItem->complete || jobForUrl(dirUrl)) {
+        return; // gone, or being listed again: the listing will have the new entries
+    }
+
+    bool delayedMimeTypes = true;
+    const QList<KCoreDirLister *> listers = directoryData.value(dirUrl).listersCurrentlyHolding;
+    for (const KCoreDirLister *kdl : listers) {
+        delayedMimeTypes &= kdl->d->delayedMimeTypes;
+    }
+
+    CacheHiddenFile *cachedHidden = cachedDotHiddenForDir(dirUrl.toLocalFile());
+    const QList<KIO::UDSEntry> entries = job->statResults();
+    const QList<int> errors = job->errors();
+    KFileItemList newItems;
+    for (int i = 0; i < entries.size(); ++i) {
+        if (errors.at(i) != 0) {
+            continue; // already gone again
+        }
+        KFileItem item(entries.at(i), dirUrl, delayedMimeTypes, true);
+        if (!findByUrl(nullptr, item.url()).isNull()) {
+            continue; // added by a listing in the meantime
+        }
+        if (cachedHidden && cachedHidden->listedFiles.find(item.name()) != cachedHidden->listedFiles.cend()) {
+            item.setHidden();
+        }
+        qCDebug(KIO_CORE_DIRLISTER) << "new file:" << item.name();
+        newItems.append(item);
+    }
+    if (newItems.isEmpty()) {
+        return;
+    }
+
+    // sort by url using KFileItem::operator<
+    std::sort(newItems.begin(), newItems.end());
+
+    // Add the items sorted by url, needed by findByUrl
+    dirItem->insertSortedItems(newItems);
+
+    for (KCoreDirLister *kdl : listers) {
+        kdl->d->addNewItems(dirUrl, newItems);
+        kdl->d->emitItems();
     }
-    pendingDirectoryUpdates.clear();
 }
 
 #ifndef NDEBUG
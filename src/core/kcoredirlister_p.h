@@ -27,6 +27,7 @@
 #include <KDirWatch>
 #include <kio/global.h>
 
+#include <map>
 #include <set>
 
 class QRegularExpression;
@@ -35,6 +36,7 @@ namespace KIO
 {
 class Job;
 class ListJob;
+class StatMultipleJob;
 }
 class OrgKdeKDirNotifyInterface;
 struct KCoreDirListerCacheDirectoryData;
@@ -288,6 +290,16 @@ private:
     void handleFileDirty(const QUrl &url);
     void handleDirDirty(const QUrl &url);
 
+    // Brings the local directory @p dir up to date without listing it again, when
+    // KDirWatch told us the @p names of the new entries: only those are stat'ed,
+    // by a KIO::StatMultipleJob, and added once slotLocalEntriesStated() gets them.
+    void addLocalEntries(const QUrl &dir, const std::set<QString> &names);
+    void slotLocalEntriesStated(const QUrl &dir, KIO::StatMultipleJob *job);
+    // Same when KDirWatch only told us that the local directory @p dir changed: the names of
+    // its entries are read, without stat'ing them, the items whose name is gone are removed
+    // and the new names go to addLocalEntries(). Lists it again if it can't be read.
+    void syncLocalEntries(const QUrl &dir);
+
     // when there were items deleted from the filesystem all the listers holding
     // the parent directory need to be notified, the items have to be deleted
     // and removed from the cache including all the children.
@@ -529,6 +541,14 @@ private:
     // We temporize the notifications by keeping them 500ms in this list.
     std::set<QString /*path*/> pendingUpdates;
     std::set<QString /*path*/> pendingDirectoryUpdates;
+    // Directories for which KDirWatch reported changes to named entries since the
+    // last pending update, with the names of the new entries: those directories
+    // are updated by name instead of being listed again.
+    std::map<QString /*path*/, std::set<QString> /*names*/> namedDirectoryEvents;
+    // Directories that got a dirty event for the directory itself since the last
+    // pending update: the names of their entries are compared with the items,
+    // whatever named events came along, see syncLocalEntries().
+    std::set<QString /*path*/> unnamedDirectoryEvents;
     // The timer for doing the delayed updates
     QTimer pendingUpdateTimer;
 
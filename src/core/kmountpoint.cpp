@@ -7,6 +7,7 @@
 */
 
 #include "kmountpoint.h"
+#include "kmountpoint_p.h"
 
 #include <stdlib.h>
 
@@ -48,6 +49,14 @@ static const Qt::CaseSensitivity cs = Qt::CaseSensitive;
 // Linux
 #if HAVE_LIB_MOUNT
 #include <libmount/libmount.h>
+
+#include <QHash>
+#include <QMutex>
+
+#include <fcntl.h>
+#include <optional>
+#include <poll.h>
+#include <unistd.h>
 #endif
 
 static bool isNetfs(const QString &mountType)
@@ -75,6 +84,9 @@ static bool isNetfs(const QString &mountType)
 class KMountPointPrivate
 {
 public:
+#if HAVE_LIB_MOUNT
+    static KMountPoint::List readMountTable(KMountPoint::DetailsNeededFlags infoNeeded);
+#endif
     void resolveGvfsMountPoints(KMountPoint::List &result);
     void finalizePossibleMountPoint(KMountPoint::DetailsNeededFlags infoNeeded);
     void finalizeCurrentMountPoint(KMountPoint::DetailsNeededFlags infoNeeded);
@@ -88,6 +100,107 @@ public:
     bool m_isNetFs = false;
 };
 
+#if HAVE_LIB_MOUNT
+namespace
+{
+/*
+ * The mount table, as parsed by libmount, shared by the whole process.
+ * Parsing it is expensive with many (bind) mounts, while it hardly ever changes:
+ * the kernel tells us when it does by flagging /proc/self/mountinfo with POLLPRI.
+ */
+class MountTableCache
+{
+public:
+    MountTableCache()
+    {
+        m_mountInfoFd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    }
+
+    ~MountTableCache()
+    {
+        if (m_mountInfoFd != -1) {
+            ::close(m_mountInfoFd);
+        }
+    }
+
+    KMountPoint::List mountTable(KMountPoint::DetailsNeededFlags infoNeeded)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_mountInfoFd == -1) {
+            // No way to know when the table changes, don't cache it
+            return KMountPointPrivate::readMountTable(infoNeeded);
+        }
+
+        dropIfChanged();
+        auto it = m_tables.constFind(infoNeeded.toInt());
+        if (it == m_tables.cend()) {
+            it = m_tables.insert(infoNeeded.toInt(), KMountPointPrivate::readMountTable(infoNeeded));
+
+            // Index the new table by device ID, for findByPath()
+            QHash<dev_t, QList<int>> &byDevice = m_deviceIndexes[it->constData()];
+            for (int i = 0; i < it->size(); ++i) {
+                byDevice[it->at(i)->deviceId()].append(i);
+            }
+        }
+        return *it;
+    }
+
+    // Returns the indexes in @p list of the mount points on @p deviceId,
+    // or nullopt if @p list isn't a table of the cache, i.e. has to be searched
+    std::optional<QList<int>> mountPointsOnDevice(const KMountPoint::List &list, dev_t deviceId)
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_deviceIndexes.constFind(list.constData());
+        if (it == m_deviceIndexes.cend()) {
+            return std::nullopt;
+        }
+        return it->value(deviceId);
+    }
+
+    // Returns false if nothing is ever cached
+    bool invalidate()
+    {
+        QMutexLocker locker(&m_mutex);
+        drop();
+        return m_mountInfoFd != -1;
+    }
+
+private:
+    void dropIfChanged()
+    {
+        pollfd pfd{m_mountInfoFd, POLLPRI, 0};
+        if (::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+            drop();
+        }
+    }
+
+    void drop()
+    {
+        // The indexes go with the tables: once a table is only held by callers
+        // of currentMountPoints(), its data can't be mistaken for a cached one
+        m_deviceIndexes.clear();
+        m_tables.clear();
+    }
+
+    QMutex m_mutex;
+    int m_mountInfoFd = -1;
+    QHash<int /*DetailsNeededFlags*/, KMountPoint::List> m_tables;
+    QHash<const KMountPoint::Ptr *, QHash<dev_t, QList<int>>> m_deviceIndexes;
+};
+}
+
+Q_GLOBAL_STATIC(MountTableCache, s_mountTableCache)
+#endif
+
+bool _invalidateMountTableCache()
+{
+#if HAVE_LIB_MOUNT
+    return s_mountTableCache()->invalidate();
+#else
+    return false;
+#endif
+}
+
 KMountPoint::KMountPoint()
     : d(new KMountPointPrivate)
 {
@@ -282,6 +395,56 @@ void KMountPointPrivate::resolveGvfsMountPoints(KMountPoint::List &result)
     }
 }
 
+#if HAVE_LIB_MOUNT
+KMountPoint::List KMountPointPrivate::readMountTable(KMountPoint::DetailsNeededFlags infoNeeded)
+{
+    KMountPoint::List result;
+    if (struct libmnt_table *table = mnt_new_table()) {
+        // if "/etc/mtab" is a regular file,
+        // "/etc/mtab" is used by default instead of "/proc/self/mountinfo" file.
+        // This leads to NTFS mountpoints being hidden.
+        if (
+#if QT_VERSION_CHECK(LIBMOUNT_MAJOR_VERSION, LIBMOUNT_MINOR_VERSION, LIBMOUNT_PATCH_VERSION) >= QT_VERSION_CHECK(2, 39, 0)
+            mnt_table_parse_mtab(table, nullptr)
+#else // backwards compat, the documentation advises to use nullptr so lets do that whenever possible
+            mnt_table_parse_mtab(table, "/proc/self/mountinfo")
+#endif
+            == 0) {
+            struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+            struct libmnt_fs *fs;
+
+            while (mnt_table_next_fs(table, itr, &fs) == 0) {
+                KMountPoint::Ptr mp(new KMountPoint);
+                mp->d->m_mountedFrom = QFile::decodeName(mnt_fs_get_source(fs));
+                mp->d->m_mountPoint = QFile::decodeName(mnt_fs_get_target(fs));
+                mp->d->m_mountType = QFile::decodeName(mnt_fs_get_fstype(fs));
+                mp->d->m_isNetFs = mnt_fs_is_netfs(fs) == 1;
+                mp->d->m_deviceId = mnt_fs_get_devno(fs);
+
+                if (infoNeeded & KMountPoint::NeedMountOptions) {
+                    mp->d->m_mountOptions = QFile::decodeName(mnt_fs_get_options(fs)).split(QLatin1Char(','));
+                }
+
+                if (infoNeeded & KMountPoint::NeedRealDeviceName) {
+                    if (mp->d->m_mountedFrom.startsWith(QLatin1Char('/'))) {
+                        mp->d->m_device = mp->d->m_mountedFrom;
+                    }
+                }
+
+                mp->d->finalizeCurrentMountPoint(infoNeeded);
+                result.push_back(mp);
+            }
+
+            mnt_free_iter(itr);
+        }
+
+        mnt_free_table(table);
+    }
+
+    return result;
+}
+#endif
+
 KMountPoint::List KMountPoint::currentMountPoints(DetailsNeededFlags infoNeeded)
 {
     KMountPoint::List result;
@@ -339,48 +502,20 @@ KMountPoint::List KMountPoint::currentMountPoints(DetailsNeededFlags infoNeeded)
     }
 
 #elif HAVE_LIB_MOUNT
-    if (struct libmnt_table *table = mnt_new_table()) {
-        // if "/etc/mtab" is a regular file,
-        // "/etc/mtab" is used by default instead of "/proc/self/mountinfo" file.
-        // This leads to NTFS mountpoints being hidden.
-        if (
-#if QT_VERSION_CHECK(LIBMOUNT_MAJOR_VERSION, LIBMOUNT_MINOR_VERSION, LIBMOUNT_PATCH_VERSION) >= QT_VERSION_CHECK(2, 39, 0)
-            mnt_table_parse_mtab(table, nullptr)
-#else // backwards compat, the documentation advises to use nullptr so lets do that whenever possible
-            mnt_table_parse_mtab(table, "/proc/self/mountinfo")
-#endif
-            == 0) {
-            struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
-            struct libmnt_fs *fs;
-
-            while (mnt_table_next_fs(table, itr, &fs) == 0) {
-                Ptr mp(new KMountPoint);
-                mp->d->m_mountedFrom = QFile::decodeName(mnt_fs_get_source(fs));
-                mp->d->m_mountPoint = QFile::decodeName(mnt_fs_get_target(fs));
-                mp->d->m_mountType = QFile::decodeName(mnt_fs_get_fstype(fs));
-                mp->d->m_isNetFs = mnt_fs_is_netfs(fs) == 1;
-                mp->d->m_deviceId = mnt_fs_get_devno(fs);
+    const KMountPoint::List table = s_mountTableCache()->mountTable(infoNeeded);
 
-                if (infoNeeded & NeedMountOptions) {
-                    mp->d->m_mountOptions = QFile::decodeName(mnt_fs_get_options(fs)).split(QLatin1Char(','));
-                }
-
-                if (infoNeeded & NeedRealDeviceName) {
-                    if (mp->d->m_mountedFrom.startsWith(QLatin1Char('/'))) {
-                        mp->d->m_device = mp->d->m_mountedFrom;
-                    }
-                }
-
-                mp->d->resolveGvfsMountPoints(result);
-
-                mp->d->finalizeCurrentMountPoint(infoNeeded);
-                result.push_back(mp);
-            }
-
-            mnt_free_iter(itr);
-        }
+    // gvfs mounts come and go below the gvfsd-fuse mount point, without any change of the mount table
+    const bool hasGvfs = std::any_of(table.cbegin(), table.cend(), [](const Ptr &mp) {
+        return mp->d->m_mountedFrom == QLatin1String("gvfsd-fuse");
+    });
+    if (!hasGvfs) {
+        return table;
+    }
 
-        mnt_free_table(table);
+    result.reserve(table.size());
+    for (const Ptr &mp : table) {
+        mp->d->resolveGvfsMountPoints(result);
+        result.push_back(mp);
     }
 #endif
 
@@ -441,6 +576,18 @@ KMountPoint::Ptr KMountPoint::List::findByPath(const QString &path) const
     KMountPoint::Ptr result;
 
     if (QT_STATBUF buff; QT_LSTAT(QFile::encodeName(realPath).constData(), &buff) == 0) {
+#if HAVE_LIB_MOUNT
+        // Only look at the mount points of the right device, if we know which ones they are
+        if (const auto indexes = s_mountTableCache()->mountPointsOnDevice(*this, buff.st_dev)) {
+            for (int index : *indexes) {
+                const KMountPoint::Ptr &mountPtr = at(index);
+                if (realPath.startsWith(mountPtr->mountPoint())) {
+                    return mountPtr;
+                }
+            }
+            return result;
+        }
+#endif
         auto it = std::find_if(this->cbegin(), this->cend(), [&buff, &realPath](const KMountPoint::Ptr &mountPtr) {
             // For a bind mount, the deviceId() is that of the base mount point, e.g. /mnt/foo,
             // however the path we're looking for, e.g. /home/user/bar, doesn't start with the
@@ -0,0 +1,21 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2007 David Faure <faure@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KMOUNTPOINT_P_H
+#define KMOUNTPOINT_P_H
+
+#include "kiocore_export.h"
+
+/**
+ * Drops the mount tables cached by KMountPoint::currentMountPoints(), as a change
+ * of the mount table does. For the unit tests.
+ * Returns false if the mount table isn't cached at all on this system.
+ * @internal
+ */
+KIOCORE_EXPORT bool _invalidateMountTableCache();
+
+#endif
@@ -46,6 +46,8 @@ KProtocolInfoPrivate::KProtocolInfoPrivate(const QString &name, const QString &e
     m_canRenameFromFile = json.value(QStringLiteral("renameFromFile")).toBool();
     m_canRenameToFile = json.value(QStringLiteral("renameToFile")).toBool();
     m_canDeleteRecursive = json.value(QStringLiteral("deleteRecursive")).toBool();
+    m_canListRecursive = json.value(QStringLiteral("listRecursive")).toBool();
+    m_canStatMultiple = json.value(QStringLiteral("statMultiple")).toBool();
 
     // default is "FromURL"
     const QString fnu = json.value(QStringLiteral("fileNameUsedForCopying")).toString();
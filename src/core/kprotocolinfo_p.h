@@ -46,6 +46,8 @@ public:
     bool m_canRenameFromFile : 1;
     bool m_canRenameToFile : 1;
     bool m_canDeleteRecursive : 1;
+    bool m_canListRecursive : 1;
+    bool m_canStatMultiple : 1;
     bool m_supportsPermissions : 1;
     QString m_defaultMimetype;
     QString m_icon;
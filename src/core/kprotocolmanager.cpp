@@ -336,6 +336,26 @@ bool KProtocolManager::canDeleteRecursive(const QUrl &url)
     return prot->m_canDeleteRecursive;
 }
 
+bool KProtocolManager::canListRecursive(const QUrl &url)
+{
+    KProtocolInfoPrivate *prot = findProtocol(url);
+    if (!prot) {
+        return false;
+    }
+
+    return prot->m_canListRecursive;
+}
+
+bool KProtocolManager::canStatMultiple(const QUrl &url)
+{
+    KProtocolInfoPrivate *prot = findProtocol(url);
+    if (!prot) {
+        return false;
+    }
+
+    return prot->m_canStatMultiple;
+}
+
 KProtocolInfo::FileNameUsedForCopying KProtocolManager::fileNameUsedForCopying(const QUrl &url)
 {
     KProtocolInfoPrivate *prot = findProtocol(url);
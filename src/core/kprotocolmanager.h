@@ -293,6 +293,34 @@ public:
      */
     static bool canDeleteRecursive(const QUrl &url);
 
+    /**
+     * Returns whether the protocol can list directories recursively by itself.
+     * If not (the usual case) then a recursive ListJob starts one listing per
+     * subdirectory.
+     *
+     * This corresponds to the "listRecursive=" field in the protocol description file.
+     * Valid values for this field are "true" or "false" (default).
+     *
+     * @param url the url to check
+     * @return true if the protocol can list a whole directory tree in one go.
+     * @since 6.10
+     */
+    static bool canListRecursive(const QUrl &url);
+
+    /**
+     * Returns whether the protocol can stat several URLs in one request.
+     * If not (the usual case) then KIO::statMultiple() stats the URLs one
+     * after the other.
+     *
+     * This corresponds to the "statMultiple=" field in the protocol description file.
+     * Valid values for this field are "true" or "false" (default).
+     *
+     * @param url the url to check
+     * @return true if the protocol can stat several URLs in one go.
+     * @since 6.10
+     */
+    static bool canStatMultiple(const QUrl &url);
+
     /**
      * This setting defines the strategy to use for generating a filename, when
      * copying a file or directory to another directory. By default the destination
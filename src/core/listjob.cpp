@@ -9,7 +9,9 @@
 #include "listjob.h"
 #include "../utils_p.h"
 #include "job_p.h"
+#include "kprotocolmanager.h"
 #include "worker_p.h"
+#include <QHash>
 #include <QTimer>
 #include <kurlauthorized.h>
 
@@ -27,6 +29,7 @@ public:
         , m_prefix(prefix)
         , m_displayPrefix(displayPrefix)
         , m_processedEntries(0)
+        , m_workerRecursion(false)
     {
     }
     bool recursive;
@@ -34,6 +37,10 @@ public:
     QString m_prefix;
     QString m_displayPrefix;
     unsigned long m_processedEntries;
+    // true when the worker walks the whole tree itself (listRecursive in the protocol file)
+    bool m_workerRecursion;
+    // With m_workerRecursion: display path of each directory listed so far, by name ("subdir/dir")
+    QHash<QString, QString> m_displayPaths;
     QUrl m_redirectionURL;
 
     /**
@@ -45,6 +52,8 @@ public:
     void start(Worker *worker) override;
 
     void slotListEntries(const KIO::UDSEntryList &list);
+    void setDisplayNames(KIO::UDSEntryList &list);
+    void listUnreadableDirs(const QStringList &names);
     void slotRedirection(const QUrl &url);
     void gotEntries(KIO::Job *subjob, const KIO::UDSEntryList &list);
     void slotSubError(ListJob *job, ListJob *subJob);
@@ -91,7 +100,7 @@ void ListJobPrivate::slotListEntries(const KIO::UDSEntryList &list)
     m_processedEntries += list.count();
     slotProcessedSize(m_processedEntries);
 
-    if (recursive) {
+    if (recursive && !m_workerRecursion) {
         UDSEntryList::ConstIterator it = list.begin();
         const UDSEntryList::ConstIterator end = list.end();
 
@@ -140,7 +149,18 @@ void ListJobPrivate::slotListEntries(const KIO::UDSEntryList &list)
     // Not recursive, or top-level of recursive listing : return now (send . and .. as well)
     // exclusion of hidden files also requires the full sweep, but the case for full-listing
     // a single dir is probably common enough to justify the shortcut
-    if (m_prefix.isNull() && includeHidden) {
+    if (m_workerRecursion) {
+        UDSEntryList newlist = list;
+        if (!includeHidden) {
+            // The worker only leaves out the hidden entries below the listed directory
+            auto removeFunc = [](const UDSEntry &entry) {
+                return entry.stringValue(KIO::UDSEntry::UDS_NAME).startsWith(QLatin1Char('.'));
+            };
+            newlist.erase(std::remove_if(newlist.begin(), newlist.end(), removeFunc), newlist.end());
+        }
+        setDisplayNames(newlist);
+        Q_EMIT q->entries(q, newlist);
+    } else if (m_prefix.isNull() && includeHidden) {
         Q_EMIT q->entries(q, list);
     } else {
         UDSEntryList newlist = list;
@@ -172,6 +192,51 @@ void ListJobPrivate::slotListEntries(const KIO::UDSEntryList &list)
     }
 }
 
+void ListJobPrivate::setDisplayNames(KIO::UDSEntryList &list)
+{
+    // The worker names the entries below the listed directory "subdir/file",
+    // give them the display name a sub-job would have given them
+    for (UDSEntry &entry : list) {
+        const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
+        const int slash = name.lastIndexOf(QLatin1Char('/'));
+        QString displayName = entry.stringValue(KIO::UDSEntry::UDS_DISPLAY_NAME);
+        if (displayName.isEmpty()) {
+            displayName = name.mid(slash + 1);
+        }
+        if (slash != -1) {
+            const QString parentName = name.left(slash);
+            displayName = m_displayPaths.value(parentName, parentName) + QLatin1Char('/') + displayName;
+            entry.replace(KIO::UDSEntry::UDS_DISPLAY_NAME, displayName);
+        }
+        if (entry.isDir() && !entry.isLink()) {
+            m_displayPaths.insert(name, displayName);
+        }
+    }
+}
+
+void ListJobPrivate::listUnreadableDirs(const QStringList &names)
+{
+    // The worker couldn't enter these while walking the tree. List them with a sub-job each,
+    // which reports its error through subError(), like when there's a sub-job per directory
+    Q_Q(ListJob);
+    for (const QString &name : names) {
+        QUrl itemURL = q->url();
+        itemURL.setPath(Utils::concatPaths(itemURL.path(), name));
+        ListJob *job = ListJobPrivate::newJobNoUi(itemURL,
+                                                  true /*recursive*/,
+                                                  name + QLatin1Char('/'),
+                                                  m_displayPaths.value(name, name) + QLatin1Char('/'),
+                                                  listFlags);
+        QObject::connect(job, &ListJob::entries, q, [this](KIO::Job *job, const KIO::UDSEntryList &list) {
+            gotEntries(job, list);
+        });
+        QObject::connect(job, &ListJob::subError, q, [this](KIO::ListJob *job, KIO::ListJob *ljob) {
+            slotSubError(job, ljob);
+        });
+        q->addSubjob(job);
+    }
+}
+
 void ListJobPrivate::gotEntries(KIO::Job *, const KIO::UDSEntryList &list)
 {
     // Forward entries received by subjob - faking we received them ourselves
@@ -232,6 +297,19 @@ void ListJob::slotFinished()
         }
     }
 
+    if (d->m_workerRecursion && !error()) {
+        // Percent-encoded names, one per line, see FileProtocol::listDir
+        const QString unreadableDirs = queryMetaData(QStringLiteral("unreadableDirs"));
+        if (!unreadableDirs.isEmpty()) {
+            QStringList names;
+            const QStringList encodedNames = unreadableDirs.split(QLatin1Char('\n'), Qt::SkipEmptyParts);
+            for (const QString &encodedName : encodedNames) {
+                names.append(QUrl::fromPercentEncoding(encodedName.toLatin1()));
+            }
+            d->listUnreadableDirs(names);
+        }
+    }
+
     // Return worker to the scheduler
     SimpleJob::slotFinished();
 }
@@ -277,6 +355,18 @@ void ListJobPrivate::start(Worker *worker)
         slotRedirection(url);
     });
 
+    // Let the worker list the whole tree in one go if it can, rather than
+    // starting one sub-job per subdirectory. Decided here, since a redirection
+    // can take us to a protocol that can't.
+    m_workerRecursion = recursive && m_prefix.isNull() && KProtocolManager::canListRecursive(m_url);
+    if (m_workerRecursion) {
+        m_outgoingMetaData.insert(QStringLiteral("recurse"), QStringLiteral("true"));
+        m_outgoingMetaData.insert(QStringLiteral("listHidden"), listFlags.testFlag(ListJob::ListFlag::IncludeHidden) ? QStringLiteral("true") : QStringLiteral("false"));
+    } else {
+        m_outgoingMetaData.remove(QStringLiteral("recurse"));
+        m_outgoingMetaData.remove(QStringLiteral("listHidden"));
+    }
+
     SimpleJobPrivate::start(worker);
 }
 
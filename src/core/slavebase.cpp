@@ -49,6 +49,7 @@
 #include "kiocoredebug.h"
 #include "kioglobal_p.h"
 #include "kpasswdserverclient.h"
+#include "udsentry_p.h"
 #include "workerinterface_p.h"
 
 #if defined(Q_OS_UNIX) && !defined(Q_OS_ANDROID)
@@ -154,6 +155,14 @@ public:
 #endif
     bool m_rootEntryListed = false;
 
+    // While handling CMD_STAT_MULTIPLE, the outcome of each stat() call is kept
+    // here instead of being sent, and all of them go out in one MSG_STAT_ENTRIES
+    bool m_inStatMultiple = false;
+    UDSEntry m_statMultipleEntry;
+    qint32 m_statMultipleError = 0;
+    QString m_statMultipleErrorText;
+    QUrl m_statMultipleRedirection;
+
     bool m_confirmationAsked;
     QSet<QString> m_tempAuths;
     QString m_warningTitle;
@@ -551,6 +560,11 @@ void SlaveBase::error(int _errid, const QString &_text)
     }
 
     d->m_state = d->ErrorCalled;
+    if (d->m_inStatMultiple) {
+        d->m_statMultipleError = _errid;
+        d->m_statMultipleErrorText = _text;
+        return;
+    }
     mIncomingMetaData.clear(); // Clear meta data
     d->rebuildConfig();
     mOutgoingMetaData.clear();
@@ -611,6 +625,9 @@ void SlaveBase::finished()
     }
 
     d->m_state = d->FinishedCalled;
+    if (d->m_inStatMultiple) {
+        return;
+    }
     mIncomingMetaData.clear(); // Clear meta data
     d->rebuildConfig();
     sendMetaData();
@@ -700,6 +717,10 @@ void SlaveBase::speed(unsigned long _bytes_per_second)
 
 void SlaveBase::redirection(const QUrl &_url)
 {
+    if (d->m_inStatMultiple) {
+        d->m_statMultipleRedirection = _url;
+        return;
+    }
     KIO_DATA << _url;
     send(INF_REDIRECTION, data);
 }
@@ -784,6 +805,10 @@ void SlaveBase::infoMessage(const QString &_msg)
 
 void SlaveBase::statEntry(const UDSEntry &entry)
 {
+    if (d->m_inStatMultiple) {
+        d->m_statMultipleEntry = entry;
+        return;
+    }
     KIO_DATA << entry;
     send(MSG_STAT_ENTRY, data);
 }
@@ -816,6 +841,12 @@ void SlaveBase::listEntry(const UDSEntry &entry)
 
 void SlaveBase::listEntries(const UDSEntryList &list)
 {
+    // Applications announce in our config which compact encoding they understand
+    if (d->configData.value(QStringLiteral("UDSEntryListFormat")).toInt() >= UDSEntryListFormatVersion) {
+        send(MSG_LIST_ENTRIES_COMPACT, encodeUDSEntryList(list));
+        return;
+    }
+
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
 
@@ -1223,6 +1254,33 @@ void SlaveBase::dispatch(int command, const QByteArray &data)
         d->m_state = d->Idle;
         break;
     }
+    case CMD_STAT_MULTIPLE: {
+        // Run stat() for each URL and send all the results at once,
+        // saving the application one round trip per URL
+        QList<QUrl> urls;
+        stream >> urls;
+        QByteArray results;
+        QDataStream resultStream(&results, QIODevice::WriteOnly);
+        resultStream << static_cast<qint32>(urls.size());
+        d->m_inStatMultiple = true;
+        for (const QUrl &statUrl : std::as_const(urls)) {
+            d->m_statMultipleEntry.clear();
+            d->m_statMultipleError = 0;
+            d->m_statMultipleErrorText.clear();
+            d->m_statMultipleRedirection.clear();
+            d->m_state = d->InsideMethod;
+            stat(statUrl); // krazy:exclude=syscalls
+            d->verifyState("stat()");
+            resultStream << d->m_statMultipleError << d->m_statMultipleErrorText << d->m_statMultipleRedirection << d->m_statMultipleEntry;
+        }
+        d->m_inStatMultiple = false;
+        d->m_statMultipleEntry.clear();
+        send(MSG_STAT_ENTRIES, results);
+        d->m_state = d->InsideMethod;
+        finished();
+        d->m_state = d->Idle;
+        break;
+    }
     case CMD_MIMETYPE: {
         stream >> url;
         d->m_state = d->InsideMethod;
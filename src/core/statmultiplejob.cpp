@@ -0,0 +1,262 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "statmultiplejob.h"
+
+#include "job_p.h"
+#include "kprotocolmanager.h"
+#include "worker_p.h"
+
+#include <QHash>
+#include <QTimer>
+
+using namespace KIO;
+
+// Upper bound for the number of URLs sent to a worker in one CMD_STAT_MULTIPLE,
+// so that the results of a huge list still come in at a regular pace
+static constexpr int s_maxBatchSize = 500;
+
+namespace
+{
+class StatBatchJobPrivate : public SimpleJobPrivate
+{
+public:
+    StatBatchJobPrivate(const QUrl &url, const QByteArray &packedArgs, StatJob::StatSide side, KIO::StatDetails details)
+        : SimpleJobPrivate(url, CMD_STAT_MULTIPLE, packedArgs)
+        , m_side(side)
+        , m_details(details)
+    {
+    }
+
+    const StatJob::StatSide m_side;
+    const KIO::StatDetails m_details;
+    QList<int> m_errors;
+    QStringList m_errorTexts;
+    QList<QUrl> m_redirections;
+    UDSEntryList m_entries;
+
+    void start(Worker *worker) override
+    {
+        Q_Q(SimpleJob);
+        m_outgoingMetaData.insert(QStringLiteral("statSide"), m_side == StatJob::SourceSide ? QStringLiteral("source") : QStringLiteral("dest"));
+        m_outgoingMetaData.insert(QStringLiteral("details"), QString::number(m_details));
+
+        q->connect(worker,
+                   &KIO::WorkerInterface::statEntries,
+                   q,
+                   [this](const QList<int> &errors, const QStringList &errorTexts, const QList<QUrl> &redirections, const KIO::UDSEntryList &entries) {
+                       m_errors = errors;
+                       m_errorTexts = errorTexts;
+                       m_redirections = redirections;
+                       m_entries = entries;
+                   });
+
+        SimpleJobPrivate::start(worker);
+    }
+};
+
+// The internal job sending one CMD_STAT_MULTIPLE
+class StatBatchJob : public SimpleJob
+{
+public:
+    explicit StatBatchJob(StatBatchJobPrivate &dd)
+        : SimpleJob(dd)
+    {
+    }
+
+    const StatBatchJobPrivate *batchData() const
+    {
+        return static_cast<const StatBatchJobPrivate *>(d_ptr.get());
+    }
+};
+}
+
+class KIO::StatMultipleJobPrivate : public KIO::JobPrivate
+{
+public:
+    StatMultipleJobPrivate(const QList<QUrl> &urls, StatJob::StatSide side, KIO::StatDetails details)
+        : JobPrivate()
+        , m_urls(urls)
+        , m_entries(urls.size())
+        , m_errors(urls.size(), 0)
+        , m_errorTexts(urls.size())
+        , m_side(side)
+        , m_details(details)
+    {
+        // Group the URLs by worker, keeping the order of their first occurrence
+        QHash<QString, int> groupForKey;
+        QList<QList<int>> groups;
+        for (int i = 0; i < m_urls.size(); ++i) {
+            const QUrl &url = m_urls.at(i);
+            const QString key = url.scheme() + QLatin1Char(':') + url.authority();
+            const auto it = groupForKey.constFind(key);
+            if (it == groupForKey.cend()) {
+                groupForKey.insert(key, groups.size());
+                groups.append({i});
+            } else {
+                groups[*it].append(i);
+            }
+        }
+
+        for (const QList<int> &group : std::as_const(groups)) {
+            if (group.size() > 1 && KProtocolManager::canStatMultiple(m_urls.at(group.first()))) {
+                for (int start = 0; start < group.size(); start += s_maxBatchSize) {
+                    m_steps.append(group.mid(start, s_maxBatchSize));
+                }
+            } else {
+                for (int index : group) {
+                    m_steps.append({index});
+                }
+            }
+        }
+    }
+
+    const QList<QUrl> m_urls;
+    QList<UDSEntry> m_entries;
+    QList<int> m_errors;
+    QStringList m_errorTexts;
+    const StatJob::StatSide m_side;
+    const KIO::StatDetails m_details;
+
+    // Each step is one sub-job: a batch for a worker supporting CMD_STAT_MULTIPLE,
+    // otherwise a StatJob for a single URL
+    QList<QList<int>> m_steps;
+    QList<int> m_currentStep;
+    int m_processed = 0;
+
+    Q_DECLARE_PUBLIC(StatMultipleJob)
+
+    void slotStart();
+    void startNextStep();
+    void setResult(int index, int error, const QString &errorText, const UDSEntry &entry);
+
+    static inline StatMultipleJob *newJob(const QList<QUrl> &urls, StatJob::StatSide side, KIO::StatDetails details, JobFlags flags)
+    {
+        StatMultipleJob *job = new StatMultipleJob(*new StatMultipleJobPrivate(urls, side, details));
+        job->setUiDelegate(KIO::createDefaultJobUiDelegate());
+        if (!(flags & HideProgressInfo)) {
+            job->setFinishedNotificationHidden();
+            KIO::getJobTracker()->registerJob(job);
+        }
+        return job;
+    }
+};
+
+StatMultipleJob::StatMultipleJob(StatMultipleJobPrivate &dd)
+    : Job(dd)
+{
+    Q_D(StatMultipleJob);
+    setTotalAmount(Items, d->m_urls.size());
+    QTimer::singleShot(0, this, [d]() {
+        d->slotStart();
+    });
+}
+
+StatMultipleJob::~StatMultipleJob()
+{
+}
+
+QList<QUrl> StatMultipleJob::urls() const
+{
+    return d_func()->m_urls;
+}
+
+QList<UDSEntry> StatMultipleJob::statResults() const
+{
+    return d_func()->m_entries;
+}
+
+QList<int> StatMultipleJob::errors() const
+{
+    return d_func()->m_errors;
+}
+
+QStringList StatMultipleJob::errorTexts() const
+{
+    return d_func()->m_errorTexts;
+}
+
+void StatMultipleJobPrivate::slotStart()
+{
+    startNextStep();
+}
+
+void StatMultipleJobPrivate::startNextStep()
+{
+    Q_Q(StatMultipleJob);
+
+    if (m_steps.isEmpty()) {
+        q->emitResult();
+        return;
+    }
+
+    m_currentStep = m_steps.takeFirst();
+    const QUrl &firstUrl = m_urls.at(m_currentStep.first());
+    emitStating(q, firstUrl);
+    KIO::Job *job;
+    if (m_currentStep.size() == 1) {
+        job = KIO::stat(firstUrl, m_side, m_details, HideProgressInfo);
+    } else {
+        QList<QUrl> urls;
+        urls.reserve(m_currentStep.size());
+        for (int index : std::as_const(m_currentStep)) {
+            urls.append(m_urls.at(index));
+        }
+        KIO_ARGS << urls;
+        job = new StatBatchJob(*new StatBatchJobPrivate(firstUrl, packedArgs, m_side, m_details));
+    }
+    job->setParentJob(q);
+    q->addSubjob(job);
+}
+
+void StatMultipleJobPrivate::setResult(int index, int error, const QString &errorText, const UDSEntry &entry)
+{
+    Q_Q(StatMultipleJob);
+    m_errors[index] = error;
+    m_errorTexts[index] = errorText;
+    m_entries[index] = entry;
+    ++m_processed;
+    q->setProcessedAmount(KJob::Items, m_processed);
+    Q_EMIT q->statResult(q, m_urls.at(index), error, entry);
+}
+
+void StatMultipleJob::slotResult(KJob *job)
+{
+    Q_D(StatMultipleJob);
+    removeSubjob(job);
+
+    if (auto *statJob = qobject_cast<StatJob *>(job)) {
+        const int index = d->m_currentStep.first();
+        d->setResult(index, statJob->error(), statJob->errorText(), statJob->error() ? UDSEntry() : statJob->statResult());
+    } else {
+        const StatBatchJobPrivate *batch = static_cast<StatBatchJob *>(job)->batchData();
+        QList<QList<int>> retries;
+        for (int i = 0; i < d->m_currentStep.size(); ++i) {
+            const int index = d->m_currentStep.at(i);
+            if (job->error() || i >= batch->m_entries.size()) {
+                // The whole batch failed (e.g. the worker died): give each URL a chance on its own
+                retries.append({index});
+            } else if (!batch->m_redirections.at(i).isEmpty()) {
+                // Let a StatJob follow the redirection
+                retries.append({index});
+            } else {
+                d->setResult(index, batch->m_errors.at(i), batch->m_errorTexts.at(i), batch->m_entries.at(i));
+            }
+        }
+        d->m_steps = retries + d->m_steps;
+    }
+
+    emitPercent(d->m_processed, d->m_urls.size());
+    d->startNextStep();
+}
+
+StatMultipleJob *KIO::statMultiple(const QList<QUrl> &urls, KIO::StatJob::StatSide side, KIO::StatDetails details, JobFlags flags)
+{
+    return StatMultipleJobPrivate::newJob(urls, side, details, flags);
+}
+
+#include "moc_statmultiplejob.cpp"
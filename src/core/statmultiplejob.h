@@ -0,0 +1,102 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_STATMULTIPLEJOB_H
+#define KIO_STATMULTIPLEJOB_H
+
+#include "job_base.h"
+#include "kiocore_export.h"
+#include "statjob.h"
+
+#include <QList>
+#include <QStringList>
+#include <QUrl>
+#include <kio/udsentry.h>
+
+namespace KIO
+{
+class StatMultipleJobPrivate;
+/**
+ * @class KIO::StatMultipleJob statmultiplejob.h <KIO/StatMultipleJob>
+ *
+ * A KIO job that retrieves information about several files at once.
+ *
+ * URLs handled by a protocol that supports it (see KProtocolManager::canStatMultiple())
+ * are sent to the worker in batches, so that it answers them all in one round trip
+ * instead of one per URL. The other URLs are stat'ed one after the other.
+ *
+ * The job itself only fails if it gets killed: a URL that couldn't be stat'ed
+ * gets an error code in errors() and an empty entry in statResults().
+ *
+ * @see KIO::statMultiple(), KIO::StatJob
+ * @since 6.10
+ */
+class KIOCORE_EXPORT StatMultipleJob : public Job
+{
+    Q_OBJECT
+
+public:
+    ~StatMultipleJob() override;
+
+    /**
+     * @return the URLs that are stat'ed, in the order given to KIO::statMultiple()
+     */
+    QList<QUrl> urls() const;
+
+    /**
+     * Call this in a slot connected to result, and only after making sure no error happened.
+     * @return the result of the stat of each URL, in the order of urls().
+     * The entry of a URL that couldn't be stat'ed is empty.
+     */
+    QList<UDSEntry> statResults() const;
+
+    /**
+     * @return the error code of the stat of each URL, in the order of urls(),
+     * 0 for the URLs that were stat'ed successfully.
+     */
+    QList<int> errors() const;
+
+    /**
+     * @return the error text going with each error code of errors(),
+     * to be passed to KIO::buildErrorString().
+     */
+    QStringList errorTexts() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted as soon as the stat of @p url is done, with @p error being 0 on success.
+     */
+    void statResult(KIO::Job *job, const QUrl &url, int error, const KIO::UDSEntry &entry);
+
+protected Q_SLOTS:
+    void slotResult(KJob *job) override;
+
+protected:
+    KIOCORE_NO_EXPORT explicit StatMultipleJob(StatMultipleJobPrivate &dd);
+
+private:
+    Q_DECLARE_PRIVATE(StatMultipleJob)
+};
+
+/**
+ * Finds out information about several files at once, like KIO::stat() does for one.
+ *
+ * @param urls the URLs to stat
+ * @param side whether the files are to be read or written to, see KIO::StatJob::setSide()
+ * @param details the details to retrieve, see KIO::StatJob::setDetails()
+ * @param flags Can be HideProgressInfo here
+ * @return the job handling the operation.
+ * @since 6.10
+ */
+KIOCORE_EXPORT StatMultipleJob *statMultiple(const QList<QUrl> &urls,
+                                             KIO::StatJob::StatSide side = KIO::StatJob::SourceSide,
+                                             KIO::StatDetails details = KIO::StatDefaultDetails,
+                                             JobFlags flags = DefaultFlags);
+
+}
+
+#endif
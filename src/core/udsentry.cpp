@@ -9,16 +9,21 @@
 */
 
 #include "udsentry.h"
+#include "udsentry_p.h"
 
 #include "../utils_p.h"
 
 #include <QDataStream>
 #include <QDebug>
+#include <QHash>
 #include <QList>
 #include <QString>
+#include <QtAlgorithms>
 
 #include <KUser>
 
+#include <algorithm>
+
 using namespace KIO;
 
 // BEGIN UDSEntryPrivate
@@ -40,6 +45,8 @@ public:
     void clear();
     void save(QDataStream &s) const;
     void load(QDataStream &s);
+    static QByteArray encodeList(const UDSEntryList &list);
+    static bool decodeList(const QByteArray &data, UDSEntryList &list);
     void debugUDSEntry(QDebug &stream) const;
     /**
      * @param field numeric UDS field id
@@ -48,6 +55,57 @@ public:
     static QString nameOfUdsField(uint field);
 
 private:
+    // The fields nearly every worker sets get a fixed slot, flagged in m_present,
+    // so that looking them up doesn't need a scan. String slots come first.
+    enum Slot {
+        NameSlot,
+        UserSlot,
+        GroupSlot,
+        LinkDestSlot,
+        SizeSlot,
+        FileTypeSlot,
+        AccessSlot,
+        ModificationTimeSlot,
+        AccessTimeSlot,
+        CreationTimeSlot,
+        LocalUserIdSlot,
+        LocalGroupIdSlot,
+        DeviceIdSlot,
+        InodeSlot,
+        SlotCount,
+        FirstNumberSlot = SizeSlot,
+    };
+    static constexpr uint s_slotFields[SlotCount] = {
+        UDSEntry::UDS_NAME,
+        UDSEntry::UDS_USER,
+        UDSEntry::UDS_GROUP,
+        UDSEntry::UDS_LINK_DEST,
+        UDSEntry::UDS_SIZE,
+        UDSEntry::UDS_FILE_TYPE,
+        UDSEntry::UDS_ACCESS,
+        UDSEntry::UDS_MODIFICATION_TIME,
+        UDSEntry::UDS_ACCESS_TIME,
+        UDSEntry::UDS_CREATION_TIME,
+        UDSEntry::UDS_LOCAL_USER_ID,
+        UDSEntry::UDS_LOCAL_GROUP_ID,
+        UDSEntry::UDS_DEVICE_ID,
+        UDSEntry::UDS_INODE,
+    };
+    static int slotOf(uint udsField);
+    // The slot a value of that type goes to, -1 if none: a value of the wrong type
+    // for the slot of its field goes to the overflow, like any other field
+    static int stringSlotOf(uint udsField);
+    static int numberSlotOf(uint udsField);
+    bool hasSlot(int slot) const
+    {
+        return slot != -1 && (m_present & (1u << slot));
+    }
+
+    // Calls func(udsField, stringValue, numberValue) for every field, slots first
+    template<typename Func>
+    void forEachField(Func func) const;
+
+    // Any other field, UDS_EXTRA ones included
     struct Field {
         inline Field()
         {
@@ -67,75 +125,177 @@ private:
         long long m_long = LLONG_MIN;
         uint m_index = 0;
     };
-    std::vector<Field> storage;
+    std::vector<Field>::iterator findOverflow(uint udsField);
+    std::vector<Field>::const_iterator findOverflow(uint udsField) const;
+
+    QString m_strings[FirstNumberSlot];
+    long long m_numbers[SlotCount - FirstNumberSlot] = {};
+    quint32 m_present = 0;
+    std::vector<Field> m_overflow;
 };
 
+int UDSEntryPrivate::slotOf(uint udsField)
+{
+    switch (udsField) {
+    case UDSEntry::UDS_NAME:
+        return NameSlot;
+    case UDSEntry::UDS_USER:
+        return UserSlot;
+    case UDSEntry::UDS_GROUP:
+        return GroupSlot;
+    case UDSEntry::UDS_LINK_DEST:
+        return LinkDestSlot;
+    case UDSEntry::UDS_SIZE:
+        return SizeSlot;
+    case UDSEntry::UDS_FILE_TYPE:
+        return FileTypeSlot;
+    case UDSEntry::UDS_ACCESS:
+        return AccessSlot;
+    case UDSEntry::UDS_MODIFICATION_TIME:
+        return ModificationTimeSlot;
+    case UDSEntry::UDS_ACCESS_TIME:
+        return AccessTimeSlot;
+    case UDSEntry::UDS_CREATION_TIME:
+        return CreationTimeSlot;
+    case UDSEntry::UDS_LOCAL_USER_ID:
+        return LocalUserIdSlot;
+    case UDSEntry::UDS_LOCAL_GROUP_ID:
+        return LocalGroupIdSlot;
+    case UDSEntry::UDS_DEVICE_ID:
+        return DeviceIdSlot;
+    case UDSEntry::UDS_INODE:
+        return InodeSlot;
+    default:
+        return -1;
+    }
+}
+
+int UDSEntryPrivate::stringSlotOf(uint udsField)
+{
+    const int slot = slotOf(udsField);
+    return slot < FirstNumberSlot ? slot : -1;
+}
+
+int UDSEntryPrivate::numberSlotOf(uint udsField)
+{
+    const int slot = slotOf(udsField);
+    return slot >= FirstNumberSlot ? slot : -1;
+}
+
+template<typename Func>
+void UDSEntryPrivate::forEachField(Func func) const
+{
+    for (int slot = 0; slot < FirstNumberSlot; ++slot) {
+        if (m_present & (1u << slot)) {
+            func(s_slotFields[slot], m_strings[slot], 0LL);
+        }
+    }
+    for (int slot = FirstNumberSlot; slot < SlotCount; ++slot) {
+        if (m_present & (1u << slot)) {
+            func(s_slotFields[slot], QString(), m_numbers[slot - FirstNumberSlot]);
+        }
+    }
+    for (const Field &field : m_overflow) {
+        func(field.m_index, field.m_str, field.m_long);
+    }
+}
+
+std::vector<UDSEntryPrivate::Field>::iterator UDSEntryPrivate::findOverflow(uint udsField)
+{
+    return std::find_if(m_overflow.begin(), m_overflow.end(), [udsField](const Field &entry) {
+        return entry.m_index == udsField;
+    });
+}
+
+std::vector<UDSEntryPrivate::Field>::const_iterator UDSEntryPrivate::findOverflow(uint udsField) const
+{
+    return std::find_if(m_overflow.cbegin(), m_overflow.cend(), [udsField](const Field &entry) {
+        return entry.m_index == udsField;
+    });
+}
+
 void UDSEntryPrivate::reserve(int size)
 {
-    storage.reserve(size);
+    // Only fields beyond the slots can need storage
+    if (size > SlotCount) {
+        m_overflow.reserve(size - SlotCount);
+    }
 }
 
 void UDSEntryPrivate::insert(uint udsField, const QString &value)
 {
     Q_ASSERT(udsField & KIO::UDSEntry::UDS_STRING);
-    Q_ASSERT(std::find_if(storage.cbegin(),
-                          storage.cend(),
-                          [udsField](const Field &entry) {
-                              return entry.m_index == udsField;
-                          })
-             == storage.cend());
-    storage.emplace_back(udsField, value);
+    Q_ASSERT(!contains(udsField));
+    const int slot = stringSlotOf(udsField);
+    if (slot != -1) {
+        m_strings[slot] = value;
+        m_present |= 1u << slot;
+        return;
+    }
+    m_overflow.emplace_back(udsField, value);
 }
 
 void UDSEntryPrivate::replace(uint udsField, const QString &value)
 {
     Q_ASSERT(udsField & KIO::UDSEntry::UDS_STRING);
-    auto it = std::find_if(storage.begin(), storage.end(), [udsField](const Field &entry) {
-        return entry.m_index == udsField;
-    });
-    if (it != storage.end()) {
+    const int slot = stringSlotOf(udsField);
+    if (slot != -1) {
+        m_strings[slot] = value;
+        m_present |= 1u << slot;
+        return;
+    }
+    auto it = findOverflow(udsField);
+    if (it != m_overflow.end()) {
         it->m_str = value;
         return;
     }
-    storage.emplace_back(udsField, value);
+    m_overflow.emplace_back(udsField, value);
 }
 
 void UDSEntryPrivate::insert(uint udsField, long long value)
 {
     Q_ASSERT(udsField & KIO::UDSEntry::UDS_NUMBER);
-    Q_ASSERT(std::find_if(storage.cbegin(),
-                          storage.cend(),
-                          [udsField](const Field &entry) {
-                              return entry.m_index == udsField;
-                          })
-             == storage.cend());
-    storage.emplace_back(udsField, value);
+    Q_ASSERT(!contains(udsField));
+    const int slot = numberSlotOf(udsField);
+    if (slot != -1) {
+        m_numbers[slot - FirstNumberSlot] = value;
+        m_present |= 1u << slot;
+        return;
+    }
+    m_overflow.emplace_back(udsField, value);
 }
 
 void UDSEntryPrivate::replace(uint udsField, long long value)
 {
     Q_ASSERT(udsField & KIO::UDSEntry::UDS_NUMBER);
-    auto it = std::find_if(storage.begin(), storage.end(), [udsField](const Field &entry) {
-        return entry.m_index == udsField;
-    });
-    if (it != storage.end()) {
+    const int slot = numberSlotOf(udsField);
+    if (slot != -1) {
+        m_numbers[slot - FirstNumberSlot] = value;
+        m_present |= 1u << slot;
+        return;
+    }
+    auto it = findOverflow(udsField);
+    if (it != m_overflow.end()) {
         it->m_long = value;
         return;
     }
-    storage.emplace_back(udsField, value);
+    m_overflow.emplace_back(udsField, value);
 }
 
 int UDSEntryPrivate::count() const
 {
-    return storage.size();
+    return qPopulationCount(m_present) + int(m_overflow.size());
 }
 
 QString UDSEntryPrivate::stringValue(uint udsField) const
 {
-    auto it = std::find_if(storage.cbegin(), storage.cend(), [udsField](const Field &entry) {
-        return entry.m_index == udsField;
-    });
-    if (it != storage.cend()) {
+    const int slot = slotOf(udsField);
+    if (hasSlot(slot)) {
+        // Like a number field in the overflow, a number slot has no string
+        return slot < FirstNumberSlot ? m_strings[slot] : QString();
+    }
+    auto it = findOverflow(udsField);
+    if (it != m_overflow.cend()) {
         return it->m_str;
     }
     return QString();
@@ -143,10 +303,13 @@ QString UDSEntryPrivate::stringValue(uint udsField) const
 
 long long UDSEntryPrivate::numberValue(uint udsField, long long defaultValue) const
 {
-    auto it = std::find_if(storage.cbegin(), storage.cend(), [udsField](const Field &entry) {
-        return entry.m_index == udsField;
-    });
-    if (it != storage.cend()) {
+    const int slot = slotOf(udsField);
+    if (hasSlot(slot)) {
+        // Like a string field in the overflow, a string slot has no number
+        return slot >= FirstNumberSlot ? m_numbers[slot - FirstNumberSlot] : LLONG_MIN;
+    }
+    auto it = findOverflow(udsField);
+    if (it != m_overflow.cend()) {
         return it->m_long;
     }
     return defaultValue;
@@ -155,42 +318,45 @@ long long UDSEntryPrivate::numberValue(uint udsField, long long defaultValue) co
 QList<uint> UDSEntryPrivate::fields() const
 {
     QList<uint> res;
-    res.reserve(storage.size());
-    for (const Field &field : storage) {
-        res.append(field.m_index);
-    }
+    res.reserve(count());
+    forEachField([&res](uint udsField, const QString &, long long) {
+        res.append(udsField);
+    });
     return res;
 }
 
 bool UDSEntryPrivate::contains(uint udsField) const
 {
-    auto it = std::find_if(storage.cbegin(), storage.cend(), [udsField](const Field &entry) {
-        return entry.m_index == udsField;
-    });
-    return (it != storage.cend());
+    return hasSlot(slotOf(udsField)) || findOverflow(udsField) != m_overflow.cend();
 }
 
 void UDSEntryPrivate::clear()
 {
-    storage.clear();
+    // Drop the strings too, not to keep them alive until the slot gets reused
+    for (int slot = 0; slot < FirstNumberSlot; ++slot) {
+        if (m_present & (1u << slot)) {
+            m_strings[slot].clear();
+        }
+    }
+    m_present = 0;
+    m_overflow.clear();
 }
 
 void UDSEntryPrivate::save(QDataStream &s) const
 {
-    s << static_cast<quint32>(storage.size());
+    s << static_cast<quint32>(count());
 
-    for (const Field &field : storage) {
-        uint uds = field.m_index;
+    forEachField([&s](uint uds, const QString &str, long long number) {
         s << uds;
 
         if (uds & KIO::UDSEntry::UDS_STRING) {
-            s << field.m_str;
+            s << str;
         } else if (uds & KIO::UDSEntry::UDS_NUMBER) {
-            s << field.m_long;
+            s << number;
         } else {
             Q_ASSERT_X(false, "KIO::UDSEntry", "Found a field with an invalid type");
         }
-    }
+    });
 }
 
 void UDSEntryPrivate::load(QDataStream &s)
@@ -224,17 +390,213 @@ void UDSEntryPrivate::load(QDataStream &s)
                 cachedStrings[i] = buffer;
             }
 
-            insert(uds, cachedStrings.at(i));
+            replace(uds, cachedStrings.at(i));
         } else if (uds & KIO::UDSEntry::UDS_NUMBER) {
             long long value;
             s >> value;
-            insert(uds, value);
+            replace(uds, value);
         } else {
             Q_ASSERT_X(false, "KIO::UDSEntry", "Found a field with an invalid type");
         }
     }
 }
 
+namespace
+{
+// The type bits (UDS_STRING, UDS_NUMBER, UDS_TIME) sit above the field id
+constexpr int s_udsTypeShift = 24;
+constexpr uint s_udsIdMask = (1u << s_udsTypeShift) - 1;
+
+// Values repeated over and over in a listing, sent once per batch
+inline bool isStringTableField(uint udsField)
+{
+    switch (udsField) {
+    case UDSEntry::UDS_USER:
+    case UDSEntry::UDS_GROUP:
+    case UDSEntry::UDS_ICON_NAME:
+    case UDSEntry::UDS_MIME_TYPE:
+    case UDSEntry::UDS_GUESSED_MIME_TYPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline void writeVarint(QByteArray &out, quint64 value)
+{
+    char buffer[10];
+    int length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = char(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = char(value);
+    out.append(buffer, length);
+}
+
+inline void writeUtf8(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    writeVarint(out, utf8.size());
+    out.append(utf8);
+}
+
+class CompactReader
+{
+public:
+    explicit CompactReader(const QByteArray &data)
+        : m_pos(data.constData())
+        , m_end(data.constData() + data.size())
+    {
+    }
+
+    bool readVarint(quint64 &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && m_pos < m_end; shift += 7) {
+            const uchar byte = *m_pos++;
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readUtf8(QString &value)
+    {
+        quint64 size;
+        if (!readVarint(size) || size > quint64(m_end - m_pos)) {
+            return false;
+        }
+        value = QString::fromUtf8(m_pos, qsizetype(size));
+        m_pos += size;
+        return true;
+    }
+
+private:
+    const char *m_pos;
+    const char *m_end;
+};
+}
+
+QByteArray UDSEntryPrivate::encodeList(const UDSEntryList &list)
+{
+    QByteArray out;
+    // Enough for a typical kio_file entry, saves most reallocations
+    out.reserve(8 + list.size() * 48);
+    writeVarint(out, UDSEntryListFormatVersion);
+    writeVarint(out, list.size());
+
+    QHash<QString, quint64> stringTable;
+    for (const UDSEntry &entry : list) {
+        const UDSEntryPrivate *d = entry.d.constData();
+        writeVarint(out, d->count());
+
+        d->forEachField([&out, &stringTable](uint uds, const QString &str, long long number) {
+            const quint64 tag = (quint64(uds & s_udsIdMask) << 3) | (uds >> s_udsTypeShift);
+
+            if (uds & KIO::UDSEntry::UDS_STRING) {
+                writeVarint(out, tag);
+                if (isStringTableField(uds)) {
+                    const auto it = stringTable.constFind(str);
+                    if (it != stringTable.cend()) {
+                        writeVarint(out, *it);
+                        return;
+                    }
+                    // 0 introduces a new string, which gets the next index
+                    stringTable.insert(str, stringTable.size() + 1);
+                    writeVarint(out, 0);
+                }
+                writeUtf8(out, str);
+            } else if (uds & KIO::UDSEntry::UDS_NUMBER) {
+                writeVarint(out, tag);
+                // zigzag, so that -1 and other small negative numbers stay short
+                writeVarint(out, (quint64(number) << 1) ^ quint64(number >> 63));
+            } else {
+                Q_ASSERT_X(false, "KIO::UDSEntry", "Found a field with an invalid type");
+                writeVarint(out, tag | (KIO::UDSEntry::UDS_STRING >> s_udsTypeShift));
+                writeUtf8(out, QString());
+            }
+        });
+    }
+    return out;
+}
+
+bool UDSEntryPrivate::decodeList(const QByteArray &data, UDSEntryList &list)
+{
+    CompactReader reader(data);
+
+    quint64 version;
+    quint64 count;
+    if (!reader.readVarint(version) || version != UDSEntryListFormatVersion || !reader.readVarint(count)) {
+        return false;
+    }
+    // Don't trust the count for more than what the data can hold, one byte per entry at least
+    list.reserve(list.size() + qsizetype(std::min<quint64>(count, data.size())));
+
+    QList<QString> stringTable;
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 fieldCount;
+        if (!reader.readVarint(fieldCount)) {
+            return false;
+        }
+
+        UDSEntry entry;
+        UDSEntryPrivate *d = entry.d.data();
+        // replace() rather than insert(): the data comes from the worker, a field could be repeated
+        d->reserve(int(std::min<quint64>(fieldCount, data.size())));
+
+        for (quint64 j = 0; j < fieldCount; ++j) {
+            quint64 tag;
+            if (!reader.readVarint(tag)) {
+                return false;
+            }
+            if (tag >> 3 > s_udsIdMask) {
+                return false;
+            }
+            const uint uds = uint(tag >> 3) | (uint(tag & 7) << s_udsTypeShift);
+            if (uds & KIO::UDSEntry::UDS_NUMBER) {
+                quint64 value;
+                if (!reader.readVarint(value)) {
+                    return false;
+                }
+                d->replace(uds, static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1));
+                continue;
+            }
+
+            if (!(uds & KIO::UDSEntry::UDS_STRING)) {
+                return false;
+            }
+            if (isStringTableField(uds)) {
+                quint64 index;
+                if (!reader.readVarint(index)) {
+                    return false;
+                }
+                if (index != 0) {
+                    if (index > quint64(stringTable.size())) {
+                        return false;
+                    }
+                    // Implicitly shared with all the other entries using that value
+                    d->replace(uds, stringTable.at(index - 1));
+                    continue;
+                }
+            }
+            QString value;
+            if (!reader.readUtf8(value)) {
+                return false;
+            }
+            if (isStringTableField(uds)) {
+                stringTable.append(value);
+            }
+            d->replace(uds, value);
+        }
+
+        list.append(std::move(entry));
+    }
+    return true;
+}
+
 QString UDSEntryPrivate::nameOfUdsField(uint field)
 {
     switch (field) {
@@ -311,16 +673,16 @@ void UDSEntryPrivate::debugUDSEntry(QDebug &stream) const
 {
     QDebugStateSaver saver(stream);
     stream.nospace() << "[";
-    for (const Field &field : storage) {
-        stream << " " << nameOfUdsField(field.m_index) << "=";
-        if (field.m_index & KIO::UDSEntry::UDS_STRING) {
-            stream << field.m_str;
-        } else if (field.m_index & KIO::UDSEntry::UDS_NUMBER) {
-            stream << field.m_long;
+    forEachField([&stream](uint uds, const QString &str, long long number) {
+        stream << " " << nameOfUdsField(uds) << "=";
+        if (uds & KIO::UDSEntry::UDS_STRING) {
+            stream << str;
+        } else if (uds & KIO::UDSEntry::UDS_NUMBER) {
+            stream << number;
         } else {
             Q_ASSERT_X(false, "KIO::UDSEntry", "Found a field with an invalid type");
         }
-    }
+    });
     stream << " ]";
 }
 // END UDSEntryPrivate
@@ -446,6 +808,16 @@ KIOCORE_EXPORT QDataStream &operator>>(QDataStream &s, KIO::UDSEntry &a)
     return s;
 }
 
+QByteArray KIO::encodeUDSEntryList(const UDSEntryList &list)
+{
+    return UDSEntryPrivate::encodeList(list);
+}
+
+bool KIO::decodeUDSEntryList(const QByteArray &data, UDSEntryList &list)
+{
+    return UDSEntryPrivate::decodeList(data, list);
+}
+
 // TODO KF7 remove
 // legacy operator in global namespace for binary compatibility
 KIOCORE_EXPORT bool operator==(const KIO::UDSEntry &entry, const KIO::UDSEntry &other)
@@ -170,6 +170,12 @@ public:
 
     /**
      * A vector of fields being present for the current entry.
+     *
+     * Since 6.10 the fields aren't in insertion order anymore: the common
+     * ones (name, user, group, link destination, size, file type, access,
+     * times, owner ids, device and inode) come first, then the others in
+     * insertion order.
+     *
      * @return all fields for the current entry.
      * @since 5.8
      */
@@ -326,6 +332,7 @@ private:
     friend KIOCORE_EXPORT QDataStream & ::operator<<(QDataStream & s, const KIO::UDSEntry & a);
     friend KIOCORE_EXPORT QDataStream & ::operator>>(QDataStream & s, KIO::UDSEntry & a);
     friend KIOCORE_EXPORT QDebug(::operator<<)(QDebug stream, const KIO::UDSEntry &entry);
+    friend class UDSEntryPrivate; // for the compact list encoding
 
 public:
     /**
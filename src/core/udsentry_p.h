@@ -0,0 +1,57 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef UDSENTRY_P_H
+#define UDSENTRY_P_H
+
+#include "kiocore_export.h"
+#include "udsentry.h"
+
+#include <QByteArray>
+
+namespace KIO
+{
+/**
+ * Version of the compact encoding of UDSEntry lists, used by workers to send
+ * MSG_LIST_ENTRIES_COMPACT instead of MSG_LIST_ENTRIES.
+ *
+ * The application announces the highest version it can decode in the worker
+ * configuration, under the key "UDSEntryListFormat". Workers only use the
+ * compact encoding if that version is at least theirs, so an application and
+ * a worker from different KIO releases keep talking QDataStream.
+ *
+ * Layout of version 1, all integers being LEB128 varints:
+ *   version, entry count, then for each entry: field count, then for each field
+ *   a tag (field id shifted left by three, or'ed with the UDS_STRING, UDS_NUMBER
+ *   and UDS_TIME type bits shifted down into the low three bits) followed by the value.
+ *   Numbers are zigzag encoded. Strings are a length and UTF-8 bytes, except for
+ *   user, group, icon and MIME type values, which go through a per-batch string
+ *   table: a varint index into the table, or 0 followed by a new string that is
+ *   then appended to it.
+ *
+ * @internal
+ */
+enum {
+    UDSEntryListFormatVersion = 1,
+};
+
+/**
+ * Encodes @p list in the compact format described above.
+ * @internal
+ */
+KIOCORE_EXPORT QByteArray encodeUDSEntryList(const UDSEntryList &list);
+
+/**
+ * Decodes a list encoded with encodeUDSEntryList() into @p list.
+ * @return false if @p data is truncated, malformed or of an unknown version,
+ *         in which case @p list holds the entries decoded so far.
+ * @internal
+ */
+KIOCORE_EXPORT bool decodeUDSEntryList(const QByteArray &data, UDSEntryList &list);
+}
+
+#endif
@@ -30,6 +30,7 @@
 #include "connectionserver.h"
 #include "dataprotocol_p.h"
 #include "kioglobal_p.h"
+#include "udsentry_p.h"
 #include <config-kiocore.h> // KDE_INSTALL_FULL_LIBEXECDIR_KF
 #include <kprotocolinfo.h>
 
@@ -99,6 +100,11 @@ void Worker::timeout()
 }
 
 Worker::Worker(const QString &protocol, QObject *parent)
+    : Worker(protocol, Transport::LocalSocket, parent)
+{
+}
+
+Worker::Worker(const QString &protocol, Transport transport, QObject *parent)
     : WorkerInterface(parent)
     , m_protocol(protocol)
     , m_workerProtocol(protocol)
@@ -106,7 +112,11 @@ Worker::Worker(const QString &protocol, QObject *parent)
 {
     m_contact_started.start();
     m_workerConnServer->setParent(this);
-    m_workerConnServer->listenForRemote();
+    if (transport == Transport::InProcess) {
+        m_workerConnServer->listenInProcess();
+    } else {
+        m_workerConnServer->listenForRemote();
+    }
     if (!m_workerConnServer->isListening()) {
         qCWarning(KIO_CORE) << "KIO Connection server not listening, could not connect";
     }
@@ -308,9 +318,13 @@ void Worker::resetHost()
 
 void Worker::setConfig(const MetaData &config)
 {
+    MetaData workerConfig = config;
+    // Let the worker send listings in the compact encoding, see udsentry_p.h
+    workerConfig.insert(QStringLiteral("UDSEntryListFormat"), QString::number(UDSEntryListFormatVersion));
+
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
-    stream << config;
+    stream << workerConfig;
     m_connection->send(CMD_CONFIG, data);
 }
 
@@ -398,15 +412,6 @@ Worker *Worker::createWorker(const QString &protocol, const QUrl &url, int &erro
         return nullptr;
     }
 
-    auto *worker = new Worker(protocol);
-    const QUrl workerAddress = worker->m_workerConnServer->address();
-    if (workerAddress.isEmpty()) {
-        error_text = i18n("Can not create a socket for launching a KIO worker for protocol '%1'.", protocol);
-        error = KIO::ERR_CANNOT_CREATE_WORKER;
-        delete worker;
-        return nullptr;
-    }
-
     // Threads are enabled by default, set KIO_ENABLE_WORKER_THREADS=0 to disable them
     const auto useThreads = []() {
         return qgetenv("KIO_ENABLE_WORKER_THREADS") != "0";
@@ -415,18 +420,31 @@ Worker *Worker::createWorker(const QString &protocol, const QUrl &url, int &erro
 
     // Threads have performance benefits, but degrade robustness
     // (a worker crashing kills the app). So let's only enable the feature for kio_file, for now.
+    WorkerFactory *factory = nullptr;
     if (protocol == QLatin1String("admin") || (bUseThreads && protocol == QLatin1String("file"))) {
-        auto *factory = qobject_cast<WorkerFactory *>(loader.instance());
-        if (factory) {
-            auto *thread = new WorkerThread(worker, factory, workerAddress.toString().toLocal8Bit());
-            thread->start();
-            worker->setWorkerThread(thread);
-            return worker;
-        } else {
+        factory = qobject_cast<WorkerFactory *>(loader.instance());
+        if (!factory) {
             qCWarning(KIO_CORE) << lib_path << "doesn't implement WorkerFactory?";
         }
     }
 
+    // A worker in a thread talks to us through an in-memory channel rather than a socket
+    auto *worker = new Worker(protocol, factory ? Transport::InProcess : Transport::LocalSocket);
+    const QUrl workerAddress = worker->m_workerConnServer->address();
+    if (workerAddress.isEmpty()) {
+        error_text = i18n("Can not create a socket for launching a KIO worker for protocol '%1'.", protocol);
+        error = KIO::ERR_CANNOT_CREATE_WORKER;
+        delete worker;
+        return nullptr;
+    }
+
+    if (factory) {
+        auto *thread = new WorkerThread(worker, factory, workerAddress.toString().toLocal8Bit());
+        thread->start();
+        worker->setWorkerThread(thread);
+        return worker;
+    }
+
     const QStringList args = QStringList{lib_path, protocol, QString(), workerAddress.toString()};
     // qDebug() << "kioworker" << ", " << lib_path << ", " << protocol << ", " << QString() << ", " << workerAddress;
 
@@ -180,6 +180,12 @@ private:
 
     void setWorkerThread(WorkerThread *thread);
 
+    enum class Transport {
+        LocalSocket, /// The worker runs in a separate process and connects through a local socket
+        InProcess, /// The worker runs in a thread and connects through an in-memory channel
+    };
+    Worker(const QString &protocol, Transport transport, QObject *parent = nullptr);
+
 public Q_SLOTS: // TODO KF6: make all three slots private
     void accept();
     void gotInput();
@@ -482,6 +482,10 @@ public:
      * too much time, no need to follow symlinks etc.
      * details==0 is used for very simple probing: we'll only get the answer
      * "it's a file or a directory (or a symlink), or it doesn't exist".
+     *
+     * If the protocol declares "statMultiple" in its protocol file, KIO::statMultiple()
+     * calls this for each URL of a batch within one request, and sends all the
+     * results back at once. The metadata are then the same for the whole batch.
      */
     Q_REQUIRED_RESULT virtual WorkerResult stat(const QUrl &url);
 
@@ -505,6 +509,14 @@ public:
      * if we don't have enough permissions.
      * You should not list files if the path in @p url is empty, but redirect
      * to a non-empty path instead.
+     *
+     * If metadata("recurse") == "true", the worker should list the whole tree below @p url,
+     * naming entries relative to @p url (e.g.\ "subdir/file"), without "." and ".." of the
+     * subdirectories and without following symlinks to directories. Hidden entries below
+     * @p url are only wanted if metadata("listHidden") == "true".
+     * Subdirectories that can't be entered are not an error: set their names, percent-encoded
+     * and one per line, as metadata "unreadableDirs", and ListJob reports them.
+     * This behavior is only invoked if the worker specifies listRecursive=true in its protocol file.
      */
     Q_REQUIRED_RESULT virtual WorkerResult listDir(const QUrl &url);
 
@@ -11,6 +11,7 @@
 #include "connection_p.h"
 #include "hostinfo.h"
 #include "kiocoredebug.h"
+#include "udsentry_p.h"
 #include "usernotificationhandler_p.h"
 #include "workerbase.h"
 
@@ -132,6 +133,27 @@ bool WorkerInterface::dispatch(int _cmd, const QByteArray &rawdata)
         Q_EMIT statEntry(entry);
         break;
     }
+    case MSG_STAT_ENTRIES: {
+        qint32 count = 0;
+        stream >> count;
+        QList<int> errors;
+        QStringList errorTexts;
+        QList<QUrl> redirections;
+        UDSEntryList entries;
+        for (qint32 i = 0; i < count && !stream.atEnd(); ++i) {
+            qint32 errorCode;
+            QString errorText;
+            QUrl redirection;
+            UDSEntry entry;
+            stream >> errorCode >> errorText >> redirection >> entry;
+            errors.append(errorCode);
+            errorTexts.append(errorText);
+            redirections.append(redirection);
+            entries.append(entry);
+        }
+        Q_EMIT statEntries(errors, errorTexts, redirections, entries);
+        break;
+    }
     case MSG_LIST_ENTRIES: {
         UDSEntryList list;
         UDSEntry entry;
@@ -144,6 +166,18 @@ bool WorkerInterface::dispatch(int _cmd, const QByteArray &rawdata)
         Q_EMIT listEntries(list);
         break;
     }
+    case MSG_LIST_ENTRIES_COMPACT: {
+        UDSEntryList list;
+        if (!decodeUDSEntryList(rawdata, list)) {
+            qCWarning(KIO_CORE) << "Received a malformed list of entries, got" << list.size() << "of them";
+            // Nothing else the worker sends can be trusted, fail the job and let the worker go
+            Q_EMIT error(ERR_INTERNAL, i18n("Received a malformed list of entries from the worker."));
+            return false;
+        }
+
+        Q_EMIT listEntries(list);
+        break;
+    }
     case MSG_RESUME: { // From the put job
         m_offset = readFilesize_t(stream);
         Q_EMIT canResume(m_offset);
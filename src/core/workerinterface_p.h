@@ -66,6 +66,8 @@ enum Message {
     MSG_HOST_INFO_REQ,
     MSG_PRIVILEGE_EXEC,
     MSG_WORKER_STATUS,
+    MSG_LIST_ENTRIES_COMPACT, ///< see encodeUDSEntryList()
+    MSG_STAT_ENTRIES, ///< the results of CMD_STAT_MULTIPLE
     // add new ones here once a release is done, to avoid breaking binary compatibility
 };
 
@@ -116,6 +118,7 @@ Q_SIGNALS:
     void workerStatus(qint64, const QByteArray &, const QString &, bool);
     void listEntries(const KIO::UDSEntryList &);
     void statEntry(const KIO::UDSEntry &);
+    void statEntries(const QList<int> &errors, const QStringList &errorTexts, const QList<QUrl> &redirections, const KIO::UDSEntryList &entries);
 
     void canResume(KIO::filesize_t);
 
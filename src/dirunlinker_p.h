@@ -0,0 +1,69 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_DIRUNLINKER_P_H
+#define KIO_DIRUNLINKER_P_H
+
+#include <QByteArray>
+#include <QThread>
+#include <QtGlobal>
+#include <qplatformdefs.h>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace DirUnlinker
+{
+/**
+ * Number of threads removing entries in parallel, for DeleteJob and kio_file.
+ * Removing entries is mostly waiting for the file system: a few threads are enough
+ * to keep it busy, more would only fight over the journal of the file system.
+ */
+inline int maxThreadCount()
+{
+    return qBound(1, QThread::idealThreadCount(), 4);
+}
+
+#ifdef Q_OS_UNIX
+/**
+ * Removes entries of one directory. The directory is resolved once, when opening it,
+ * then removing each entry is a single unlinkat() relative to it, with no path lookup.
+ * A symlink in place of the directory isn't followed, the entries then fail to be removed.
+ */
+class Dir
+{
+public:
+    explicit Dir(const QByteArray &path)
+        : m_fd(QT_OPEN(path.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC))
+    {
+    }
+
+    ~Dir()
+    {
+        if (m_fd != -1) {
+            QT_CLOSE(m_fd);
+        }
+    }
+
+    Dir(const Dir &) = delete;
+    Dir &operator=(const Dir &) = delete;
+
+    /// Removes the entry @p name, an empty directory if @p flags is AT_REMOVEDIR
+    bool unlink(const char *name, int flags = 0) const
+    {
+        return m_fd != -1 && ::unlinkat(m_fd, name, flags) == 0;
+    }
+
+private:
+    const int m_fd;
+};
+#endif
+}
+
+#endif
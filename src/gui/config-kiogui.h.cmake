@@ -1,2 +1,3 @@
 #cmakedefine01 HAVE_X11
 #cmakedefine01 HAVE_WAYLAND
+#cmakedefine01 HAVE_MEMFD_CREATE
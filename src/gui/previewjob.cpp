@@ -11,6 +11,7 @@
 #include "previewjob.h"
 #include "filecopyjob.h"
 #include "kiogui_debug.h"
+#include "config-kiogui.h"
 #include "standardthumbnailjob_p.h"
 #include "statjob.h"
 
@@ -25,14 +26,29 @@
 #include <sys/shm.h>
 #endif
 
+#if HAVE_MEMFD_CREATE
+#include "../sharefd_p.h"
+#include <QSocketNotifier>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <memory>
 
 #include <QCryptographicHash>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QImage>
+#include <QImageReader>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QMimeDatabase>
@@ -44,6 +60,7 @@
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTimer>
+#include <QtConcurrentMap>
 
 #include <KConfigGroup>
 #include <KFileUtils>
@@ -61,6 +78,8 @@
 namespace
 {
 static qreal s_defaultDevicePixelRatio = 1.0;
+// Each item in flight has a thumbnail worker, and a buffer of up to 16 MB
+static const int s_defaultMaximumParallelItems = 3;
 }
 
 namespace KIO
@@ -73,8 +92,285 @@ struct KIO::PreviewItem {
     KFileItem item;
     KPluginMetaData plugin;
     bool standardThumbnailer = false;
+    // Position of the item in the list given to the job
+    int index = 0;
+};
+
+namespace
+{
+// Shared memory the thumbnail worker writes the image into: a memfd where
+// available, a SysV segment otherwise
+struct ThumbnailBuffer {
+    int memfd = -1;
+    // The local socket handing the memfd over to the worker, see shareMemfd()
+    int memfdSocket = -1;
+    QSocketNotifier *memfdNotifier = nullptr;
+    QString memfdSocketPath;
+    int shmid = -1;
+    uchar *addr = nullptr;
+    size_t size = 0;
+};
+
+// The buffers free for the next tasks of a job. Shared with the images wrapping
+// a buffer, which give it back once released, see giveBackThumbnailBuffer()
+struct ThumbnailBufferPool {
+    std::vector<ThumbnailBuffer> buffers;
+    // Set once the job is gone, the buffers given back are then released
+    bool closed = false;
+};
+
+// The cleanup info of an image wrapping a buffer
+struct WrappedThumbnailBuffer {
+    std::shared_ptr<ThumbnailBufferPool> pool;
+    ThumbnailBuffer buffer;
+};
+
+// What a cached thumbnail must match to be used
+struct CachedThumbnailQuery {
+    QString thumbFilePath;
+    QByteArray origName;
+    qint64 mtime = 0;
+    KIO::filesize_t size = 0;
+    QString thumbnailerVersion;
+};
+
+// An item to look up in the thumbnail cache away from the GUI thread, see lookUpCachedThumbnail()
+struct CachedThumbnailLookup {
+    // Position of the item in the list given to the job
+    int index = 0;
+    // Directory of the thumbnails of the current size
+    QString thumbPath;
+    // The local file of the item, whose canonical path the query needs; empty for a remote item
+    QString localPath;
+    // Without thumbFilePath, and without origName for a local item
+    CachedThumbnailQuery query;
+};
+
+// The result of lookUpCachedThumbnail()
+struct CachedThumbnail {
+    int index = 0;
+    QImage thumb; // null if not in the cache
 };
 
+// Returns the thumbnail cached in query.thumbFilePath, or a null image if there is
+// none or it is out of date. Safe to call from any thread.
+QImage loadCachedThumbnail(const CachedThumbnailQuery &query)
+{
+    QImageReader reader(query.thumbFilePath, "png");
+    QImage thumb;
+    // The text chunks usually come before the pixels: check them first, so that
+    // an out of date thumbnail isn't decoded for nothing
+    if (reader.text(QStringLiteral("Thumb::URI")).isEmpty()) {
+        // No such file, or a writer that put them after the pixels
+        thumb = reader.read();
+        if (thumb.isNull()) {
+            return QImage();
+        }
+    }
+    const auto text = [&reader, &thumb](const QString &key) {
+        return thumb.isNull() ? reader.text(key) : thumb.text(key);
+    };
+
+    if (text(QStringLiteral("Thumb::URI")) != QString::fromUtf8(query.origName)
+        || text(QStringLiteral("Thumb::MTime")).toLongLong() != query.mtime) {
+        return QImage();
+    }
+
+    const QString origSize = text(QStringLiteral("Thumb::Size"));
+    if (!origSize.isEmpty() && origSize.toULongLong() != query.size) {
+        // Thumb::Size is not required, but if it is set it should match
+        return QImage();
+    }
+
+    const QString software = text(QStringLiteral("Software"));
+    if (!query.thumbnailerVersion.isEmpty() && software.startsWith(QLatin1String("KDE Thumbnail Generator"))) {
+        // Check if the version matches
+        // The software string should read "KDE Thumbnail Generator pluginName (vX)"
+        QString softwareString = QString(software).remove(QStringLiteral("KDE Thumbnail Generator")).trimmed();
+        if (softwareString.isEmpty()) {
+            // The thumbnail has been created with an older version, recreating
+            return QImage();
+        }
+        int versionIndex = softwareString.lastIndexOf(QLatin1String("(v"));
+        if (versionIndex < 0) {
+            return QImage();
+        }
+
+        QString cachedVersion = softwareString.remove(0, versionIndex + 2);
+        cachedVersion.chop(1);
+        uint thumbnailerMajor = query.thumbnailerVersion.toInt();
+        uint cachedMajor = cachedVersion.toInt();
+        if (thumbnailerMajor > cachedMajor) {
+            return QImage();
+        }
+    }
+
+    return thumb.isNull() ? reader.read() : thumb;
+}
+
+// Returns the URL of the local file @p path, as the thumbnail spec wants it: the one of its
+// canonical path. Empty if the file doesn't exist. Safe to call from any thread.
+QByteArray localOrigName(const QString &path)
+{
+    const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    return QUrl::fromLocalFile(canonicalPath).toEncoded(QUrl::RemovePassword | QUrl::FullyEncoded);
+}
+
+// Returns the file name of the thumbnail of the file whose URL is @p origName
+QString thumbnailName(const QByteArray &origName)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(origName, QCryptographicHash::Md5).toHex()) + QLatin1String(".png");
+}
+
+// Completes the query of @p lookup and loads the thumbnail it asks for. Safe to call from any thread.
+CachedThumbnail lookUpCachedThumbnail(const CachedThumbnailLookup &lookup)
+{
+    CachedThumbnailQuery query = lookup.query;
+    if (!lookup.localPath.isEmpty()) {
+        query.origName = localOrigName(lookup.localPath);
+        if (query.origName.isEmpty()) {
+            return {lookup.index, QImage()};
+        }
+    }
+    query.thumbFilePath = lookup.thumbPath + thumbnailName(query.origName);
+    return {lookup.index, loadCachedThumbnail(query)};
+}
+
+#if WITH_SHM
+#if HAVE_MEMFD_CREATE
+// Whether the thumbnail worker takes memfds, for the whole process. SysV segments are
+// used until a worker says it does, by answering with the "memfd" metadata set to 1,
+// see docs/metadata.txt
+std::atomic<bool> s_workerSupportsMemfd = false;
+
+// Listens on a local socket for the worker to connect, and hands it the memfd of
+// @p buffer with SCM_RIGHTS: the worker has no other way to open it
+bool shareMemfd(ThumbnailBuffer &buffer)
+{
+    buffer.memfdSocketPath = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation)
+        + QStringLiteral("/kio-thumbnail-%1-%2").arg(getpid()).arg(buffer.memfd);
+    const SocketAddress addr(QFile::encodeName(buffer.memfdSocketPath).toStdString());
+    if (!addr.address()) {
+        return false;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    QFile::remove(buffer.memfdSocketPath); // left over by a crashed process
+    if (::bind(fd, addr.address(), addr.length()) != 0 || ::listen(fd, 1) != 0) {
+        qCWarning(KIO_GUI) << "Couldn't listen on" << buffer.memfdSocketPath << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    buffer.memfdSocket = fd;
+    buffer.memfdNotifier = new QSocketNotifier(fd, QSocketNotifier::Read);
+    const int memfd = buffer.memfd;
+    QObject::connect(buffer.memfdNotifier, &QSocketNotifier::activated, [fd, memfd]() {
+        const int client = ::accept(fd, nullptr, nullptr);
+        if (client == -1) {
+            return;
+        }
+        FDMessageHeader msg;
+        cmsghdr *cmsg = msg.cmsgHeader();
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_level = SOL_SOCKET;
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof memfd);
+        if (::sendmsg(client, msg.message(), MSG_NOSIGNAL) != 2) {
+            qCWarning(KIO_GUI) << "Couldn't send the thumbnail buffer to the worker" << strerror(errno);
+        }
+        ::close(client);
+    });
+    return true;
+}
+#endif
+
+void releaseThumbnailBuffer(ThumbnailBuffer &buffer)
+{
+#if HAVE_MEMFD_CREATE
+    if (buffer.memfd != -1) {
+        delete buffer.memfdNotifier;
+        if (buffer.memfdSocket != -1) {
+            ::close(buffer.memfdSocket);
+            QFile::remove(buffer.memfdSocketPath);
+        }
+        munmap(buffer.addr, buffer.size);
+        close(buffer.memfd);
+        buffer = ThumbnailBuffer();
+        return;
+    }
+#endif
+    if (buffer.addr) {
+        shmdt((char *)buffer.addr);
+        shmctl(buffer.shmid, IPC_RMID, nullptr);
+    }
+    buffer = ThumbnailBuffer();
+}
+
+// Allocates a buffer of @p size bytes, mapped read-only: only the worker writes into it
+ThumbnailBuffer allocateThumbnailBuffer(size_t size, bool useMemfd)
+{
+    ThumbnailBuffer buffer;
+#if HAVE_MEMFD_CREATE
+    if (useMemfd) {
+        int fd = memfd_create("kio-thumbnail", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd != -1) {
+            void *addr = MAP_FAILED;
+            // Sealed to its size before the worker gets it: the image wraps the mapping,
+            // reading it past the end of a memfd shrunk by the worker would be a SIGBUS
+            if (ftruncate(fd, size) == 0 && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0) {
+                addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            }
+            if (addr != MAP_FAILED) {
+                buffer.memfd = fd;
+                buffer.addr = static_cast<uchar *>(addr);
+                buffer.size = size;
+                if (shareMemfd(buffer)) {
+                    return buffer;
+                }
+                releaseThumbnailBuffer(buffer);
+                fd = -1;
+            }
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+#else
+    Q_UNUSED(useMemfd)
+#endif
+
+    const int shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shmid != -1) {
+        uchar *shmaddr = (uchar *)(shmat(shmid, nullptr, SHM_RDONLY));
+        if (shmaddr == (uchar *)-1) {
+            shmctl(shmid, IPC_RMID, nullptr);
+        } else {
+            buffer.shmid = shmid;
+            buffer.addr = shmaddr;
+            buffer.size = size;
+        }
+    }
+    return buffer;
+}
+
+// QImageCleanupFunction of the images wrapping a buffer. They are released on the GUI
+// thread, QPixmap::fromImage() copying the pixels
+void giveBackThumbnailBuffer(void *info)
+{
+    auto *wrapped = static_cast<WrappedThumbnailBuffer *>(info);
+    if (wrapped->pool->closed) {
+        releaseThumbnailBuffer(wrapped->buffer);
+    } else {
+        wrapped->pool->buffers.push_back(wrapped->buffer);
+    }
+    delete wrapped;
+}
+#endif
+}
+
 class KIO::PreviewJobPrivate : public KIO::JobPrivate
 {
 public:
@@ -87,40 +383,81 @@ public:
         , bSave(true)
         , ignoreMaximumSize(false)
         , sequenceIndex(0)
-        , succeeded(false)
         , maximumLocalSize(0)
         , maximumRemoteSize(0)
         , enableRemoteFolderThumbnail(false)
-        , shmid(-1)
-        , shmaddr(nullptr)
     {
         // https://specifications.freedesktop.org/thumbnail-spec/thumbnail-spec-latest.html#DIRECTORY
         thumbRoot = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/thumbnails/");
     }
 
-    enum {
+    enum State {
         STATE_STATORIG, // if the thumbnail exists
         STATE_GETORIG, // if we create it
         STATE_CREATETHUMB, // thumbnail:/ worker
         STATE_DEVICE_INFO, // additional state check to get needed device ids
-    } state;
+    };
+
+    enum CachePolicy {
+        Prevent,
+        Allow,
+        Unknown
+    };
+
+    // An item being processed, from the stat of the original file to its thumbnail
+    struct Task {
+        PreviewItem item;
+        State state = STATE_STATORIG;
+        // The subjob currently working for this item
+        KJob *job = nullptr;
+        // The modification time of that URL
+        QDateTime tOrig;
+        // Original URL of the item in RFC2396 format
+        // (file:///path/to/a%20file instead of file:/path/to/a file)
+        QByteArray origName;
+        // Thumbnail file name for the item
+        QString thumbName;
+        bool succeeded = false;
+        // If the file to create a thumb for was a temp file, this is its name
+        QString tempName;
+        // Id of the device storing the file
+        int deviceId = 0;
+        CachePolicy cachePolicy = Unknown;
+        // Allocated to a size of extent x extent x 4 (32 bit image) on first need
+        ThumbnailBuffer buffer;
+    };
+
+    // A gotPreview or failed signal to emit, see emitInOrder
+    struct Outcome {
+        enum Kind {
+            Preview,
+            Failure,
+            Removed, // removeItem() was called, nothing to emit
+        } kind;
+        KFileItem item;
+        QPixmap preview;
+    };
 
     KFileItemList initialItems;
     QStringList enabledPlugins;
     // Our todo list :)
     // We remove the first item at every step, so use std::list
     std::list<PreviewItem> items;
-    // The current item
-    PreviewItem currentItem;
-    // The modification time of that URL
-    QDateTime tOrig;
+    // The items in flight; std::list so that they keep their address
+    std::list<Task> tasks;
+    // The items whose thumbnail is being looked up in the cache, before they get a task; by item index
+    std::map<int, PreviewItem> cachedThumbnailLookups;
+    QFutureWatcher<CachedThumbnail> *cachedThumbnailWatcher = nullptr;
+    // How many items are in flight at most, 0 until read from the config
+    int maximumParallelItems = 0;
+    // Whether gotPreview and failed are emitted in the order of initialItems
+    bool emitInOrder = false;
+    // The outcomes waiting for the one of an earlier item, by item index
+    std::map<int, Outcome> pendingOutcomes;
+    // Index of the next item whose outcome may be emitted
+    int nextOutcomeIndex = 0;
     // Path to thumbnail cache for the current size
     QString thumbPath;
-    // Original URL of current item in RFC2396 format
-    // (file:///path/to/a%20file instead of file:/path/to/a file)
-    QByteArray origName;
-    // Thumbnail file name for current item
-    QString thumbName;
     // Size of thumbnail
     int width;
     int height;
@@ -132,52 +469,52 @@ public:
     bool bSave;
     bool ignoreMaximumSize;
     int sequenceIndex;
-    bool succeeded;
-    // If the file to create a thumb for was a temp file, this is its name
-    QString tempName;
     KIO::filesize_t maximumLocalSize;
     KIO::filesize_t maximumRemoteSize;
     // Manage preview for locally mounted remote directories
     bool enableRemoteFolderThumbnail;
-    // Shared memory segment Id. The segment is allocated to a size
-    // of extent x extent x 4 (32 bit image) on first need.
-    int shmid;
-    // And the data area
-    uchar *shmaddr;
-    // Size of the shm segment
-    size_t shmsize;
+#if WITH_SHM
+    // The buffers of the finished tasks, for reuse by the next ones
+    std::shared_ptr<ThumbnailBufferPool> bufferPool = std::make_shared<ThumbnailBufferPool>();
+#endif
     // Root of thumbnail cache
     QString thumbRoot;
     // Metadata returned from the KIO thumbnail worker
     QMap<QString, QString> thumbnailWorkerMetaData;
     qreal devicePixelRatio = s_defaultDevicePixelRatio;
     static const int idUnknown = -1;
-    // Id of a device storing currently processed file
-    int currentDeviceId = 0;
     // Device ID for each file. Stored while in STATE_DEVICE_INFO state, used later on.
     QMap<QString, int> deviceIdMap;
-    enum CachePolicy {
-        Prevent,
-        Allow,
-        Unknown
-    } currentDeviceCachePolicy = Unknown;
+    // The cache policy of the files on a device, by device ID
+    QHash<int, CachePolicy> deviceCachePolicies;
     // the path of a unique temporary directory
     QString m_tempDirPath;
 
-    void getOrCreateThumbnail();
-    bool statResultThumbnail();
-    void createThumbnail(const QString &);
-    void cleanupTempFile();
-    void determineNextFile();
-    void emitPreview(const QImage &thumb);
+    void getOrCreateThumbnail(Task &task);
+    bool statResultThumbnail(Task &task);
+    bool setThumbnailName(Task &task);
+    CachedThumbnailQuery cachedThumbnailQuery(const Task &task) const;
+    void lookUpCachedThumbnails();
+    void cachedThumbnailsReady(int begin, int end);
+    void createThumbnail(Task &task, const QString &);
+    void cleanupTempFile(Task &task);
+    void startNextItems();
+    void finishTask(Task &task);
+    Task *taskForJob(KJob *job);
+    void addSubjob(Task &task, KIO::Job *job);
+    bool usesThumbnailCache(const PreviewItem &item) const;
+    bool isTooBig(const PreviewItem &item, KIO::filesize_t size) const;
+    void emitPreview(Task &task, const QImage &thumb);
+    void reportOutcome(int index, Outcome &&outcome);
+    void emitOutcome(const Outcome &outcome);
 
     void startPreview();
     void slotThumbData(KIO::Job *, const QByteArray &);
     void slotStandardThumbData(KIO::Job *, const QImage &);
     // Checks if thumbnail is on encrypted partition different than thumbRoot
-    CachePolicy canBeCached(const QString &path);
-    int getDeviceId(const QString &path);
-    void saveThumbnailData(QImage &thumb);
+    CachePolicy canBeCached(Task &task, const QString &path);
+    int getDeviceId(Task &task, const QString &path);
+    void saveThumbnailData(Task &task, QImage &thumb);
 
     Q_DECLARE_PUBLIC(PreviewJob)
 
@@ -280,7 +617,7 @@ PreviewJob::PreviewJob(const KFileItemList &items, const QSize &size, const QStr
                                    QStringList{QStringLiteral("directorythumbnail"), QStringLiteral("imagethumbnail"), QStringLiteral("jpegthumbnail")});
     }
 
-    // Return to event loop first, determineNextFile() might delete this;
+    // Return to event loop first, startNextItems() might delete this;
     QTimer::singleShot(0, this, [d]() {
         d->startPreview();
     });
@@ -289,15 +626,24 @@ PreviewJob::PreviewJob(const KFileItemList &items, const QSize &size, const QStr
 PreviewJob::~PreviewJob()
 {
     Q_D(PreviewJob);
+    if (d->cachedThumbnailWatcher) {
+        // Nobody is waiting for the thumbnails not looked up yet
+        d->cachedThumbnailWatcher->cancel();
+    }
     if (!d->m_tempDirPath.isEmpty()) {
         QDir tempDir(d->m_tempDirPath);
         tempDir.removeRecursively();
     }
 #if WITH_SHM
-    if (d->shmaddr) {
-        shmdt((char *)d->shmaddr);
-        shmctl(d->shmid, IPC_RMID, nullptr);
+    for (auto &task : d->tasks) {
+        releaseThumbnailBuffer(task.buffer);
+    }
+    for (auto &buffer : d->bufferPool->buffers) {
+        releaseThumbnailBuffer(buffer);
     }
+    d->bufferPool->buffers.clear();
+    // The buffers of the images still around are released with them
+    d->bufferPool->closed = true;
 #endif
 }
 
@@ -333,7 +679,6 @@ PreviewJob::ScaleType PreviewJob::scaleType() const
 
 void PreviewJobPrivate::startPreview()
 {
-    Q_Q(PreviewJob);
     // Load the list of plugins to determine which MIME types are supported
     const QList<KPluginMetaData> plugins = KIO::PreviewJobPrivate::loadAvailablePlugins();
     QMap<QString, KPluginMetaData> mimeMap;
@@ -351,10 +696,12 @@ void PreviewJobPrivate::startPreview()
 
     // Look for images and store the items in our todo list :)
     bool bNeedCache = false;
+    int index = 0;
     for (const auto &fileItem : std::as_const(initialItems)) {
         PreviewItem item;
         item.item = fileItem;
         item.standardThumbnailer = false;
+        item.index = index++;
 
         const QString mimeType = item.item.mimetype();
         KPluginMetaData plugin;
@@ -403,7 +750,7 @@ void PreviewJobPrivate::startPreview()
                 }
             }
         } else {
-            Q_EMIT q->failed(fileItem);
+            reportOutcome(item.index, {Outcome::Failure, fileItem, {}});
         }
     }
 
@@ -411,6 +758,9 @@ void PreviewJobPrivate::startPreview()
     maximumLocalSize = cg.readEntry("MaximumSize", std::numeric_limits<KIO::filesize_t>::max());
     maximumRemoteSize = cg.readEntry<KIO::filesize_t>("MaximumRemoteSize", 0);
     enableRemoteFolderThumbnail = cg.readEntry("EnableRemoteFolderThumbnail", false);
+    if (maximumParallelItems <= 0) {
+        maximumParallelItems = std::max(1, cg.readEntry("MaximumParallelItems", s_defaultMaximumParallelItems));
+    }
 
     if (bNeedCache) {
         const int longer = std::max(width, height);
@@ -456,7 +806,11 @@ void PreviewJobPrivate::startPreview()
     }
 
     initialItems.clear();
-    determineNextFile();
+
+    // Look for the thumbnails already in the cache right away, without a stat job per item,
+    // while the workers get busy with the others
+    lookUpCachedThumbnails();
+    startNextItems();
 }
 
 void PreviewJob::removeItem(const QUrl &url)
@@ -467,14 +821,30 @@ void PreviewJob::removeItem(const QUrl &url)
         return url == pItem.item.url();
     });
     if (it != d->items.cend()) {
+        const int index = it->index;
         d->items.erase(it);
+        d->reportOutcome(index, {PreviewJobPrivate::Outcome::Removed, {}, {}});
+    }
+
+    // Its lookup in the cache goes on, cachedThumbnailsReady() ignores the result
+    auto lookupIt = std::find_if(d->cachedThumbnailLookups.cbegin(), d->cachedThumbnailLookups.cend(), [&url](const auto &lookup) {
+        return url == lookup.second.item.url();
+    });
+    if (lookupIt != d->cachedThumbnailLookups.cend()) {
+        const int index = lookupIt->first;
+        d->cachedThumbnailLookups.erase(lookupIt);
+        d->reportOutcome(index, {PreviewJobPrivate::Outcome::Removed, {}, {}});
     }
 
-    if (d->currentItem.item.url() == url) {
-        KJob *job = subjobs().first();
-        job->kill();
-        removeSubjob(job);
-        d->determineNextFile();
+    auto taskIt = std::find_if(d->tasks.begin(), d->tasks.end(), [&url](const PreviewJobPrivate::Task &task) {
+        return url == task.item.item.url();
+    });
+    if (taskIt != d->tasks.end()) {
+        if (KJob *job = taskIt->job) {
+            job->kill();
+            removeSubjob(job);
+        }
+        d->finishTask(*taskIt);
     }
 }
 
@@ -508,37 +878,127 @@ void PreviewJob::setIgnoreMaximumSize(bool ignoreSize)
     d_func()->ignoreMaximumSize = ignoreSize;
 }
 
-void PreviewJobPrivate::cleanupTempFile()
+void PreviewJob::setMaximumParallelItems(int count)
 {
-    if (!tempName.isEmpty()) {
-        Q_ASSERT((!QFileInfo(tempName).isDir() && QFileInfo(tempName).isFile()) || QFileInfo(tempName).isSymLink());
-        QFile::remove(tempName);
-        tempName.clear();
+    d_func()->maximumParallelItems = count;
+}
+
+void PreviewJob::setEmitInOrder(bool inOrder)
+{
+    d_func()->emitInOrder = inOrder;
+}
+
+void PreviewJobPrivate::cleanupTempFile(Task &task)
+{
+    if (!task.tempName.isEmpty()) {
+        Q_ASSERT((!QFileInfo(task.tempName).isDir() && QFileInfo(task.tempName).isFile()) || QFileInfo(task.tempName).isSymLink());
+        QFile::remove(task.tempName);
+        task.tempName.clear();
     }
 }
 
-void PreviewJobPrivate::determineNextFile()
+void PreviewJobPrivate::startNextItems()
 {
     Q_Q(PreviewJob);
-    if (!currentItem.item.isNull()) {
-        if (!succeeded) {
-            Q_EMIT q->failed(currentItem.item);
-        }
-    }
-    // No more items ?
-    if (items.empty()) {
-        q->emitResult();
-        return;
-    } else {
+    while (tasks.size() < size_t(maximumParallelItems) && !items.empty()) {
         // First, stat the orig file
-        state = PreviewJobPrivate::STATE_STATORIG;
-        currentItem = items.front();
+        Task &task = tasks.emplace_back();
+        task.item = items.front();
         items.pop_front();
-        succeeded = false;
-        KIO::Job *job = KIO::stat(currentItem.item.targetUrl(), StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatInode, KIO::HideProgressInfo);
+        task.state = PreviewJobPrivate::STATE_STATORIG;
+        KIO::Job *job = KIO::stat(task.item.item.targetUrl(), StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatInode, KIO::HideProgressInfo);
         job->addMetaData(QStringLiteral("thumbnail"), QStringLiteral("1"));
         job->addMetaData(QStringLiteral("no-auth-prompt"), QStringLiteral("true"));
-        q->addSubjob(job);
+        addSubjob(task, job);
+    }
+
+    // No more items ?
+    if (tasks.empty() && items.empty() && cachedThumbnailLookups.empty() && !q->isFinished()) {
+        q->emitResult();
+    }
+}
+
+void PreviewJobPrivate::finishTask(Task &task)
+{
+    cleanupTempFile(task);
+#if WITH_SHM
+    if (task.buffer.addr) {
+        bufferPool->buffers.push_back(task.buffer);
+    }
+#endif
+    const PreviewItem item = task.item;
+    const bool succeeded = task.succeeded;
+    tasks.remove_if([&task](const Task &other) {
+        return &other == &task;
+    });
+
+    if (!succeeded) {
+        reportOutcome(item.index, {Outcome::Failure, item.item, {}});
+    }
+    startNextItems();
+}
+
+PreviewJobPrivate::Task *PreviewJobPrivate::taskForJob(KJob *job)
+{
+    auto it = std::find_if(tasks.begin(), tasks.end(), [job](const Task &task) {
+        return task.job == job;
+    });
+    return it != tasks.end() ? &*it : nullptr;
+}
+
+void PreviewJobPrivate::addSubjob(Task &task, KIO::Job *job)
+{
+    Q_Q(PreviewJob);
+    task.job = job;
+    q->addSubjob(job);
+}
+
+bool PreviewJobPrivate::usesThumbnailCache(const PreviewItem &item) const
+{
+    const bool pluginHandlesSequences = item.plugin.value(QStringLiteral("HandleSequences"), false);
+    return item.plugin.value(QStringLiteral("CacheThumbnail"), true) && !(sequenceIndex && pluginHandlesSequences);
+}
+
+bool PreviewJobPrivate::isTooBig(const PreviewItem &item, KIO::filesize_t size) const
+{
+    const QUrl itemUrl = item.item.mostLocalUrl();
+
+    if ((itemUrl.isLocalFile() || KProtocolInfo::protocolClass(itemUrl.scheme()) == QLatin1String(":local")) && !item.item.isSlow()) {
+        return !ignoreMaximumSize && size > maximumLocalSize && !item.plugin.value(QStringLiteral("IgnoreMaximumSize"), false);
+    }
+    // For remote items the "IgnoreMaximumSize" plugin property is not respected
+    // Also we need to check if remote (but locally mounted) folder preview is enabled
+    return (!ignoreMaximumSize && size > maximumRemoteSize) || (item.item.isDir() && !enableRemoteFolderThumbnail);
+}
+
+void PreviewJobPrivate::reportOutcome(int index, Outcome &&outcome)
+{
+    if (!emitInOrder) {
+        emitOutcome(outcome);
+        return;
+    }
+
+    pendingOutcomes.insert_or_assign(index, std::move(outcome));
+    // Emit the outcomes that no earlier item is waiting for anymore
+    while (!pendingOutcomes.empty() && pendingOutcomes.begin()->first <= nextOutcomeIndex) {
+        auto node = pendingOutcomes.extract(pendingOutcomes.begin());
+        nextOutcomeIndex = std::max(nextOutcomeIndex, node.key() + 1);
+        emitOutcome(node.mapped());
+    }
+}
+
+void PreviewJobPrivate::emitOutcome(const Outcome &outcome)
+{
+    Q_Q(PreviewJob);
+    switch (outcome.kind) {
+    case Outcome::Preview:
+        Q_EMIT q->gotPreview(outcome.item, outcome.preview);
+        break;
+    case Outcome::Failure:
+        Q_EMIT q->failed(outcome.item);
+        break;
+    case Outcome::Removed:
+        break;
     }
 }
 
@@ -547,49 +1007,42 @@ void PreviewJob::slotResult(KJob *job)
     Q_D(PreviewJob);
 
     removeSubjob(job);
-    Q_ASSERT(!hasSubjobs()); // We should have only one job at a time ...
-    switch (d->state) {
+    PreviewJobPrivate::Task *task = d->taskForJob(job);
+    if (!task) {
+        return;
+    }
+    task->job = nullptr;
+
+    switch (task->state) {
     case PreviewJobPrivate::STATE_STATORIG: {
         if (job->error()) { // that's no good news...
             // Drop this one and move on to the next one
-            d->determineNextFile();
+            d->finishTask(*task);
             return;
         }
         const KIO::UDSEntry statResult = static_cast<KIO::StatJob *>(job)->statResult();
-        d->currentDeviceId = statResult.numberValue(KIO::UDSEntry::UDS_DEVICE_ID, 0);
-        d->tOrig = QDateTime::fromSecsSinceEpoch(statResult.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, 0));
+        task->deviceId = statResult.numberValue(KIO::UDSEntry::UDS_DEVICE_ID, 0);
+        task->tOrig = QDateTime::fromSecsSinceEpoch(statResult.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, 0));
 
-        bool skipCurrentItem = false;
         const KIO::filesize_t size = (KIO::filesize_t)statResult.numberValue(KIO::UDSEntry::UDS_SIZE, 0);
-        const QUrl itemUrl = d->currentItem.item.mostLocalUrl();
-
-        if ((itemUrl.isLocalFile() || KProtocolInfo::protocolClass(itemUrl.scheme()) == QLatin1String(":local")) && !d->currentItem.item.isSlow()) {
-            skipCurrentItem = !d->ignoreMaximumSize && size > d->maximumLocalSize && !d->currentItem.plugin.value(QStringLiteral("IgnoreMaximumSize"), false);
-        } else {
-            // For remote items the "IgnoreMaximumSize" plugin property is not respected
-            // Also we need to check if remote (but locally mounted) folder preview is enabled
-            skipCurrentItem = (!d->ignoreMaximumSize && size > d->maximumRemoteSize) || (d->currentItem.item.isDir() && !d->enableRemoteFolderThumbnail);
-        }
-        if (skipCurrentItem) {
-            d->determineNextFile();
+        if (d->isTooBig(task->item, size)) {
+            d->finishTask(*task);
             return;
         }
 
-        bool pluginHandlesSequences = d->currentItem.plugin.value(QStringLiteral("HandleSequences"), false);
-        if (!d->currentItem.plugin.value(QStringLiteral("CacheThumbnail"), true) || (d->sequenceIndex && pluginHandlesSequences)) {
+        if (!d->usesThumbnailCache(task->item)) {
             // This preview will not be cached, no need to look for a saved thumbnail
             // Just create it, and be done
-            d->getOrCreateThumbnail();
+            d->getOrCreateThumbnail(*task);
             return;
         }
 
-        if (d->statResultThumbnail()) {
-            d->succeeded = true;
-            d->determineNextFile();
+        if (d->statResultThumbnail(*task)) {
+            d->finishTask(*task);
             return;
         }
 
-        d->getOrCreateThumbnail();
+        d->getOrCreateThumbnail(*task);
         return;
     }
     case PreviewJobPrivate::STATE_DEVICE_INFO: {
@@ -604,66 +1057,63 @@ void PreviewJob::slotResult(KJob *job)
             id = statJob->statResult().numberValue(KIO::UDSEntry::UDS_DEVICE_ID, 0);
         }
         d->deviceIdMap[path] = id;
-        d->createThumbnail(d->currentItem.item.localPath());
+        d->createThumbnail(*task, task->item.item.localPath());
         return;
     }
     case PreviewJobPrivate::STATE_GETORIG: {
         if (job->error()) {
-            d->cleanupTempFile();
-            d->determineNextFile();
+            d->finishTask(*task);
             return;
         }
 
-        d->createThumbnail(static_cast<KIO::FileCopyJob *>(job)->destUrl().toLocalFile());
+        d->createThumbnail(*task, static_cast<KIO::FileCopyJob *>(job)->destUrl().toLocalFile());
         return;
     }
     case PreviewJobPrivate::STATE_CREATETHUMB: {
-        d->cleanupTempFile();
-        d->determineNextFile();
+        d->finishTask(*task);
         return;
     }
     }
 }
 
-bool PreviewJobPrivate::statResultThumbnail()
+bool PreviewJobPrivate::setThumbnailName(Task &task)
 {
-    if (thumbPath.isEmpty()) {
-        return false;
-    }
-
     bool isLocal;
-    const QUrl url = currentItem.item.mostLocalUrl(&isLocal);
+    const QUrl url = task.item.item.mostLocalUrl(&isLocal);
     if (isLocal) {
-        const QFileInfo localFile(url.toLocalFile());
-        const QString canonicalPath = localFile.canonicalFilePath();
-        origName = QUrl::fromLocalFile(canonicalPath).toEncoded(QUrl::RemovePassword | QUrl::FullyEncoded);
-        if (origName.isEmpty()) {
+        task.origName = localOrigName(url.toLocalFile());
+        if (task.origName.isEmpty()) {
             qCWarning(KIO_GUI) << "Failed to convert" << url << "to canonical path";
             return false;
         }
     } else {
         // Don't include the password if any
-        origName = currentItem.item.targetUrl().toEncoded(QUrl::RemovePassword);
+        task.origName = task.item.item.targetUrl().toEncoded(QUrl::RemovePassword);
     }
 
-    QCryptographicHash md5(QCryptographicHash::Md5);
-    md5.addData(origName);
-    thumbName = QString::fromLatin1(md5.result().toHex()) + QLatin1String(".png");
+    task.thumbName = thumbnailName(task.origName);
+    return true;
+}
 
-    QImage thumb;
-    QFile thumbFile(thumbPath + thumbName);
-    if (!thumbFile.open(QIODevice::ReadOnly) || !thumb.load(&thumbFile, "png")) {
-        return false;
-    }
+CachedThumbnailQuery PreviewJobPrivate::cachedThumbnailQuery(const Task &task) const
+{
+    CachedThumbnailQuery query;
+    query.thumbFilePath = thumbPath + task.thumbName;
+    query.origName = task.origName;
+    query.mtime = task.tOrig.toSecsSinceEpoch();
+    query.size = task.item.item.size();
+    query.thumbnailerVersion = task.item.plugin.value(QStringLiteral("ThumbnailerVersion"));
+    return query;
+}
 
-    if (thumb.text(QStringLiteral("Thumb::URI")) != QString::fromUtf8(origName)
-        || thumb.text(QStringLiteral("Thumb::MTime")).toLongLong() != tOrig.toSecsSinceEpoch()) {
+bool PreviewJobPrivate::statResultThumbnail(Task &task)
+{
+    if (thumbPath.isEmpty() || !setThumbnailName(task)) {
         return false;
     }
 
-    const QString origSize = thumb.text(QStringLiteral("Thumb::Size"));
-    if (!origSize.isEmpty() && origSize.toULongLong() != currentItem.item.size()) {
-        // Thumb::Size is not required, but if it is set it should match
+    QImage thumb = loadCachedThumbnail(cachedThumbnailQuery(task));
+    if (thumb.isNull()) {
         return false;
     }
 
@@ -671,55 +1121,105 @@ bool PreviewJobPrivate::statResultThumbnail()
     // When a thumbnail is DPR-invariant, use the DPR passed in the request.
     thumb.setDevicePixelRatio(devicePixelRatio);
 
-    QString thumbnailerVersion = currentItem.plugin.value(QStringLiteral("ThumbnailerVersion"));
+    // Found it, use it
+    emitPreview(task, thumb);
+    return true;
+}
 
-    if (!thumbnailerVersion.isEmpty() && thumb.text(QStringLiteral("Software")).startsWith(QLatin1String("KDE Thumbnail Generator"))) {
-        // Check if the version matches
-        // The software string should read "KDE Thumbnail Generator pluginName (vX)"
-        QString softwareString = thumb.text(QStringLiteral("Software")).remove(QStringLiteral("KDE Thumbnail Generator")).trimmed();
-        if (softwareString.isEmpty()) {
-            // The thumbnail has been created with an older version, recreating
-            return false;
+void PreviewJobPrivate::lookUpCachedThumbnails()
+{
+    Q_Q(PreviewJob);
+    if (thumbPath.isEmpty()) {
+        return;
+    }
+
+    // The modification time and size already known by the items are as good as
+    // the ones a stat job would return, as long as we don't need the device ID
+    QList<CachedThumbnailLookup> lookups;
+    for (auto it = items.begin(); it != items.end();) {
+        const QDateTime mtime = it->item.time(KFileItem::ModificationTime);
+        if (!mtime.isValid() || !usesThumbnailCache(*it) || isTooBig(*it, it->item.size())) {
+            ++it;
+            continue;
         }
-        int versionIndex = softwareString.lastIndexOf(QLatin1String("(v"));
-        if (versionIndex < 0) {
-            return false;
+        CachedThumbnailLookup lookup;
+        lookup.index = it->index;
+        lookup.thumbPath = thumbPath;
+        bool isLocal;
+        const QUrl url = it->item.mostLocalUrl(&isLocal);
+        if (isLocal) {
+            lookup.localPath = url.toLocalFile();
+        } else {
+            // Don't include the password if any
+            lookup.query.origName = it->item.targetUrl().toEncoded(QUrl::RemovePassword);
         }
+        lookup.query.mtime = mtime.toSecsSinceEpoch();
+        lookup.query.size = it->item.size();
+        lookup.query.thumbnailerVersion = it->plugin.value(QStringLiteral("ThumbnailerVersion"));
+        lookups.append(lookup);
+
+        // Out of the todo list until we know whether the cache has it
+        cachedThumbnailLookups.emplace(it->index, std::move(*it));
+        it = items.erase(it);
+    }
+    if (lookups.isEmpty()) {
+        return;
+    }
 
-        QString cachedVersion = softwareString.remove(0, versionIndex + 2);
-        cachedVersion.chop(1);
-        uint thumbnailerMajor = thumbnailerVersion.toInt();
-        uint cachedMajor = cachedVersion.toInt();
-        if (thumbnailerMajor > cachedMajor) {
-            return false;
+    // Resolving the paths, reading and decoding the PNG files is the expensive part:
+    // spread it over all cores and emit the thumbnails as they come
+    cachedThumbnailWatcher = new QFutureWatcher<CachedThumbnail>(q);
+    QObject::connect(cachedThumbnailWatcher, &QFutureWatcherBase::resultsReadyAt, q, [this](int begin, int end) {
+        cachedThumbnailsReady(begin, end);
+    });
+    cachedThumbnailWatcher->setFuture(QtConcurrent::mapped(lookups, lookUpCachedThumbnail));
+}
+
+void PreviewJobPrivate::cachedThumbnailsReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i) {
+        CachedThumbnail cached = cachedThumbnailWatcher->resultAt(i);
+        auto node = cachedThumbnailLookups.extract(cached.index);
+        if (node.empty()) {
+            continue; // removeItem() was called meanwhile
         }
-    }
 
-    // Found it, use it
-    emitPreview(thumb);
-    return true;
+        if (cached.thumb.isNull()) {
+            // Not in the cache: back into the todo list, at its place
+            const auto pos = std::find_if(items.begin(), items.end(), [&cached](const PreviewItem &item) {
+                return item.index > cached.index;
+            });
+            items.insert(pos, std::move(node.mapped()));
+            continue;
+        }
+
+        // The DPR of the loaded thumbnail is unspecified, see statResultThumbnail()
+        cached.thumb.setDevicePixelRatio(devicePixelRatio);
+        Task task;
+        task.item = std::move(node.mapped());
+        emitPreview(task, cached.thumb);
+    }
+    startNextItems();
 }
 
-void PreviewJobPrivate::getOrCreateThumbnail()
+void PreviewJobPrivate::getOrCreateThumbnail(Task &task)
 {
-    Q_Q(PreviewJob);
     // We still need to load the orig file ! (This is getting tedious) :)
-    const KFileItem &item = currentItem.item;
+    const KFileItem &item = task.item.item;
     const QString localPath = item.localPath();
     if (!localPath.isEmpty()) {
-        createThumbnail(localPath);
+        createThumbnail(task, localPath);
         return;
     }
 
     if (item.isDir()) {
         // Skip remote dirs (bug 208625)
-        cleanupTempFile();
-        determineNextFile();
+        finishTask(task);
         return;
     }
     // No plugin support access to this remote content, copy the file
     // to the local machine, then create the thumbnail
-    state = PreviewJobPrivate::STATE_GETORIG;
+    task.state = PreviewJobPrivate::STATE_GETORIG;
     QTemporaryFile localFile;
 
     // Some thumbnailers, like libkdcraw, depend on the file extension being
@@ -731,43 +1231,46 @@ void PreviewJobPrivate::getOrCreateThumbnail()
 
     localFile.setAutoRemove(false);
     localFile.open();
-    tempName = localFile.fileName();
+    task.tempName = localFile.fileName();
     const QUrl currentURL = item.mostLocalUrl();
-    KIO::Job *job = KIO::file_copy(currentURL, QUrl::fromLocalFile(tempName), -1, KIO::Overwrite | KIO::HideProgressInfo /* No GUI */);
+    KIO::Job *job = KIO::file_copy(currentURL, QUrl::fromLocalFile(task.tempName), -1, KIO::Overwrite | KIO::HideProgressInfo /* No GUI */);
     job->addMetaData(QStringLiteral("thumbnail"), QStringLiteral("1"));
-    q->addSubjob(job);
+    addSubjob(task, job);
 }
 
-PreviewJobPrivate::CachePolicy PreviewJobPrivate::canBeCached(const QString &path)
+PreviewJobPrivate::CachePolicy PreviewJobPrivate::canBeCached(Task &task, const QString &path)
 {
     // If checked file is directory on a different filesystem than its parent, we need to check it separately
     int separatorIndex = path.lastIndexOf(QLatin1Char('/'));
     // special case for root folders
     const QString parentDirPath = separatorIndex == 0 ? path : path.left(separatorIndex);
 
-    int parentId = getDeviceId(parentDirPath);
+    int parentId = getDeviceId(task, parentDirPath);
     if (parentId == idUnknown) {
         return CachePolicy::Unknown;
     }
 
-    bool isDifferentSystem = !parentId || parentId != currentDeviceId;
-    if (!isDifferentSystem && currentDeviceCachePolicy != CachePolicy::Unknown) {
-        return currentDeviceCachePolicy;
+    bool isDifferentSystem = !parentId || parentId != task.deviceId;
+    if (!isDifferentSystem) {
+        const auto it = deviceCachePolicies.constFind(parentId);
+        if (it != deviceCachePolicies.cend()) {
+            return *it;
+        }
     }
     int checkedId;
     QString checkedPath;
     if (isDifferentSystem) {
-        checkedId = currentDeviceId;
+        checkedId = task.deviceId;
         checkedPath = path;
     } else {
-        checkedId = getDeviceId(parentDirPath);
+        checkedId = getDeviceId(task, parentDirPath);
         checkedPath = parentDirPath;
         if (checkedId == idUnknown) {
             return CachePolicy::Unknown;
         }
     }
     // If we're checking different filesystem or haven't checked yet see if filesystem matches thumbRoot
-    int thumbRootId = getDeviceId(thumbRoot);
+    int thumbRootId = getDeviceId(task, thumbRoot);
     if (thumbRootId == idUnknown) {
         return CachePolicy::Unknown;
     }
@@ -786,14 +1289,13 @@ PreviewJobPrivate::CachePolicy PreviewJobPrivate::canBeCached(const QString &pat
         }
     }
     if (!isDifferentSystem) {
-        currentDeviceCachePolicy = shouldAllow ? CachePolicy::Allow : CachePolicy::Prevent;
+        deviceCachePolicies.insert(parentId, shouldAllow ? CachePolicy::Allow : CachePolicy::Prevent);
     }
     return shouldAllow ? CachePolicy::Allow : CachePolicy::Prevent;
 }
 
-int PreviewJobPrivate::getDeviceId(const QString &path)
+int PreviewJobPrivate::getDeviceId(Task &task, const QString &path)
 {
-    Q_Q(PreviewJob);
     auto iter = deviceIdMap.find(path);
     if (iter != deviceIdMap.end()) {
         return iter.value();
@@ -803,10 +1305,10 @@ int PreviewJobPrivate::getDeviceId(const QString &path)
         qCWarning(KIO_GUI) << "Could not get device id for file preview, Invalid url" << path;
         return 0;
     }
-    state = PreviewJobPrivate::STATE_DEVICE_INFO;
+    task.state = PreviewJobPrivate::STATE_DEVICE_INFO;
     KIO::Job *job = KIO::stat(url, StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatInode, KIO::HideProgressInfo);
     job->addMetaData(QStringLiteral("no-auth-prompt"), QStringLiteral("true"));
-    q->addSubjob(job);
+    addSubjob(task, job);
 
     return idUnknown;
 }
@@ -827,47 +1329,50 @@ QDir KIO::PreviewJobPrivate::createTemporaryDir()
     return QDir(m_tempDirPath);
 }
 
-void PreviewJobPrivate::createThumbnail(const QString &pixPath)
+void PreviewJobPrivate::createThumbnail(Task &task, const QString &pixPath)
 {
     Q_Q(PreviewJob);
 
     QFileInfo info(pixPath);
     Q_ASSERT_X(info.isAbsolute(), "PreviewJobPrivate::createThumbnail", qPrintable(QLatin1String("path is not absolute: ") + info.path()));
 
-    state = PreviewJobPrivate::STATE_CREATETHUMB;
+    task.state = PreviewJobPrivate::STATE_CREATETHUMB;
 
-    bool save = bSave && currentItem.plugin.value(QStringLiteral("CacheThumbnail"), true) && !sequenceIndex;
+    bool save = bSave && task.item.plugin.value(QStringLiteral("CacheThumbnail"), true) && !sequenceIndex;
 
-    bool isRemoteProtocol = currentItem.item.localPath().isEmpty();
-    CachePolicy cachePolicy = isRemoteProtocol ? CachePolicy::Prevent : canBeCached(pixPath);
+    bool isRemoteProtocol = task.item.item.localPath().isEmpty();
+    const CachePolicy cachePolicy = isRemoteProtocol ? CachePolicy::Prevent : canBeCached(task, pixPath);
 
     if (cachePolicy == CachePolicy::Unknown) {
         // If Unknown is returned, creating thumbnail should be called again by slotResult
         return;
     }
+    task.cachePolicy = cachePolicy;
 
-    if (currentItem.standardThumbnailer) {
+    if (task.item.standardThumbnailer) {
         // Using /usr/share/thumbnailers
         QString exec;
         for (const auto &thumbnailer : standardThumbnailers().asKeyValueRange()) {
             for (const auto &mimetype : std::as_const(thumbnailer.second.mimetypes)) {
-                if (currentItem.plugin.supportsMimeType(mimetype)) {
+                if (task.item.plugin.supportsMimeType(mimetype)) {
                     exec = thumbnailer.second.exec;
                 }
             }
         }
         if (exec.isEmpty()) {
-            qCWarning(KIO_GUI) << "The exec entry for standard thumbnailer " << currentItem.plugin.name() << " was empty!";
+            qCWarning(KIO_GUI) << "The exec entry for standard thumbnailer " << task.item.plugin.name() << " was empty!";
+            finishTask(task);
             return;
         }
         auto tempDir = createTemporaryDir();
         if (pixPath.startsWith(tempDir.path())) {
             // don't generate thumbnails for images already in temporary directory
+            finishTask(task);
             return;
         }
 
         KIO::StandardThumbnailJob *job = new KIO::StandardThumbnailJob(exec, width * devicePixelRatio, pixPath, tempDir.path());
-        q->addSubjob(job);
+        addSubjob(task, job);
         q->connect(job, &KIO::StandardThumbnailJob::data, q, [=, this](KIO::Job *job, const QImage &thumb) {
             slotStandardThumbData(job, thumb);
         });
@@ -880,7 +1385,7 @@ void PreviewJobPrivate::createThumbnail(const QString &pixPath)
     thumbURL.setScheme(QStringLiteral("thumbnail"));
     thumbURL.setPath(pixPath);
     KIO::TransferJob *job = KIO::get(thumbURL, NoReload, HideProgressInfo);
-    q->addSubjob(job);
+    addSubjob(task, job);
     q->connect(job, &KIO::TransferJob::data, q, [this](KIO::Job *job, const QByteArray &data) {
         slotThumbData(job, data);
     });
@@ -890,10 +1395,10 @@ void PreviewJobPrivate::createThumbnail(const QString &pixPath)
         thumb_width = thumb_height = cacheSize;
     }
 
-    job->addMetaData(QStringLiteral("mimeType"), currentItem.item.mimetype());
+    job->addMetaData(QStringLiteral("mimeType"), task.item.item.mimetype());
     job->addMetaData(QStringLiteral("width"), QString::number(thumb_width));
     job->addMetaData(QStringLiteral("height"), QString::number(thumb_height));
-    job->addMetaData(QStringLiteral("plugin"), currentItem.plugin.fileName());
+    job->addMetaData(QStringLiteral("plugin"), task.item.plugin.fileName());
     job->addMetaData(QStringLiteral("enabledPlugins"), enabledPlugins.join(QLatin1Char(',')));
     job->addMetaData(QStringLiteral("devicePixelRatio"), QString::number(devicePixelRatio));
     job->addMetaData(QStringLiteral("cache"), QString::number(cachePolicy == CachePolicy::Allow));
@@ -903,29 +1408,29 @@ void PreviewJobPrivate::createThumbnail(const QString &pixPath)
 
 #if WITH_SHM
     size_t requiredSize = thumb_width * devicePixelRatio * thumb_height * devicePixelRatio * 4;
-    if (shmid == -1 || shmsize < requiredSize) {
-        if (shmaddr) {
-            // clean previous shared memory segment
-            shmdt((char *)shmaddr);
-            shmaddr = nullptr;
-            shmctl(shmid, IPC_RMID, nullptr);
-            shmid = -1;
-        }
-        if (requiredSize > 0) {
-            shmid = shmget(IPC_PRIVATE, requiredSize, IPC_CREAT | 0600);
-            if (shmid != -1) {
-                shmsize = requiredSize;
-                shmaddr = (uchar *)(shmat(shmid, nullptr, SHM_RDONLY));
-                if (shmaddr == (uchar *)-1) {
-                    shmctl(shmid, IPC_RMID, nullptr);
-                    shmaddr = nullptr;
-                    shmid = -1;
-                }
-            }
-        }
+    if (!task.buffer.addr && !bufferPool->buffers.empty()) {
+        // reuse the buffer of a finished task
+        task.buffer = bufferPool->buffers.back();
+        bufferPool->buffers.pop_back();
     }
-    if (shmid != -1) {
-        job->addMetaData(QStringLiteral("shmid"), QString::number(shmid));
+#if HAVE_MEMFD_CREATE
+    const bool useMemfd = s_workerSupportsMemfd;
+#else
+    const bool useMemfd = false;
+#endif
+    if (task.buffer.addr && (task.buffer.size < requiredSize || (task.buffer.memfd != -1) != useMemfd)) {
+        // clean previous buffer
+        releaseThumbnailBuffer(task.buffer);
+    }
+    if (!task.buffer.addr && requiredSize > 0) {
+        task.buffer = allocateThumbnailBuffer(requiredSize, useMemfd);
+    }
+    if (task.buffer.memfd != -1) {
+        // The worker connects to this socket to receive the memfd,
+        // and answers with the "memfd" metadata set to 1 if it wrote the image there
+        job->addMetaData(QStringLiteral("memfd"), task.buffer.memfdSocketPath);
+    } else if (task.buffer.shmid != -1) {
+        job->addMetaData(QStringLiteral("shmid"), QString::number(task.buffer.shmid));
     }
 #endif
 }
@@ -934,17 +1439,17 @@ void PreviewJobPrivate::slotStandardThumbData(KIO::Job *job, const QImage &thumb
 {
     thumbnailWorkerMetaData = job->metaData();
 
-    if (thumbData.isNull()) {
+    Task *task = taskForJob(job);
+    if (!task || thumbData.isNull()) {
         // let succeeded in false state
-        // failed will get called in determineNextFile()
+        // failed will get called in finishTask()
         return;
     }
 
     QImage thumb = thumbData;
-    saveThumbnailData(thumb);
+    saveThumbnailData(*task, thumb);
 
-    emitPreview(thumb);
-    succeeded = true;
+    emitPreview(*task, thumb);
 }
 
 void PreviewJobPrivate::slotThumbData(KIO::Job *job, const QByteArray &data)
@@ -954,15 +1459,37 @@ void PreviewJobPrivate::slotThumbData(KIO::Job *job, const QByteArray &data)
     QDataStream str(data);
 
 #if WITH_SHM
-    if (shmaddr != nullptr) {
+    Task *task = taskForJob(job);
+    bool inBuffer = task && task->buffer.addr != nullptr;
+#if HAVE_MEMFD_CREATE
+    const bool workerSupportsMemfd = job->queryMetaData(QStringLiteral("memfd")) == QLatin1String("1");
+    if (workerSupportsMemfd) {
+        s_workerSupportsMemfd = true;
+    } else if (inBuffer && task->buffer.memfd != -1) {
+        // The worker couldn't use the memfd and sent the image itself,
+        // don't give memfds to the next ones
+        inBuffer = false;
+        s_workerSupportsMemfd = false;
+    }
+#endif
+    if (inBuffer) {
         int width;
         int height;
         QImage::Format format;
         qreal imgDevicePixelRatio;
         // TODO KF6: add a version number as first parameter
         str >> width >> height >> format >> imgDevicePixelRatio;
-        thumb = QImage(shmaddr, width, height, format).copy();
-        thumb.setDevicePixelRatio(imgDevicePixelRatio);
+        const qsizetype bytesPerLine = ((qsizetype(width) * QImage::toPixelFormat(format).bitsPerPixel() + 31) / 32) * 4;
+        if (width > 0 && height > 0 && bytesPerLine > 0 && bytesPerLine * height <= qsizetype(task->buffer.size)) {
+            // The image wraps the buffer, which goes back to the pool once the image is released
+            auto *wrapped = new WrappedThumbnailBuffer{bufferPool, task->buffer};
+            task->buffer = ThumbnailBuffer();
+            thumb = QImage(static_cast<const uchar *>(wrapped->buffer.addr), width, height, bytesPerLine, format, giveBackThumbnailBuffer, wrapped);
+            if (thumb.isNull()) {
+                giveBackThumbnailBuffer(wrapped);
+            }
+            thumb.setDevicePixelRatio(imgDevicePixelRatio);
+        }
     }
 #endif
 
@@ -974,24 +1501,24 @@ void PreviewJobPrivate::slotThumbData(KIO::Job *job, const QByteArray &data)
     slotStandardThumbData(job, thumb);
 }
 
-void PreviewJobPrivate::saveThumbnailData(QImage &thumb)
+void PreviewJobPrivate::saveThumbnailData(Task &task, QImage &thumb)
 {
-    const bool save = bSave && !sequenceIndex && currentDeviceCachePolicy == CachePolicy::Allow
-        && currentItem.plugin.value(QStringLiteral("CacheThumbnail"), true)
-        && (!currentItem.item.targetUrl().isLocalFile() || !currentItem.item.targetUrl().adjusted(QUrl::RemoveFilename).toLocalFile().startsWith(thumbRoot));
+    const bool save = bSave && !sequenceIndex && task.cachePolicy == CachePolicy::Allow
+        && task.item.plugin.value(QStringLiteral("CacheThumbnail"), true)
+        && (!task.item.item.targetUrl().isLocalFile() || !task.item.item.targetUrl().adjusted(QUrl::RemoveFilename).toLocalFile().startsWith(thumbRoot));
 
     if (save) {
-        thumb.setText(QStringLiteral("Thumb::URI"), QString::fromUtf8(origName));
-        thumb.setText(QStringLiteral("Thumb::MTime"), QString::number(tOrig.toSecsSinceEpoch()));
-        thumb.setText(QStringLiteral("Thumb::Size"), number(currentItem.item.size()));
-        thumb.setText(QStringLiteral("Thumb::Mimetype"), currentItem.item.mimetype());
-        QString thumbnailerVersion = currentItem.plugin.value(QStringLiteral("ThumbnailerVersion"));
-        QString signature = QLatin1String("KDE Thumbnail Generator ") + currentItem.plugin.name();
+        thumb.setText(QStringLiteral("Thumb::URI"), QString::fromUtf8(task.origName));
+        thumb.setText(QStringLiteral("Thumb::MTime"), QString::number(task.tOrig.toSecsSinceEpoch()));
+        thumb.setText(QStringLiteral("Thumb::Size"), number(task.item.item.size()));
+        thumb.setText(QStringLiteral("Thumb::Mimetype"), task.item.item.mimetype());
+        QString thumbnailerVersion = task.item.plugin.value(QStringLiteral("ThumbnailerVersion"));
+        QString signature = QLatin1String("KDE Thumbnail Generator ") + task.item.plugin.name();
         if (!thumbnailerVersion.isEmpty()) {
             signature.append(QLatin1String(" (v") + thumbnailerVersion + QLatin1Char(')'));
         }
         thumb.setText(QStringLiteral("Software"), signature);
-        QSaveFile saveFile(thumbPath + thumbName);
+        QSaveFile saveFile(thumbPath + task.thumbName);
         if (saveFile.open(QIODevice::WriteOnly)) {
             if (thumb.save(&saveFile, "PNG")) {
                 saveFile.commit();
@@ -1000,9 +1527,8 @@ void PreviewJobPrivate::saveThumbnailData(QImage &thumb)
     }
 }
 
-void PreviewJobPrivate::emitPreview(const QImage &thumb)
+void PreviewJobPrivate::emitPreview(Task &task, const QImage &thumb)
 {
-    Q_Q(PreviewJob);
     QPixmap pix;
     const qreal ratio = thumb.devicePixelRatio();
     if (thumb.width() > width * ratio || thumb.height() > height * ratio) {
@@ -1011,7 +1537,8 @@ void PreviewJobPrivate::emitPreview(const QImage &thumb)
         pix = QPixmap::fromImage(thumb);
     }
     pix.setDevicePixelRatio(ratio);
-    Q_EMIT q->gotPreview(currentItem.item, pix);
+    task.succeeded = true;
+    reportOutcome(task.item.index, {Outcome::Preview, task.item.item, pix});
 }
 
 QList<KPluginMetaData> PreviewJob::availableThumbnailerPlugins()
@@ -94,6 +94,31 @@ public:
      **/
     void setIgnoreMaximumSize(bool ignoreSize = true);
 
+    /**
+     * Sets how many items are processed at the same time, each one by its own
+     * thumbnail worker. Items whose thumbnail is already cached are answered
+     * right away and don't count.
+     *
+     * Defaults to the "MaximumParallelItems" entry of the "PreviewSettings" group,
+     * or to 3 if there is none.
+     * Call this before returning to the event loop, the job starts then.
+     *
+     * @since 6.10
+     */
+    void setMaximumParallelItems(int count);
+
+    /**
+     * If @p inOrder is true, gotPreview() and failed() are emitted in the order
+     * of the items given to the job, although the items are processed in parallel.
+     * A preview then waits for the ones of all the items before it.
+     *
+     * Defaults to false, previews being emitted as soon as they are ready.
+     * Call this before returning to the event loop, the job starts then.
+     *
+     * @since 6.10
+     */
+    void setEmitInOrder(bool inOrder = true);
+
     /**
      * Sets the sequence index given to the thumb creators.
      * Use the sequence index, it is possible to create alternative
@@ -9,7 +9,7 @@
 #include <QSocketNotifier>
 #include <cerrno>
 
-#include "sharefd_p.h"
+#include "../../sharefd_p.h"
 
 FdReceiver::FdReceiver(const std::string &path, QObject *parent)
     : QObject(parent)
@@ -959,8 +959,10 @@ static QString readLogFile(const QByteArray &_filename)
     return result;
 }
 
+#ifdef Q_OS_WIN
 // We could port this to KTempDir::removeDir but then we wouldn't be able to tell the user
 // where exactly the deletion failed, in case of errors.
+// See file_unix.cpp for the unix version.
 WorkerResult FileProtocol::deleteRecursive(const QString &path)
 {
     // qDebug() << path;
@@ -1000,6 +1002,7 @@ WorkerResult FileProtocol::deleteRecursive(const QString &path)
     }
     return WorkerResult::pass();
 }
+#endif
 
 WorkerResult FileProtocol::fileSystemFreeSpace(const QUrl &url)
 {
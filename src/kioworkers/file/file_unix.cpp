@@ -15,6 +15,7 @@
 
 #include "config-kioworker-file.h"
 
+#include "../../dirunlinker_p.h"
 #include "../utils_p.h"
 
 #if HAVE_POSIX_ACL
@@ -26,6 +27,8 @@
 #include <QMimeDatabase>
 #include <QStandardPaths>
 #include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 #include <qplatformdefs.h>
 
 #include <KConfigGroup>
@@ -36,6 +39,8 @@
 
 #include <array>
 #include <cerrno>
+#include <fcntl.h>
+#include <memory>
 #include <stdint.h>
 #include <utime.h>
 
@@ -49,6 +54,7 @@
 
 #include <linux/fs.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #endif // Q_OS_LINUX
@@ -177,7 +183,7 @@ using StatStruct = struct statx;
 using StatStruct = QT_STATBUF;
 #endif
 
-static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path)
+static QByteArray readlinkToBuffer(const StatStruct &buf, int dirFd, const char *path)
 {
     // Use readlink on Unix because symLinkTarget turns relative targets into absolute (#352927)
     size_t size = stat_size(buf);
@@ -190,7 +196,7 @@ static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path
     size_t bufferSize = qBound(lowerBound, size + 1, higherBound);
     QByteArray linkTargetBuffer(bufferSize, Qt::Initialization::Uninitialized);
     while (true) {
-        ssize_t n = readlink(path.constData(), linkTargetBuffer.data(), bufferSize);
+        ssize_t n = readlinkat(dirFd, path, linkTargetBuffer.data(), bufferSize);
         if (n < 0 && errno != ERANGE) {
             /* On AIX 5L v5.3 and HP-UX 11i v2 04/09, readlink returns -1
                with errno == ERANGE if the buffer is too small.
@@ -209,7 +215,29 @@ static QByteArray readlinkToBuffer(const StatStruct &buf, const QByteArray &path
     return linkTargetBuffer;
 }
 
-static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSEntry &entry, KIO::StatDetails details, const QString &fullPath)
+/*
+ * Where createUDSEntry() finds a file: @c name relative to the directory open
+ * as @c dirFd, or an absolute path with AT_FDCWD and empty base paths.
+ * Listings use the former so that the kernel doesn't walk the whole path again
+ * for every entry; the full paths are only built for what needs them.
+ */
+struct EntryLocation {
+    int dirFd;
+    const char *name;
+    const QByteArray &encodedBasePath; // with a trailing slash
+    const QString &basePath; // same, decoded
+
+    QByteArray encodedFullPath() const
+    {
+        return encodedBasePath + name;
+    }
+    QString fullPath() const
+    {
+        return basePath + QFile::decodeName(name);
+    }
+};
+
+static bool createUDSEntry(const QString &filename, const EntryLocation &location, UDSEntry &entry, KIO::StatDetails details)
 {
     assert(entry.count() == 0); // by contract :-)
     int entries = 0;
@@ -245,16 +273,16 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
 
     bool isBrokenSymLink = false;
 #if HAVE_POSIX_ACL
-    QByteArray targetPath = path;
+    QByteArray targetPath;
 #endif
 
     StatStruct buff;
 
-    if (LSTAT(path.constData(), &buff, details) == 0) {
+    if (LSTAT_AT(location.dirFd, location.name, &buff, details) == 0) {
         if (Utils::isLinkMask(stat_mode(buff))) {
             QByteArray linkTargetBuffer;
             if (details & (KIO::StatBasic | KIO::StatResolveSymlink)) {
-                linkTargetBuffer = readlinkToBuffer(buff, path);
+                linkTargetBuffer = readlinkToBuffer(buff, location.dirFd, location.name);
                 if (linkTargetBuffer.isEmpty()) {
                     return false;
                 }
@@ -264,7 +292,7 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
 
             // A symlink
             if (details & KIO::StatResolveSymlink) {
-                if (STAT(path.constData(), &buff, details) == -1) {
+                if (STAT_AT(location.dirFd, location.name, &buff, details) == -1) {
                     isBrokenSymLink = true;
                 } else {
 #if HAVE_POSIX_ACL
@@ -307,7 +335,7 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
             /* Append an atom indicating whether the file has extended acl information
              * and if withACL is specified also one with the acl itself. If it's a directory
              * and it has a default ACL, also append that. */
-            appendACLAtoms(targetPath, entry, type);
+            appendACLAtoms(targetPath.isEmpty() ? location.encodedFullPath() : targetPath, entry, type);
         }
 #endif
     }
@@ -353,7 +381,7 @@ static bool createUDSEntry(const QString &filename, const QByteArray &path, UDSE
     if (details & KIO::StatMimeType) {
         if (type == 0 || type != S_IFDIR) {
             QMimeDatabase db;
-            entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, db.mimeTypeForFile(fullPath).name());
+            entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, db.mimeTypeForFile(location.fullPath()).name());
         } else {
             // fast path for directories
             entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QStringLiteral("inode/directory"));
@@ -917,48 +945,203 @@ static bool isNtfsHidden(const QString &filename)
 }
 #endif
 
-WorkerResult FileProtocol::listDir(const QUrl &url)
+/*
+ * Reads the entries of a directory. On Linux this calls getdents64 directly
+ * with a large buffer, getting many entries per syscall; elsewhere it uses readdir().
+ * The entry returned by next() is only valid until the following call.
+ */
+class DirEntryReader
 {
-    if (!isLocalFileSameHost(url)) {
-        QUrl redir(url);
-        redir.setScheme(configValue(QStringLiteral("DefaultRemoteProtocol"), QStringLiteral("smb")));
-        redirection(redir);
-        // qDebug() << "redirecting to " << redir;
-        return WorkerResult::pass();
+public:
+    explicit DirEntryReader(DIR *dp)
+        : m_dp(dp)
+    {
     }
-    const QString path(url.toLocalFile());
-    const QByteArray _path(QFile::encodeName(path));
-    DIR *dp = opendir(_path.data());
-    if (dp == nullptr) {
-        switch (errno) {
-        case ENOENT:
-            return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
-        case ENOTDIR:
-            return WorkerResult::fail(KIO::ERR_IS_FILE, path);
-#ifdef ENOMEDIUM
-        case ENOMEDIUM:
-            return WorkerResult::fail(ERR_WORKER_DEFINED, i18n("No media in device for %1", path));
+
+    // The name of the next entry, or nullptr at the end of the directory
+    const char *next()
+    {
+#ifdef Q_OS_LINUX
+        if (m_offset >= m_size) {
+            if (m_buffer.isEmpty()) {
+                m_buffer.resize(s_bufferSize);
+            }
+            const long n = syscall(SYS_getdents64, dirfd(m_dp), m_buffer.data(), m_buffer.size());
+            if (n <= 0) {
+                return nullptr;
+            }
+            m_size = n;
+            m_offset = 0;
+        }
+        // The kernel's records have the layout of glibc's dirent64
+        const auto *ent = reinterpret_cast<const struct dirent64 *>(m_buffer.constData() + m_offset);
+        m_offset += ent->d_reclen;
+        m_type = ent->d_type;
+        return ent->d_name;
+#else
+        QT_DIRENT *ep = QT_READDIR(m_dp);
+        if (!ep) {
+            return nullptr;
+        }
+#if HAVE_DIRENT_D_TYPE
+        m_type = ep->d_type;
 #endif
-        default:
-            return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, path);
-            break;
+        return ep->d_name;
+#endif
+    }
+
+    // The d_type of the current entry, 0 (DT_UNKNOWN) if not known
+    int type() const
+    {
+        return m_type;
+    }
+
+private:
+    DIR *const m_dp;
+    int m_type = 0;
+#ifdef Q_OS_LINUX
+    static constexpr int s_bufferSize = 64 * 1024;
+    QByteArray m_buffer;
+    long m_size = 0;
+    long m_offset = 0;
+#endif
+};
+
+static bool isSubDirectory(int dirFd, const char *name, int dType)
+{
+#if HAVE_DIRENT_D_TYPE
+    if (dType != DT_UNKNOWN) {
+        return dType == DT_DIR;
+    }
+#else
+    Q_UNUSED(dType)
+#endif
+    // Don't follow symlinks, ListJob never recursed into those either
+    struct stat st;
+    return fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+/*
+ * Fills @p entry for a detailed listing of the entry @p name of the directory
+ * open as @p dirFd, found at @p basePath (@p encodedBasePath), both with a trailing slash.
+ * @p dType is the d_type of the dirent, where available.
+ * This is called from the threads of the stat pool as well, see listDirEntries().
+ */
+static bool createListEntry(const QString &displayName,
+                            const QString &filename,
+                            int dirFd,
+                            const QByteArray &encodedBasePath,
+                            const QString &basePath,
+                            const QByteArray &name,
+                            int dType,
+                            KIO::StatDetails details,
+                            UDSEntry &entry)
+{
+    Q_UNUSED(dType)
+    if (!createUDSEntry(displayName, {dirFd, name.constData(), encodedBasePath, basePath}, entry, details)) {
+        return false;
+    }
+#if HAVE_SYS_XATTR_H && HAVE_DIRENT_D_TYPE
+    if (isNtfsHidden(filename)) {
+        bool ntfsHidden = true;
+
+        // Bug 392913: NTFS root volume is always "hidden", ignore this
+        if (dType == DT_DIR || dType == DT_UNKNOWN || dType == DT_LNK) {
+            const QString fullFilePath = QDir(filename).canonicalPath();
+            auto mountPoint = KMountPoint::currentMountPoints().findByPath(fullFilePath);
+            if (mountPoint && mountPoint->mountPoint() == fullFilePath) {
+                ntfsHidden = false;
+            }
+        }
+
+        if (ntfsHidden) {
+            entry.fastInsert(KIO::UDSEntry::UDS_HIDDEN, 1);
         }
     }
+#else
+    Q_UNUSED(filename)
+#endif
+    return true;
+}
 
-    const QByteArray encodedBasePath = _path + '/';
+// An entry of a detailed listing, waiting for the stat pool
+struct PendingListEntry {
+    QByteArray name;
+    QString displayName;
+    QString filename;
+    int dType;
+    UDSEntry entry;
+    bool valid = false;
+};
+
+// Number of entries handed to the stat pool at once
+static constexpr int s_statBatchSize = 128;
+
+/*
+ * Emits the entries of the directory @p dp, found at @p path (@p encodedPath).
+ * @p namePrefix is empty for the listed directory itself and "sub/dir/" for
+ * the directories below it when listing recursively; those don't get "." and
+ * "..", nor hidden entries unless @p listHidden is set.
+ * If @p subdirs is set, the names of the subdirectories to descend into are
+ * appended to it.
+ * If @p statPool is set, the entries of a detailed listing are stat'ed by its
+ * threads, one batch at a time, while this thread keeps reading the directory.
+ * They are still emitted in the order of the directory.
+ * Entries are stat'ed relative to the directory's file descriptor.
+ */
+static void listDirEntries(WorkerBase *worker,
+                           DIR *dp,
+                           const QString &path,
+                           const QByteArray &encodedPath,
+                           const QString &namePrefix,
+                           KIO::StatDetails details,
+                           bool listHidden,
+                           QList<QByteArray> *subdirs,
+                           QThreadPool *statPool)
+{
+    const int dirFd = dirfd(dp);
+    const QByteArray encodedBasePath = encodedPath + '/';
+    const QString basePath = Utils::slashAppended(path);
+    const bool isSubDir = !namePrefix.isEmpty();
 
-    const KIO::StatDetails details = getStatDetails();
-    // qDebug() << "========= LIST " << url << "details=" << details << " =========";
     UDSEntry entry;
 
-#if !(HAVE_DIRENT_D_TYPE)
-    QT_STATBUF st;
-#endif
-    QT_DIRENT *ep;
-    while ((ep = QT_READDIR(dp)) != nullptr) {
+    QList<PendingListEntry> batch;
+    QList<PendingListEntry> inFlight;
+    QFuture<void> inFlightFuture;
+    auto statPending = [&](PendingListEntry &pending) {
+        pending.valid =
+            createListEntry(pending.displayName, pending.filename, dirFd, encodedBasePath, basePath, pending.name, pending.dType, details, pending.entry);
+    };
+    // Emits the batch being stat'ed, if any, and hands the current one over to the pool
+    auto flushBatch = [&]() {
+        inFlightFuture.waitForFinished();
+        for (const PendingListEntry &pending : std::as_const(inFlight)) {
+            if (pending.valid) {
+                worker->listEntry(pending.entry);
+            }
+        }
+        inFlight = std::move(batch);
+        batch = {};
+        inFlightFuture = inFlight.isEmpty() ? QFuture<void>() : QtConcurrent::map(statPool, inFlight, statPending);
+    };
+
+    DirEntryReader reader(dp);
+    while (const char *name = reader.next()) {
         entry.clear();
 
-        const QString filename = QFile::decodeName(ep->d_name);
+        const bool isDotOrDotDot = qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0;
+        const bool isHidden = name[0] == '.';
+        if (isSubDir && (isDotOrDotDot || (isHidden && !listHidden))) {
+            continue;
+        }
+        const int dType = reader.type();
+        if (subdirs && !isDotOrDotDot && (listHidden || !isHidden) && isSubDirectory(dirFd, name, dType)) {
+            subdirs->append(QByteArray(name));
+        }
+
+        // Only now that the entry is known to be listed
+        const QString filename = QFile::decodeName(name);
 
         /*
          * details == 0 (if statement) is the fast code path.
@@ -971,50 +1154,167 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
          *
          */
         if (details == KIO::StatBasic) {
-            entry.fastInsert(KIO::UDSEntry::UDS_NAME, filename);
+            entry.fastInsert(KIO::UDSEntry::UDS_NAME, isSubDir ? namePrefix + filename : filename);
 #if HAVE_DIRENT_D_TYPE
-            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, (ep->d_type == DT_DIR) ? S_IFDIR : S_IFREG);
-            const bool isSymLink = (ep->d_type == DT_LNK);
+            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, (dType == DT_DIR) ? S_IFDIR : S_IFREG);
+            const bool isSymLink = (dType == DT_LNK);
 #else
             // oops, no fast way, we need to stat (e.g. on Solaris)
-            if (QT_LSTAT(ep->d_name, &st) == -1) {
+            StatStruct st;
+            if (LSTAT_AT(dirFd, name, &st, KIO::StatBasic) == -1) {
                 continue; // how can stat fail?
             }
-            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_ISDIR(st.st_mode) ? S_IFDIR : S_IFREG);
-            const bool isSymLink = S_ISLNK(st.st_mode);
+            entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_ISDIR(stat_mode(st)) ? S_IFDIR : S_IFREG);
+            const bool isSymLink = S_ISLNK(stat_mode(st));
 #endif
             if (isSymLink) {
                 // for symlinks obey the UDSEntry contract and provide UDS_LINK_DEST
                 // even if we don't know the link dest (and DeleteJob doesn't care...)
                 entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, QStringLiteral("Dummy Link Target"));
             }
-            listEntry(entry);
+            worker->listEntry(entry);
 
         } else {
-            QString fullPath = Utils::slashAppended(path);
-            fullPath += filename;
+            const QString displayName = isSubDir ? namePrefix + filename : filename;
+            if (statPool) {
+                batch.append({QByteArray(name), displayName, filename, dType});
+                if (batch.size() == s_statBatchSize) {
+                    flushBatch();
+                }
+            } else if (createListEntry(displayName, filename, dirFd, encodedBasePath, basePath, QByteArray::fromRawData(name, qstrlen(name)), dType, details, entry)) {
+                worker->listEntry(entry);
+            }
+        }
+    }
 
-            if (createUDSEntry(filename, encodedBasePath + QByteArray(ep->d_name), entry, details, fullPath)) {
-#if HAVE_SYS_XATTR_H && HAVE_DIRENT_D_TYPE
-                if (isNtfsHidden(filename)) {
-                    bool ntfsHidden = true;
-
-                    // Bug 392913: NTFS root volume is always "hidden", ignore this
-                    if (ep->d_type == DT_DIR || ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK) {
-                        const QString fullFilePath = QDir(filename).canonicalPath();
-                        auto mountPoint = KMountPoint::currentMountPoints().findByPath(fullFilePath);
-                        if (mountPoint && mountPoint->mountPoint() == fullFilePath) {
-                            ntfsHidden = false;
-                        }
-                    }
+    if (statPool) {
+        // Once for the batch in flight, once for the last one
+        flushBatch();
+        flushBatch();
+    }
+}
 
-                    if (ntfsHidden) {
-                        entry.fastInsert(KIO::UDSEntry::UDS_HIDDEN, 1);
-                    }
-                }
+// How many directories listSubDirs() keeps open at once, along the path it's descending
+static constexpr int s_maxOpenSubDirs = 32;
+
+/*
+ * Recursive part of listDir() when metadata "recurse" is set: descends into
+ * @p subdirs of the directory open as @p parentFd, depth first.
+ * Directories are opened relative to their parent, so the kernel doesn't
+ * have to resolve the full path again at every level. Below s_maxOpenSubDirs
+ * levels, a directory is closed before descending, and its subdirectories are
+ * opened by full path (@p parentFd is then -1).
+ * The names of the subdirectories that couldn't be opened are appended to @p unreadableDirs.
+ */
+static void listSubDirs(WorkerBase *worker,
+                        int parentFd,
+                        const QString &parentPath,
+                        const QByteArray &encodedParentPath,
+                        const QString &namePrefix,
+                        const QList<QByteArray> &subdirs,
+                        KIO::StatDetails details,
+                        bool listHidden,
+                        QThreadPool *statPool,
+                        int depth,
+                        QStringList *unreadableDirs)
+{
+    for (const QByteArray &subdir : subdirs) {
+        if (worker->wasKilled()) {
+            return;
+        }
+
+        const QString name = QFile::decodeName(subdir);
+        const QString path = Utils::concatPaths(parentPath, name);
+        const QByteArray encodedPath = encodedParentPath + '/' + subdir;
+        const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+        const int fd = parentFd != -1 ? openat(parentFd, subdir.constData(), flags) : ::open(encodedPath.constData(), flags);
+        DIR *dp = fd != -1 ? fdopendir(fd) : nullptr;
+        if (!dp) {
+            // ListJob lists it again with a sub-job, which reports the error
+            unreadableDirs->append(namePrefix + name);
+            if (fd != -1) {
+                ::close(fd);
+            }
+            continue;
+        }
+
+        const QString prefix = namePrefix + name + QLatin1Char('/');
+        QList<QByteArray> nestedSubdirs;
+        listDirEntries(worker, dp, path, encodedPath, prefix, details, listHidden, &nestedSubdirs, statPool);
+        if (depth < s_maxOpenSubDirs) {
+            listSubDirs(worker, dirfd(dp), path, encodedPath, prefix, nestedSubdirs, details, listHidden, statPool, depth + 1, unreadableDirs);
+            closedir(dp);
+        } else {
+            closedir(dp);
+            listSubDirs(worker, -1, path, encodedPath, prefix, nestedSubdirs, details, listHidden, statPool, depth + 1, unreadableDirs);
+        }
+    }
+}
+
+WorkerResult FileProtocol::listDir(const QUrl &url)
+{
+    if (!isLocalFileSameHost(url)) {
+        QUrl redir(url);
+        redir.setScheme(configValue(QStringLiteral("DefaultRemoteProtocol"), QStringLiteral("smb")));
+        redirection(redir);
+        // qDebug() << "redirecting to " << redir;
+        return WorkerResult::pass();
+    }
+    const QString path(url.toLocalFile());
+    const QByteArray _path(QFile::encodeName(path));
+    DIR *dp = opendir(_path.data());
+    if (dp == nullptr) {
+        switch (errno) {
+        case ENOENT:
+            return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
+        case ENOTDIR:
+            return WorkerResult::fail(KIO::ERR_IS_FILE, path);
+#ifdef ENOMEDIUM
+        case ENOMEDIUM:
+            return WorkerResult::fail(ERR_WORKER_DEFINED, i18n("No media in device for %1", path));
 #endif
-                listEntry(entry);
+        default:
+            return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, path);
+            break;
+        }
+    }
+
+    const KIO::StatDetails details = getStatDetails();
+    // Set by ListJob for recursive listings, see listRecursive in file.json
+    const bool recurse = metaData(QStringLiteral("recurse")) == QLatin1String("true");
+    const bool listHidden = metaData(QStringLiteral("listHidden")) == QLatin1String("true");
+    // qDebug() << "========= LIST " << url << "details=" << details << " =========";
+
+    // On network filesystems every stat, readlink and ACL lookup of a detailed listing
+    // is a round trip to the server, so run several of them at once.
+    // "ListStatThreads" (worker config or metadata) overrides the number of threads,
+    // 1 meaning no thread pool at all.
+    std::unique_ptr<QThreadPool> statPool;
+    if (details != KIO::StatBasic) {
+        int statThreads = configValue(QStringLiteral("ListStatThreads"), 0);
+        if (statThreads <= 0) {
+            const KFileSystemType::Type fsType = KFileSystemType::fileSystemType(path);
+            statThreads = (fsType == KFileSystemType::Nfs || fsType == KFileSystemType::Smb) ? 8 : 1;
+        }
+        if (statThreads > 1) {
+            statPool = std::make_unique<QThreadPool>();
+            statPool->setMaxThreadCount(statThreads);
+        }
+    }
+
+    QList<QByteArray> subdirs;
+    listDirEntries(this, dp, path, _path, QString(), details, listHidden, recurse ? &subdirs : nullptr, statPool.get());
+    if (recurse) {
+        QStringList unreadableDirs;
+        listSubDirs(this, dirfd(dp), path, _path, QString(), subdirs, details, listHidden, statPool.get(), 1, &unreadableDirs);
+        if (!unreadableDirs.isEmpty()) {
+            // Percent-encoded, one per line, read by ListJob::slotFinished
+            QStringList encodedNames;
+            encodedNames.reserve(unreadableDirs.size());
+            for (const QString &name : std::as_const(unreadableDirs)) {
+                encodedNames.append(QString::fromLatin1(QUrl::toPercentEncoding(name, "/")));
             }
+            setMetaData(QStringLiteral("unreadableDirs"), encodedNames.join(QLatin1Char('\n')));
         }
     }
 
@@ -1159,6 +1459,153 @@ WorkerResult FileProtocol::symlink(const QString &target, const QUrl &destUrl, K
     return WorkerResult::pass();
 }
 
+// The entries of one directory, removed in one go by deleteRecursive()
+struct DeleteBatch {
+    QByteArray dirPath;
+    QList<QByteArray> names;
+};
+
+/*
+ * Collects what's below @p path for deleteRecursive(): the non-directories into
+ * @p fileBatches, one batch per directory, and the subdirectories into @p dirLevels,
+ * one list of batches per depth level. Symlinks to directories aren't followed.
+ */
+static void collectDeleteBatches(const QByteArray &path, QList<DeleteBatch> &fileBatches, QList<QList<DeleteBatch>> &dirLevels)
+{
+    QList<QByteArray> level{path};
+    while (!level.isEmpty()) {
+        QList<QByteArray> nextLevel;
+        QList<DeleteBatch> dirBatches;
+        for (const QByteArray &dirPath : std::as_const(level)) {
+            const int fd = QT_OPEN(dirPath.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            DIR *dp = fd == -1 ? nullptr : fdopendir(fd);
+            if (!dp) {
+                if (fd != -1) {
+                    QT_CLOSE(fd);
+                }
+                // Removing that directory will fail and tell why
+                continue;
+            }
+            DeleteBatch files{dirPath, {}};
+            DeleteBatch dirs{dirPath, {}};
+            DirEntryReader reader(dp);
+            while (const char *name = reader.next()) {
+                if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) {
+                    continue;
+                }
+                if (isSubDirectory(fd, name, reader.type())) {
+                    dirs.names.append(QByteArray(name));
+                    nextLevel.append(dirPath + '/' + name);
+                } else {
+                    files.names.append(QByteArray(name));
+                }
+            }
+            closedir(dp);
+            if (!files.names.isEmpty()) {
+                fileBatches.append(std::move(files));
+            }
+            if (!dirs.names.isEmpty()) {
+                dirBatches.append(std::move(dirs));
+            }
+        }
+        if (!dirBatches.isEmpty()) {
+            dirLevels.append(std::move(dirBatches));
+        }
+        level = std::move(nextLevel);
+    }
+}
+
+// Removes the entries of @p batch, (empty) directories if @p dirs is set, and returns
+// the paths that couldn't be removed. Runs on the threads of the deleteRecursive() pool.
+static QList<QByteArray> removeDeleteBatch(const DeleteBatch &batch, bool dirs)
+{
+    QList<QByteArray> failedPaths;
+    const DirUnlinker::Dir dir(batch.dirPath);
+    for (const QByteArray &name : batch.names) {
+        if (!dir.unlink(name.constData(), dirs ? AT_REMOVEDIR : 0)) {
+            failedPaths.append(batch.dirPath + '/' + name);
+        }
+    }
+    return failedPaths;
+}
+
+// We can't use KTempDir::removeDir, we wouldn't be able to tell the user
+// where exactly the deletion failed, in case of errors.
+WorkerResult FileProtocol::deleteRecursive(const QString &path)
+{
+    QList<DeleteBatch> fileBatches;
+    QList<QList<DeleteBatch>> dirLevels;
+    collectDeleteBatches(QFile::encodeName(path), fileBatches, dirLevels);
+
+    // The batches of a level are independent from each other, they're removed in parallel
+    QThreadPool pool;
+    pool.setMaxThreadCount(DirUnlinker::maxThreadCount());
+
+    // The progress is reported in entries, DeleteJob adds it to its own
+    KIO::filesize_t entries = 0;
+    for (const DeleteBatch &batch : std::as_const(fileBatches)) {
+        entries += batch.names.size();
+    }
+    for (const QList<DeleteBatch> &level : std::as_const(dirLevels)) {
+        for (const DeleteBatch &batch : level) {
+            entries += batch.names.size();
+        }
+    }
+    totalSize(entries);
+    KIO::filesize_t removedEntries = 0;
+
+    const auto removeBatches = [this, &pool, &removedEntries](const QList<DeleteBatch> &batches, bool dirs) {
+        QList<QByteArray> failedPaths;
+        // A few batches per thread at a time, to report the progress along the way
+        const qsizetype chunkSize = 4 * pool.maxThreadCount();
+        for (qsizetype i = 0; i < batches.size(); i += chunkSize) {
+            const QList<DeleteBatch> chunk = batches.mid(i, chunkSize);
+            const QList<QList<QByteArray>> failed =
+                QtConcurrent::blockingMapped<QList<QList<QByteArray>>>(&pool, chunk, [dirs](const DeleteBatch &batch) {
+                    return removeDeleteBatch(batch, dirs);
+                });
+            for (qsizetype j = 0; j < chunk.size(); ++j) {
+                removedEntries += chunk.at(j).names.size() - failed.at(j).size();
+                failedPaths += failed.at(j);
+            }
+            processedSize(removedEntries);
+        }
+        return failedPaths;
+    };
+    // Try again what the pool couldn't remove, with privilege escalation if needed
+    const auto removeFailed = [this, &removedEntries](const QList<QByteArray> &failedPaths, ActionType action) {
+        for (const QByteArray &itemPath : failedPaths) {
+            if ((action == DEL ? unlink(itemPath.constData()) : QT_RMDIR(itemPath.constData())) != 0) {
+                auto result = execWithElevatedPrivilege(action, {QFile::decodeName(itemPath)}, errno);
+                if (!result.success()) {
+                    if (!resultWasCancelled(result)) {
+                        return WorkerResult::fail(KIO::ERR_CANNOT_DELETE, QFile::decodeName(itemPath));
+                    }
+                    return result;
+                }
+            }
+            ++removedEntries;
+        }
+        if (!failedPaths.isEmpty()) {
+            processedSize(removedEntries);
+        }
+        return WorkerResult::pass();
+    };
+
+    auto result = removeFailed(removeBatches(fileBatches, false), DEL);
+    if (!result.success()) {
+        return result;
+    }
+    // Children must go before their parents: deepest level first, each level in parallel
+    for (auto it = dirLevels.crbegin(); it != dirLevels.crend(); ++it) {
+        result = removeFailed(removeBatches(*it, true), RMDIR);
+        if (!result.success()) {
+            return result;
+        }
+    }
+    return WorkerResult::pass();
+}
+
 WorkerResult FileProtocol::del(const QUrl &url, bool isfile)
 {
     const QString path = url.toLocalFile();
@@ -1287,7 +1734,7 @@ WorkerResult FileProtocol::stat(const QUrl &url)
     const KIO::StatDetails details = getStatDetails();
 
     UDSEntry entry;
-    if (!createUDSEntry(url.fileName(), _path, entry, details, path)) {
+    if (!createUDSEntry(url.fileName(), {AT_FDCWD, _path.constData(), {}, {}}, entry, details)) {
         return WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, path);
     }
     statEntry(entry);
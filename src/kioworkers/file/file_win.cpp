@@ -189,12 +189,31 @@ WorkerResult FileProtocol::listDir(const QUrl &url)
         // qDebug() << "========= ERR_CANNOT_ENTER_DIRECTORY =========";
         return WorkerResult::fail(KIO::ERR_CANNOT_ENTER_DIRECTORY, path);
     }
-    QDirIterator it(dir);
+    // Set by ListJob for recursive listings, see listRecursive in file.json
+    const bool recurse = metaData(QStringLiteral("recurse")) == QLatin1String("true");
+    const bool listHidden = metaData(QStringLiteral("listHidden")) == QLatin1String("true");
+
+    QDirIterator it(dir, recurse ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
     UDSEntry entry;
     while (it.hasNext()) {
         it.next();
         UDSEntry entry = createUDSEntryWin(it.fileInfo());
 
+        if (recurse) {
+            const QString relativePath = dir.relativeFilePath(it.filePath());
+            if (relativePath.contains(QLatin1Char('/'))) {
+                // Below the listed directory: no "." and "..", and no hidden entries unless asked for
+                const QString fileName = it.fileName();
+                if (fileName == QLatin1String(".") || fileName == QLatin1String("..")) {
+                    continue;
+                }
+                if (!listHidden && (relativePath.startsWith(QLatin1Char('.')) || relativePath.contains(QLatin1String("/.")))) {
+                    continue;
+                }
+                entry.replace(KIO::UDSEntry::UDS_NAME, relativePath);
+            }
+        }
+
         listEntry(entry);
         entry.clear();
     }
@@ -6,7 +6,7 @@
 
 #include "fdsender.h"
 
-#include "../sharefd_p.h"
+#include "../../../sharefd_p.h"
 #include <cerrno>
 #include <string.h>
 
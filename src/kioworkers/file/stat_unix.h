@@ -17,6 +17,10 @@
 #include <sys/sysmacros.h> // for makedev()
 #endif
 
+#ifndef Q_OS_WIN
+#include <fcntl.h> // for AT_FDCWD and AT_SYMLINK_NOFOLLOW
+#endif
+
 #ifdef Q_OS_WIN
 // QT_LSTAT on Windows
 #include "kioglobal_p.h"
@@ -24,7 +28,8 @@
 
 #if HAVE_STATX
 // statx syscall is available
-inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
+// The *_AT variants resolve @p path relative to the directory open as @p dirFd
+inline int LSTAT_AT(int dirFd, const char *path, struct statx *buff, KIO::StatDetails details)
 {
     uint32_t mask = 0;
     if (details & KIO::StatBasic) {
@@ -43,9 +48,13 @@ inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
         // dev, inode
         mask |= STATX_INO;
     }
-    return statx(AT_FDCWD, path, AT_SYMLINK_NOFOLLOW, mask, buff);
+    return statx(dirFd, path, AT_SYMLINK_NOFOLLOW, mask, buff);
 }
-inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &details)
+inline int LSTAT(const char *path, struct statx *buff, KIO::StatDetails details)
+{
+    return LSTAT_AT(AT_FDCWD, path, buff, details);
+}
+inline int STAT_AT(int dirFd, const char *path, struct statx *buff, const KIO::StatDetails &details)
 {
     uint32_t mask = 0;
     // KIO::StatAcl needs type
@@ -66,7 +75,11 @@ inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &de
         mask |= STATX_ATIME | STATX_MTIME | STATX_BTIME;
     }
     // KIO::Inode is ignored as when STAT is called, the entry inode field has already been filled
-    return statx(AT_FDCWD, path, AT_STATX_SYNC_AS_STAT, mask, buff);
+    return statx(dirFd, path, AT_STATX_SYNC_AS_STAT, mask, buff);
+}
+inline int STAT(const char *path, struct statx *buff, const KIO::StatDetails &details)
+{
+    return STAT_AT(AT_FDCWD, path, buff, details);
 }
 inline static uint16_t stat_mode(const struct statx &buf)
 {
@@ -112,6 +125,19 @@ inline int STAT(const char *path, QT_STATBUF *buff, KIO::StatDetails details)
     Q_UNUSED(details)
     return QT_STAT(path, buff);
 }
+#ifndef Q_OS_WIN
+// The *_AT variants resolve @p path relative to the directory open as @p dirFd
+inline int LSTAT_AT(int dirFd, const char *path, QT_STATBUF *buff, KIO::StatDetails details)
+{
+    Q_UNUSED(details)
+    return ::fstatat(dirFd, path, buff, AT_SYMLINK_NOFOLLOW);
+}
+inline int STAT_AT(int dirFd, const char *path, QT_STATBUF *buff, KIO::StatDetails details)
+{
+    Q_UNUSED(details)
+    return ::fstatat(dirFd, path, buff, 0);
+}
+#endif
 inline static mode_t stat_mode(const QT_STATBUF &buf)
 {
     return buf.st_mode;
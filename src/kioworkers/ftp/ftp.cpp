@@ -30,6 +30,7 @@
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 
 #include <QAuthenticator>
 #include <QCoreApplication>
@@ -40,6 +41,7 @@
 #include <QSslSocket>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QTimeZone>
 
 #include <KConfigGroup>
 #include <KLocalizedString>
@@ -111,6 +113,11 @@ enum buffersizes {
      * KIO workers using the data() function
      */
     maximumIpcSize = 32 * 1024,
+    /**
+     * buffer size used when copying between a data connection and a local
+     * file, where the IPC limit above doesn't apply
+     */
+    maximumFileBufferSize = 256 * 1024,
     /**
      * this is a reasonable value for an initial read() that a KIO worker
      * can do to obtain data via a slow network connection.
@@ -122,6 +129,18 @@ enum buffersizes {
     minimumMimeSize = 1024,
 };
 
+// How long a directory listing may be used to answer stat() calls, and
+// how many entries may be cached in all
+static constexpr qint64 s_listingCacheLifetime = 10 * 1000; // ms
+static constexpr int s_listingCacheMaxEntries = 10000;
+
+// The key of the listing of the directory @p path in the listing cache
+static QString listingKey(const QString &path)
+{
+    const QString cleanPath = QDir::cleanPath(path);
+    return cleanPath.isEmpty() ? QStringLiteral("/") : cleanPath;
+}
+
 // JPF: this helper was derived from write_all in file.cc (FileProtocol).
 static // JPF: in ftp.cc we make it static
     /**
@@ -223,6 +242,7 @@ const char *FtpInternal::ftpResponse(int iOffset)
     if (iOffset < 0) {
         int iMore = 0;
         m_iRespCode = 0;
+        m_responseLines.clear();
 
         if (!pTxt) {
             return nullptr; // avoid using a nullptr when calling atoi.
@@ -234,6 +254,7 @@ const char *FtpInternal::ftpResponse(int iOffset)
         do {
             while (!m_control->canReadLine() && m_control->waitForReadyRead((DEFAULT_READ_TIMEOUT * 1000))) { }
             m_lastControlLine = m_control->readLine();
+            m_responseLines.append(m_lastControlLine);
             pTxt = m_lastControlLine.data();
             int iCode = atoi(pTxt);
             if (iMore == 0) {
@@ -288,6 +309,9 @@ void FtpInternal::closeConnection()
     // close the data and control connections ...
     ftpCloseDataConnection();
     ftpCloseControlConnection();
+
+    // The next connection may well be to another host, or as another user
+    m_listingCache.clear();
 }
 
 FtpInternal::FtpInternal(Ftp *qptr)
@@ -295,6 +319,7 @@ FtpInternal::FtpInternal(Ftp *qptr)
     , q(qptr)
 {
     ftpCloseControlConnection();
+    m_listingCache.setMaxCost(s_listingCacheMaxEntries);
 }
 
 FtpInternal::~FtpInternal()
@@ -460,6 +485,8 @@ Result FtpInternal::ftpOpenControlConnection(const QString &host, int port)
     }
     const auto connectionResult = synchronousConnectToHost(host, port);
     m_control = connectionResult.socket;
+    // Commands and replies are tiny, don't let Nagle's algorithm delay them
+    m_control->setSocketOption(QAbstractSocket::LowDelayOption, 1);
 
     int iErrorCode = m_control->state() == QAbstractSocket::ConnectedState ? 0 : ERR_CANNOT_CONNECT;
     if (!connectionResult.result.success()) {
@@ -673,6 +700,35 @@ Result FtpInternal::ftpLogin(bool *userChanged)
         qCWarning(KIO_FTP) << "SYST failed";
     }
 
+    // Look for the machine readable listings of RFC 3659
+    if (ftpSendCmd(QByteArrayLiteral("FEAT")) && (m_iRespType == 2)) {
+        for (const QByteArray &line : std::as_const(m_responseLines)) {
+            // The features are the lines starting with a space, e.g. " MLST type*;size*;modify*;"
+            const QByteArray feature = line.trimmed();
+            if (!line.startsWith(' ') || !feature.toUpper().startsWith("MLST")) {
+                continue;
+            }
+            m_extControl |= mlstSupported;
+
+            // Ask for the facts we use among the ones the server knows about
+            static const QByteArrayList s_wantedFacts = {"type", "size", "modify", "perm", "unix.mode", "unix.owner", "unix.group"};
+            QByteArray wanted;
+            const QByteArrayList facts = feature.mid(4).trimmed().split(';');
+            for (QByteArray fact : facts) {
+                if (fact.endsWith('*')) {
+                    fact.chop(1);
+                }
+                if (s_wantedFacts.contains(fact.toLower())) {
+                    wanted += fact + ';';
+                }
+            }
+            if (!wanted.isEmpty() && (!ftpSendCmd("OPTS MLST " + wanted) || m_iRespType != 2)) {
+                qCDebug(KIO_FTP) << "OPTS MLST failed, using the default facts";
+            }
+            break;
+        }
+    }
+
     // Get the current working directory
     qCDebug(KIO_FTP) << "Searching for pwd";
     if (!ftpSendCmd(QByteArrayLiteral("PWD")) || (m_iRespType != 2)) {
@@ -1051,6 +1107,7 @@ Result FtpInternal::ftpOpenCommand(const char *_command, const QString &_path, c
 
         if (m_data) {
             qCDebug(KIO_FTP) << "connected with remote.";
+            m_data->setSocketOption(QAbstractSocket::LowDelayOption, 1);
             m_bBusy = true; // cleared in ftpCloseCommand
             return Result::pass();
         }
@@ -1071,6 +1128,7 @@ bool FtpInternal::ftpCloseCommand()
     // first close data sockets (if opened), then read response that
     // we got for whatever was used in ftpOpenCommand ( should be 226 )
     ftpCloseDataConnection();
+    m_bMlsdListing = false;
 
     if (!m_bBusy) {
         return true;
@@ -1093,6 +1151,8 @@ Result FtpInternal::mkdir(const QUrl &url, int permissions)
         return result;
     }
 
+    ftpInvalidateListings(url.path());
+
     const QByteArray encodedPath(q->remoteEncoding()->encode(url));
     const QString path = QString::fromLatin1(encodedPath.constData(), encodedPath.size());
 
@@ -1126,6 +1186,9 @@ Result FtpInternal::rename(const QUrl &src, const QUrl &dst, KIO::JobFlags flags
         return result;
     }
 
+    ftpInvalidateListings(src.path());
+    ftpInvalidateListings(dst.path());
+
     // The actual functionality is in ftpRename because put needs it
     return ftpRename(src.path(), dst.path(), flags);
 }
@@ -1173,6 +1236,8 @@ Result FtpInternal::del(const QUrl &url, bool isfile)
         return result;
     }
 
+    ftpInvalidateListings(url.path());
+
     // When deleting a directory, we must exit from it first
     // The last command probably went into it (to stat it)
     if (!isfile) {
@@ -1223,6 +1288,8 @@ Result FtpInternal::chmod(const QUrl &url, int permissions)
         return result;
     }
 
+    ftpInvalidateListings(url.path());
+
     if (!ftpChmod(url.path(), permissions)) {
         return Result::fail(ERR_CANNOT_CHMOD, url.path());
     }
@@ -1338,6 +1405,32 @@ Result FtpInternal::stat(const QUrl &url)
     const QString filename = tempurl.fileName();
     Q_ASSERT(!filename.isEmpty());
 
+    // Answer from the listing of the parent directory if we just got it
+    {
+        FtpEntry ftpEnt;
+        if (ftpCachedEntry(path, ftpEnt)) {
+            UDSEntry entry;
+            ftpCreateUDSEntry(filename, ftpEnt, entry, false);
+            q->statEntry(entry);
+            return Result::pass();
+        }
+    }
+
+    // A single MLST tells us everything, instead of CWD + LIST
+    if (m_extControl & mlstSupported) {
+        FtpEntry ftpEnt;
+        if (ftpMlst(path, ftpEnt)) {
+            UDSEntry entry;
+            ftpCreateUDSEntry(filename, ftpEnt, entry, S_ISDIR(ftpEnt.type));
+            q->statEntry(entry);
+            return Result::pass();
+        }
+        if (m_iRespType == 5) {
+            return ftpStatAnswerNotFound(path, filename);
+        }
+        qCDebug(KIO_FTP) << "MLST failed, falling back to LIST";
+    }
+
     // Try cwd into it, if it works it's a dir (and then we'll list the parent directory to get more info)
     // if it doesn't work, it's a file (and then we'll use dir filename)
     bool isDir = ftpFolder(path);
@@ -1432,6 +1525,64 @@ Result FtpInternal::stat(const QUrl &url)
     return Result::pass();
 }
 
+bool FtpInternal::ftpMlst(const QString &path, FtpEntry &de)
+{
+    if (!ftpSendCmd("MLST " + q->remoteEncoding()->encode(path)) || m_iRespType != 2) {
+        return false;
+    }
+
+    // 250-Listing /path
+    //  type=file;size=1234;modify=20240102030405; /path
+    // 250 End
+    for (const QByteArray &line : std::as_const(m_responseLines)) {
+        if (line.startsWith(' ') && ftpParseMlsxFacts(line.mid(1), de)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FtpInternal::ftpCachedEntry(const QString &path, FtpEntry &de)
+{
+    const QString cleanPath = QDir::cleanPath(path);
+    const int pos = cleanPath.lastIndexOf(QLatin1Char('/'));
+    const QString key = listingKey(cleanPath.left(pos + 1));
+    FtpListing *listing = m_listingCache.object(key);
+    if (!listing) {
+        return false;
+    }
+    if (listing->age.hasExpired(s_listingCacheLifetime)) {
+        m_listingCache.remove(key);
+        return false;
+    }
+
+    const auto it = listing->entries.constFind(cleanPath.mid(pos + 1));
+    // Only the server can tell whether a symlink points to a directory
+    if (it == listing->entries.cend() || !it->link.isEmpty()) {
+        return false;
+    }
+    qCDebug(KIO_FTP) << "found" << path << "in the listing cache";
+    de = *it;
+    return true;
+}
+
+void FtpInternal::ftpInvalidateListings(const QString &path)
+{
+    if (m_listingCache.isEmpty()) {
+        return;
+    }
+
+    const QString key = listingKey(path);
+    const QString parentKey = listingKey(key.left(key.lastIndexOf(QLatin1Char('/')) + 1));
+    const QString childPrefix = key.endsWith(QLatin1Char('/')) ? key : key + QLatin1Char('/');
+    const QList<QString> keys = m_listingCache.keys();
+    for (const QString &cached : keys) {
+        if (cached == key || cached == parentKey || cached.startsWith(childPrefix)) {
+            m_listingCache.remove(cached);
+        }
+    }
+}
+
 bool FtpInternal::maybeEmitStatEntry(FtpEntry &ftpEnt, const QString &filename, bool isDir)
 {
     if (filename == ftpEnt.name && !filename.isEmpty()) {
@@ -1487,11 +1638,13 @@ Result FtpInternal::listDir(const QUrl &url)
     UDSEntry entry;
     FtpEntry ftpEnt;
     QList<FtpEntry> ftpValidateEntList;
+    auto listing = std::make_unique<FtpListing>();
     while (ftpReadDir(ftpEnt)) {
         qCDebug(KIO_FTP) << ftpEnt.name;
         // Q_ASSERT( !ftpEnt.name.isEmpty() );
         if (!ftpEnt.name.isEmpty()) {
-            if (ftpEnt.name.at(0).isSpace()) {
+            // MLSD names are exact, no need to guess whether leading spaces belong to them
+            if (!m_bMlsdListing && ftpEnt.name.at(0).isSpace()) {
                 ftpValidateEntList.append(ftpEnt);
                 continue;
             }
@@ -1503,6 +1656,7 @@ Result FtpInternal::listDir(const QUrl &url)
             ftpCreateUDSEntry(ftpEnt.name, ftpEnt, entry, false);
             q->listEntry(entry);
             entry.clear();
+            listing->entries.insert(ftpEnt.name, ftpEnt);
         }
     }
 
@@ -1512,9 +1666,15 @@ Result FtpInternal::listDir(const QUrl &url)
         ftpCreateUDSEntry(ftpEnt.name, ftpEnt, entry, false);
         q->listEntry(entry);
         entry.clear();
+        listing->entries.insert(ftpEnt.name, ftpEnt);
     }
 
     ftpCloseCommand(); // closes the data connection only
+
+    // Keep the listing around for the stat() calls that usually follow
+    const int cost = listing->entries.size() + 1;
+    listing->age.start();
+    m_listingCache.insert(listingKey(path), listing.release(), cost);
     return Result::pass();
 }
 
@@ -1546,6 +1706,17 @@ Result FtpInternal::ftpOpenDir(const QString &path)
     // In fact we have to use -la otherwise -a removes the default -l (e.g. ftp.trolltech.com)
     // Pass KJob::NoError first because we don't want to emit error before we
     // have tried all commands.
+    // MLSD gives machine readable listings, no need to guess the format of "ls" output
+    if (m_extControl & mlstSupported) {
+        const auto result = ftpOpenCommand("mlsd", QString(), 'I', KJob::NoError);
+        if (result.success()) {
+            m_bMlsdListing = true;
+            qCDebug(KIO_FTP) << "Starting of MLSD was ok";
+            return result;
+        }
+        ftpCloseDataConnection();
+    }
+
     auto result = ftpOpenCommand("list -la", QString(), 'I', KJob::NoError);
     if (!result.success()) {
         result = ftpOpenCommand("list", QString(), 'I', KJob::NoError);
@@ -1580,6 +1751,13 @@ bool FtpInternal::ftpReadDir(FtpEntry &de)
         const char *buffer = data.data();
         qCDebug(KIO_FTP) << "dir > " << buffer;
 
+        if (m_bMlsdListing) {
+            if (ftpParseMlsxFacts(data, de)) {
+                return true;
+            }
+            continue;
+        }
+
         // Normally the listing looks like
         // -rw-r--r--   1 dfaure   dfaure        102 Nov  9 12:30 log
         // but on Netware servers like ftp://ci-1.ci.pwr.wroc.pl/ it looks like (#76442)
@@ -1804,6 +1982,103 @@ bool FtpInternal::ftpReadDir(FtpEntry &de)
     return false;
 }
 
+bool FtpInternal::ftpParseMlsxFacts(const QByteArray &line, FtpEntry &de)
+{
+    // The name is everything after the first space, and may itself contain spaces
+    const qsizetype space = line.indexOf(' ');
+    if (space == -1) {
+        return false;
+    }
+    QByteArray name = line.mid(space + 1);
+    while (name.endsWith('\n') || name.endsWith('\r')) {
+        name.chop(1);
+    }
+    if (name.isEmpty()) {
+        return false;
+    }
+
+    de.type = S_IFREG;
+    de.access = 0;
+    de.size = 0;
+    de.date = QDateTime();
+    de.owner.clear();
+    de.group.clear();
+    de.link.clear();
+
+    bool hasMode = false;
+    QByteArray perm;
+    const QByteArrayList facts = line.left(space).split(';');
+    for (const QByteArray &fact : facts) {
+        const qsizetype equal = fact.indexOf('=');
+        if (equal == -1) {
+            continue;
+        }
+        const QByteArray key = fact.left(equal).toLower();
+        const QByteArray value = fact.mid(equal + 1);
+        if (key == "type") {
+            const QByteArray type = value.toLower();
+            if (type == "cdir" || type == "pdir") {
+                return false;
+            } else if (type == "dir") {
+                de.type = S_IFDIR;
+            } else if (type.startsWith("os.unix=slink") || type.startsWith("os.unix=symlink")) {
+                // "OS.unix=slink:/target", the target being optional
+                const qsizetype colon = value.indexOf(':');
+                de.link = colon == -1 ? QStringLiteral("?") : q->remoteEncoding()->decode(value.mid(colon + 1));
+            }
+        } else if (key == "size") {
+            de.size = charToLongLong(value.constData());
+        } else if (key == "modify") {
+            // YYYYMMDDHHMMSS[.sss], in UTC
+            const QDate date(value.mid(0, 4).toInt(), value.mid(4, 2).toInt(), value.mid(6, 2).toInt());
+            const QTime time(value.mid(8, 2).toInt(), value.mid(10, 2).toInt(), value.mid(12, 2).toInt());
+            if (date.isValid() && time.isValid()) {
+                de.date = QDateTime(date, time, QTimeZone::UTC);
+            }
+        } else if (key == "unix.mode") {
+            bool ok;
+            const uint mode = value.toUInt(&ok, 8);
+            if (ok) {
+                de.access = mode & 07777;
+                hasMode = true;
+            }
+        } else if (key == "unix.owner") {
+            de.owner = q->remoteEncoding()->decode(value);
+        } else if (key == "unix.group") {
+            de.group = q->remoteEncoding()->decode(value);
+        } else if (key == "perm") {
+            perm = value.toLower();
+        }
+    }
+
+    if (!hasMode) {
+        // Only "perm" to go by, which tells what we may do: give the same to everyone
+        // for reading, and only to the owner for writing
+        if (perm.contains('r') || perm.contains('l') || perm.contains('e')) {
+            de.access |= S_IRUSR | S_IRGRP | S_IROTH;
+        }
+        if (perm.contains('w') || perm.contains('a') || perm.contains('c') || perm.contains('m')) {
+            de.access |= S_IWUSR;
+        }
+        if (de.type == S_IFDIR && perm.contains('e')) {
+            de.access |= S_IXUSR | S_IXGRP | S_IXOTH;
+        }
+    }
+
+    if (name.startsWith('/')) {
+        // MLST answers with the full path
+        name = name.mid(name.lastIndexOf('/') + 1);
+        if (name.isEmpty()) {
+            return false;
+        }
+    } else if (name.indexOf('/') != -1) {
+        return false; // Don't trick us!
+    }
+    de.name = q->remoteEncoding()->decode(name);
+
+    return true;
+}
+
 //===============================================================================
 // public: get           download file from server
 // helper: ftpGet        called from get() and copy()
@@ -1878,7 +2153,8 @@ Result FtpInternal::ftpGet(int iCopyFile, const QString &sCopyFile, const QUrl &
     KIO::fileoffset_t processed_size = llOffset;
 
     QByteArray array;
-    char buffer[maximumIpcSize];
+    // When writing to a local file, use a bigger buffer than what can go through IPC
+    QByteArray buffer(iCopyFile == -1 ? maximumIpcSize : maximumFileBufferSize, Qt::Uninitialized);
     // start with small data chunks in case of a slow data source (modem)
     // - unfortunately this has a negative impact on performance for large
     // - files - so we will increase the block size after a while ...
@@ -1888,17 +2164,17 @@ Result FtpInternal::ftpGet(int iCopyFile, const QString &sCopyFile, const QUrl &
     while (m_size == UnknownSize || bytesLeft > 0) {
         // let the buffer size grow if the file is larger 64kByte ...
         if (processed_size - llOffset > 1024 * 64) {
-            iBlockSize = maximumIpcSize;
+            iBlockSize = buffer.size();
         }
 
         // read the data and detect EOF or error ...
-        if (iBlockSize + iBufferCur > (int)sizeof(buffer)) {
-            iBlockSize = sizeof(buffer) - iBufferCur;
+        if (iBlockSize + iBufferCur > buffer.size()) {
+            iBlockSize = buffer.size() - iBufferCur;
         }
         if (m_data->bytesAvailable() == 0) {
             m_data->waitForReadyRead((DEFAULT_READ_TIMEOUT * 1000));
         }
-        int n = m_data->read(buffer + iBufferCur, iBlockSize);
+        int n = m_data->read(buffer.data() + iBufferCur, iBlockSize);
         if (n <= 0) {
             // this is how we detect EOF in case of unknown size
             if (m_size == UnknownSize && n == 0) {
@@ -1924,10 +2200,10 @@ Result FtpInternal::ftpGet(int iCopyFile, const QString &sCopyFile, const QUrl &
         // write output file or pass to data pump ...
         int writeError = 0;
         if (iCopyFile == -1) {
-            array = QByteArray::fromRawData(buffer, n);
+            array = QByteArray::fromRawData(buffer.constData(), n);
             q->data(array);
             array.clear();
-        } else if ((writeError = WriteToFile(iCopyFile, buffer, n)) != 0) {
+        } else if ((writeError = WriteToFile(iCopyFile, buffer.constData(), n)) != 0) {
             return Result::fail(writeError, sCopyFile);
         }
 
@@ -1975,6 +2251,8 @@ Result FtpInternal::ftpPut(int iCopyFile, const QUrl &dest_url, int permissions,
     QString dest_orig = dest_url.path();
     const QString dest_part = dest_orig + QLatin1String(".part");
 
+    ftpInvalidateListings(dest_orig);
+
     if (ftpSize(dest_orig, 'I')) {
         if (m_size == 0) {
             // delete files with zero size
@@ -2053,7 +2331,7 @@ Result FtpInternal::ftpPut(int iCopyFile, const QUrl &dest_url, int permissions,
         } else {
             // let the buffer size grow if the file is larger 64kByte ...
             if (processed_size - offset > 1024 * 64) {
-                iBlockSize = maximumIpcSize;
+                iBlockSize = maximumFileBufferSize;
             }
             buffer.resize(iBlockSize);
             result = QT_READ(iCopyFile, buffer.data(), buffer.size());
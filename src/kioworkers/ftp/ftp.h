@@ -11,7 +11,10 @@
 
 #include <qplatformdefs.h>
 
+#include <QCache>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QUrl>
 
 #include <workerbase.h>
@@ -33,6 +36,15 @@ struct FtpEntry {
     QDateTime date;
 };
 
+/**
+ * A directory listing kept for a short while after listDir(), so that
+ * stat() calls on its entries don't need to ask the server again
+ */
+struct FtpListing {
+    QHash<QString, FtpEntry> entries;
+    QElapsedTimer age;
+};
+
 class FtpInternal;
 
 /**
@@ -278,6 +290,34 @@ public:
      */
     bool ftpReadDir(FtpEntry &ftpEnt);
 
+    /**
+     * Parses a line of MLSD output, or the fact line of a MLST answer (RFC 3659):
+     * "fact=value;fact=value; name".
+     * @return false if the line doesn't describe an entry of interest
+     *         (e.g. the "cdir" and "pdir" entries)
+     */
+    bool ftpParseMlsxFacts(const QByteArray &line, FtpEntry &de);
+
+    /**
+     * Asks for the facts about @p path with a single MLST command.
+     * Only to be used if the server advertised MLST.
+     * @return true if @p de was filled, otherwise check m_iRespType
+     *         to tell a missing file (5) from another failure
+     */
+    bool ftpMlst(const QString &path, FtpEntry &de);
+
+    /**
+     * Looks up @p path in the listing cache.
+     * @return true if the listing of its parent directory is cached and has an entry for it
+     */
+    bool ftpCachedEntry(const QString &path, FtpEntry &de);
+
+    /**
+     * Forgets the cached listings that a change of @p path makes stale:
+     * the one of its parent directory and, if it's a directory, its own and the ones below it.
+     */
+    void ftpInvalidateListings(const QString &path);
+
     /**
      * Helper to fill an UDSEntry
      */
@@ -456,6 +496,7 @@ private: // data members
         epsvAllSent = 0x10,
         pasvUnknown = 0x20,
         chmodUnknown = 0x100,
+        mlstSupported = 0x200, // FEAT listed MLST, so MLST and MLSD are available
     };
     int m_extControl;
 
@@ -464,6 +505,20 @@ private: // data members
      */
     QTcpSocket *m_control = nullptr;
     QByteArray m_lastControlLine;
+    /**
+     * all the lines of the last response, see ftpResponse()
+     */
+    QList<QByteArray> m_responseLines;
+
+    /**
+     * true if the listing being read by ftpReadDir() comes from MLSD
+     */
+    bool m_bMlsdListing = false;
+
+    /**
+     * recent directory listings, by cleaned path, the cost being the number of entries
+     */
+    QCache<QString, FtpListing> m_listingCache;
 
     /**
      * data connection socket
@@ -14,12 +14,14 @@
 
 #include "http.h"
 #include "debug.h"
+#include "httpcache.h"
 #include "kioglobal_p.h"
 
 #include <QAuthenticator>
 #include <QBuffer>
 #include <QCoreApplication>
 #include <QDomDocument>
+#include <QLocale>
 #include <QMimeDatabase>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
@@ -27,6 +29,9 @@
 #include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QSslCipher>
+#include <QSslConfiguration>
+#include <QStandardPaths>
+#include <QXmlStreamReader>
 
 #include <KLocalizedString>
 
@@ -106,6 +111,99 @@ bool isDav(const QString &protocol)
     return protocol.startsWith(QLatin1String("webdav")) || protocol.startsWith(QLatin1String("dav"));
 }
 
+// Hands the data sent by the job over to QNetworkAccessManager as it asks for it,
+// so that an upload neither waits for nor keeps the whole body in memory.
+// @p size is the size announced in the Content-Length header, -1 if unknown.
+class JobDataDevice : public QIODevice
+{
+public:
+    explicit JobDataDevice(KIO::WorkerBase *worker, qint64 size = -1)
+        : m_worker(worker)
+        , m_size(size)
+    {
+        open(QIODevice::ReadOnly);
+    }
+
+    // Whether the job sent more or less data than announced. The device then ends
+    // early, and emits readChannelFinished() for the request to be aborted.
+    bool sizeMismatch() const
+    {
+        return m_sizeMismatch;
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return m_chunk.size() - m_chunkPos + QIODevice::bytesAvailable();
+    }
+
+    bool atEnd() const override
+    {
+        return m_finished && m_chunkPos == m_chunk.size() && QIODevice::atEnd();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        if (m_chunkPos == m_chunk.size()) {
+            if (m_finished) {
+                return -1;
+            }
+            // QNAM only asks for more once it sent what it had, which limits the
+            // amount of data in flight to about one chunk
+            m_chunk = nextChunk();
+            m_chunkPos = 0;
+            m_sent += m_chunk.size();
+            m_finished = m_chunk.isEmpty();
+            if (m_size >= 0 && m_sent >= m_size && !m_finished) {
+                // QNAM won't ask for more than announced: make sure the job has nothing
+                // left before the end of the body goes out
+                m_finished = true;
+                m_sent += nextChunk().size();
+            }
+            if (m_finished && m_size >= 0 && m_sent != m_size) {
+                m_sizeMismatch = true;
+                m_chunk.clear();
+                Q_EMIT readChannelFinished();
+            }
+            if (m_chunk.isEmpty()) {
+                return -1;
+            }
+        }
+
+        const qint64 count = qMin<qint64>(maxSize, m_chunk.size() - m_chunkPos);
+        memcpy(data, m_chunk.constData() + m_chunkPos, count);
+        m_chunkPos += count;
+        return count;
+    }
+
+    qint64 writeData(const char * /*data*/, qint64 /*maxSize*/) override
+    {
+        return -1;
+    }
+
+private:
+    QByteArray nextChunk()
+    {
+        m_worker->dataReq();
+        QByteArray chunk;
+        m_worker->readData(chunk);
+        return chunk;
+    }
+
+    KIO::WorkerBase *const m_worker;
+    const qint64 m_size;
+    qint64 m_sent = 0;
+    QByteArray m_chunk;
+    qsizetype m_chunkPos = 0;
+    bool m_finished = false;
+    bool m_sizeMismatch = false;
+};
+
 QUrl protocolChangedToHttp(const QUrl &url)
 {
     QUrl newUrl{url};
@@ -128,6 +226,36 @@ HTTPProtocol::~HTTPProtocol()
 {
 }
 
+void HTTPProtocol::closeConnection()
+{
+    if (m_nam) {
+        m_nam->clearAccessCache();
+    }
+    m_nam.reset();
+    m_namKey.clear();
+}
+
+QNetworkAccessManager *HTTPProtocol::networkAccessManager(const QUrl &url)
+{
+    // Keep one manager for as long as we talk to the same server, so that its
+    // connections (and TLS sessions) get reused from one request to the next
+    const QString key = url.scheme() + QLatin1String("://") + url.authority(QUrl::RemovePassword);
+    if (!m_nam || key != m_namKey) {
+        m_nam = std::make_unique<QNetworkAccessManager>();
+        // Disable automatic redirect handling from Qt. We need to intercept redirects
+        // to let KIO handle them
+        m_nam->setRedirectPolicy(QNetworkRequest::ManualRedirectPolicy);
+        if (configValue(QStringLiteral("UseCache"), true)) {
+            // The manager takes ownership of the cache
+            const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kio_http");
+            const qint64 maxCacheSize = configValue(QStringLiteral("MaxCacheSize"), 50 * 1024) * qint64(1024); // in KiB
+            m_nam->setCache(new HttpDiskCache(cacheDir, maxCacheSize));
+        }
+        m_namKey = key;
+    }
+    return m_nam.get();
+}
+
 QString readMimeType(QNetworkReply *reply)
 {
     const QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
@@ -239,7 +367,8 @@ HTTPProtocol::Response HTTPProtocol::makeDavRequest(const QUrl &url,
                                                     KIO::HTTP_METHOD method,
                                                     QByteArray &inputData,
                                                     DataMode dataMode,
-                                                    const QMap<QByteArray, QByteArray> &extraHeaders)
+                                                    const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                    const DataCallback &dataCallback)
 {
     auto headers = extraHeaders;
     const QString locks = davProcessLocks();
@@ -252,14 +381,61 @@ HTTPProtocol::Response HTTPProtocol::makeDavRequest(const QUrl &url,
         headers.insert("If", locks.toLatin1());
     }
 
-    return makeRequest(url, method, inputData, dataMode, headers);
+    return makeRequest(url, method, inputData, dataMode, headers, dataCallback);
 }
 
-HTTPProtocol::Response
-HTTPProtocol::makeRequest(const QUrl &url, KIO::HTTP_METHOD method, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders)
+HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
+                                                 KIO::HTTP_METHOD method,
+                                                 QByteArray &inputData,
+                                                 DataMode dataMode,
+                                                 const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                 const DataCallback &dataCallback)
 {
     QBuffer buffer(&inputData);
-    return makeRequest(url, method, &buffer, dataMode, extraHeaders);
+    return makeRequest(url, method, &buffer, dataMode, extraHeaders, dataCallback);
+}
+
+// Maps the "cache" metadata (see KIO::CacheControl) to how QNAM uses its cache
+static QNetworkRequest::CacheLoadControl cacheLoadControl(const QString &cacheControl)
+{
+    if (cacheControl.compare(QLatin1String("cacheonly"), Qt::CaseInsensitive) == 0) {
+        return QNetworkRequest::AlwaysCache;
+    }
+    if (cacheControl.compare(QLatin1String("cache"), Qt::CaseInsensitive) == 0) {
+        return QNetworkRequest::PreferCache;
+    }
+    if (cacheControl.compare(QLatin1String("reload"), Qt::CaseInsensitive) == 0) {
+        return QNetworkRequest::AlwaysNetwork;
+    }
+    // "verify", the default: fresh entries are used as they are, the others are
+    // revalidated with If-None-Match/If-Modified-Since. "refresh" revalidates
+    // fresh entries as well, see makeRequest()
+    return QNetworkRequest::PreferNetwork;
+}
+
+// Sets the validators of the cached response to @p url on @p request, for the server
+// to answer with a 304 if it didn't change, which QNAM then serves from the cache
+static void setCacheValidators(QNetworkRequest &request, const QUrl &url, QAbstractNetworkCache *cache)
+{
+    const QNetworkCacheMetaData metaData = cache->metaData(url);
+    if (!metaData.isValid()) {
+        return;
+    }
+    const QNetworkCacheMetaData::RawHeaderList headers = metaData.rawHeaders();
+    for (const auto &[name, value] : headers) {
+        if (name.compare("ETag", Qt::CaseInsensitive) == 0) {
+            request.setRawHeader("If-None-Match", value);
+        }
+    }
+    if (metaData.lastModified().isValid()) {
+        request.setRawHeader("If-Modified-Since",
+                             QLocale::c().toString(metaData.lastModified().toUTC(), QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT'")).toLatin1());
+    }
+}
+
+static QByteArray basicAuthorization(const QString &user, const QString &password)
+{
+    return QByteArrayLiteral("Basic ") + (user + QLatin1Char(':') + password).toUtf8().toBase64();
 }
 
 static QString protocolForProxyType(QNetworkProxy::ProxyType type)
@@ -284,14 +460,14 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
                                                  KIO::HTTP_METHOD method,
                                                  QIODevice *inputData,
                                                  HTTPProtocol::DataMode dataMode,
-                                                 const QMap<QByteArray, QByteArray> &extraHeaders)
+                                                 const QMap<QByteArray, QByteArray> &extraHeaders,
+                                                 const DataCallback &dataCallback)
 {
-    QNetworkAccessManager nam;
+    QUrl properUrl = protocolChangedToHttp(url);
 
-    // Disable automatic redirect handling from Qt. We need to intercept redirects
-    // to let KIO handle them
-    nam.setRedirectPolicy(QNetworkRequest::ManualRedirectPolicy);
+    QNetworkAccessManager *nam = networkAccessManager(properUrl);
 
+    // The cookie jar only lives for this request, the manager deletes the previous one
     auto cookies = new Cookies;
 
     if (metaData(QStringLiteral("cookies")) == QStringLiteral("manual")) {
@@ -302,14 +478,38 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         });
     }
 
-    nam.setCookieJar(cookies);
-
-    QUrl properUrl = protocolChangedToHttp(url);
+    nam->setCookieJar(cookies);
 
     m_hostName = properUrl.host();
 
-    connect(&nam, &QNetworkAccessManager::authenticationRequired, this, [this, url](QNetworkReply * /*reply*/, QAuthenticator *authenticator) {
-        if (configValue(QStringLiteral("no-www-auth"), false)) {
+    const bool noWwwAuth = configValue(QStringLiteral("no-www-auth"), false);
+
+    // Whether credentials were given for this request
+    bool credentialsGiven = !properUrl.userName().isEmpty();
+    // The Authorization header for the credentials the server asked for with the Basic scheme,
+    // sent right away when following the redirect of this request, see below
+    QByteArray basicCredentials;
+    bool urlCredentialsTried = false;
+
+    // The manager outlives this request: these connections are dropped once it's done
+    const QMetaObject::Connection authConnection = connect(nam, &QNetworkAccessManager::authenticationRequired, this, [this, url, noWwwAuth, &credentialsGiven, &basicCredentials, &urlCredentialsTried](QNetworkReply *reply, QAuthenticator *authenticator) {
+        if (noWwwAuth) {
+            return;
+        }
+
+        const bool basic = reply->rawHeader("WWW-Authenticate").trimmed().toLower().startsWith("basic");
+        const auto setCredentials = [&](const QString &user, const QString &password) {
+            authenticator->setUser(user);
+            authenticator->setPassword(password);
+            credentialsGiven = true;
+            basicCredentials = basic ? basicAuthorization(user, password) : QByteArray();
+        };
+
+        // The URL's credentials are sent as an Authorization header, which is only
+        // enough for the Basic scheme
+        if (!urlCredentialsTried && !url.userName().isEmpty() && !url.password().isEmpty()) {
+            urlCredentialsTried = true;
+            setCredentials(url.userName(), url.password());
             return;
         }
 
@@ -331,8 +531,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         const QUrl reqUrl = authinfo.url;
 
         if (checkCachedAuthentication(authinfo)) {
-            authenticator->setUser(authinfo.username);
-            authenticator->setPassword(authinfo.password);
+            setCredentials(authinfo.username, authinfo.password);
         } else {
             // Reset url to the saved url...
             authinfo.url = reqUrl;
@@ -342,8 +541,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
             const int errorCode = openPasswordDialog(authinfo, QString());
 
             if (!errorCode) {
-                authenticator->setUser(authinfo.username);
-                authenticator->setPassword(authinfo.password);
+                setCredentials(authinfo.username, authinfo.password);
                 if (authinfo.keepPassword) {
                     cacheAuthentication(authinfo);
                 }
@@ -351,7 +549,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     });
 
-    connect(&nam, &QNetworkAccessManager::proxyAuthenticationRequired, this, [this](const QNetworkProxy &proxy, QAuthenticator *authenticator) {
+    const QMetaObject::Connection proxyAuthConnection = connect(nam, &QNetworkAccessManager::proxyAuthenticationRequired, this, [this, &credentialsGiven](const QNetworkProxy &proxy, QAuthenticator *authenticator) {
         if (configValue(QStringLiteral("no-proxy-auth"), false)) {
             return;
         }
@@ -386,6 +584,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         if (checkCachedAuthentication(authinfo)) {
             authenticator->setUser(authinfo.username);
             authenticator->setPassword(authinfo.password);
+            credentialsGiven = true;
         } else {
             // Reset url to the saved url...
             authinfo.url = reqUrl;
@@ -397,6 +596,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
             if (!errorCode) {
                 authenticator->setUser(authinfo.username);
                 authenticator->setPassword(authinfo.password);
+                credentialsGiven = true;
                 if (authinfo.keepPassword) {
                     cacheAuthentication(authinfo);
                 }
@@ -404,7 +604,8 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     });
 
-    QNetworkRequest request(properUrl);
+    // The credentials of the URL go with this request only, see below
+    QNetworkRequest request(properUrl.adjusted(QUrl::RemoveUserInfo));
 
     const QByteArray contentType = getContentType().toUtf8();
 
@@ -428,10 +629,41 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         request.setRawHeader("Accept", accept.toUtf8());
     }
 
+    // The manager is shared by the requests to this server, possibly of other jobs and for
+    // other paths: it must not send the credentials of one request with the next ones.
+    // Credentials the server asked for go through the authentication handler for each
+    // request, like with a manager per request, only the connections are kept.
+    request.setAttribute(QNetworkRequest::AuthenticationReuseAttribute, QNetworkRequest::Manual);
+    if (!noWwwAuth && !properUrl.userName().isEmpty() && !properUrl.password().isEmpty()) {
+        request.setRawHeader("Authorization", basicAuthorization(properUrl.userName(), properUrl.password()));
+    }
+
     if (metaData(QStringLiteral("HttpVersion")) == QStringLiteral("http1")) {
         request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
     }
 
+    if (method == KIO::HTTP_GET || method == KIO::HTTP_HEAD) {
+        const QString cacheControl = metaData(QStringLiteral("cache"));
+        if (cacheControl.compare(QLatin1String("refresh"), Qt::CaseInsensitive) == 0) {
+            // QNAM serves fresh entries without asking the server, so ask it ourselves.
+            // max-age=0 also keeps QNAM from turning this into a "no-cache" reload.
+            request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+            request.setRawHeader("Cache-Control", "max-age=0");
+            if (QAbstractNetworkCache *cache = nam->cache()) {
+                setCacheValidators(request, request.url(), cache);
+            }
+        } else {
+            request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, cacheLoadControl(cacheControl));
+        }
+    }
+
+    if (properUrl.scheme() == QLatin1String("https")) {
+        // Let the following connections to this server resume the TLS session instead of doing a full handshake
+        QSslConfiguration sslConfiguration = request.sslConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        request.setSslConfiguration(sslConfiguration);
+    }
+
     for (auto [key, value] : extraHeaders.asKeyValueRange()) {
         request.setRawHeader(key, value);
     }
@@ -448,11 +680,43 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
         }
     }
 
-    if (inputData) {
+    // The cache is keyed by URL only: what's behind authentication mustn't end up in it,
+    // to be served later to whoever asks for that URL
+    const bool authenticated = !properUrl.userName().isEmpty() || request.hasRawHeader("Authorization") || m_authenticatedServers.contains(m_namKey);
+    if (authenticated) {
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    }
+
+    if (inputData && inputData->isSequential() && request.header(QNetworkRequest::ContentLengthHeader).isValid()) {
+        // Stream the data instead of having QNAM read it all before sending the request.
+        // Without a known length QNAM has no choice but to buffer it.
+        request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+    }
+
+    if (inputData && !inputData->isSequential()) {
         inputData->startTransaction(); // To be able to restart after redirects.
     }
 
-    QNetworkReply *reply = nam.sendCustomRequest(request, methodToString(method), inputData);
+    QNetworkReply *reply = nam->sendCustomRequest(request, methodToString(method), inputData);
+    auto deleteReply = qScopeGuard([reply] {
+        reply->deleteLater();
+    });
+
+    auto *jobData = dynamic_cast<JobDataDevice *>(inputData);
+    if (jobData) {
+        // Queued, the device is being read by the reply
+        QObject::connect(
+            jobData,
+            &QIODevice::readChannelFinished,
+            reply,
+            [reply, jobData] {
+                if (jobData->sizeMismatch()) {
+                    // Neither leave the server waiting for the missing data nor let it take a truncated body
+                    reply->abort();
+                }
+            },
+            Qt::QueuedConnection);
+    }
 
     bool mimeTypeEmitted = false;
 
@@ -530,7 +794,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     });
 
     if (dataMode == Emit) {
-        QObject::connect(reply, &QNetworkReply::readyRead, &nam, [this, reply] {
+        QObject::connect(reply, &QNetworkReply::readyRead, reply, [this, reply] {
             while (reply->bytesAvailable() > 0) {
                 QByteArray buf(2048, Qt::Uninitialized);
                 qint64 readBytes = reply->read(buf.data(), 2048);
@@ -542,6 +806,15 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
                 data(buf);
             }
         });
+    } else if (dataMode == Callback) {
+        QObject::connect(reply, &QNetworkReply::readyRead, reply, [reply, &dataCallback] {
+            const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const QByteArray buf = reply->readAll();
+            // Error pages and redirections aren't what the callback is waiting for
+            if (statusCode >= 200 && statusCode < 300) {
+                dataCallback(buf);
+            }
+        });
     }
 
     QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
@@ -551,16 +824,37 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     });
     loop.exec();
 
+    disconnect(authConnection);
+    disconnect(proxyAuthConnection);
+    if (!reply->isFinished()) {
+        // Interrupted by errorOut(): don't leave the reply running on the shared manager
+        reply->abort();
+    }
+    if (credentialsGiven) {
+        if (!authenticated) {
+            // Only found out now that the server wants credentials: drop what the reply
+            // may have put into the cache, and don't cache the next ones
+            m_authenticatedServers.insert(m_namKey);
+            if (QAbstractNetworkCache *cache = nam->cache()) {
+                cache->remove(request.url());
+            }
+        }
+    }
+
     // If there was a foo -> foo/ redirect, follow it.
-    if (redirectToTrailingSlash) {
+    if (redirectToTrailingSlash && (!inputData || !inputData->isSequential())) {
+        QUrl newUrl = url;
+        newUrl.setPath(newUrl.path() + QLatin1Char('/'));
         if (inputData) {
             inputData->rollbackTransaction();
         }
-        QUrl newUrl = url;
-        newUrl.setPath(newUrl.path() + QLatin1Char('/'));
-        return makeRequest(newUrl, method, inputData, dataMode, extraHeaders);
-    }
-    if (inputData) {
+        // Still this request: the credentials the server accepted for it go along
+        QMap<QByteArray, QByteArray> headers = extraHeaders;
+        if (!basicCredentials.isEmpty() && reply->error() != QNetworkReply::AuthenticationRequiredError) {
+            headers.insert("Authorization", basicCredentials);
+        }
+        return makeRequest(newUrl, method, inputData, dataMode, headers, dataCallback);
+    } else if (inputData && !inputData->isSequential()) {
         inputData->commitTransaction();
     }
 
@@ -573,10 +867,26 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     });
 
     if (reply->error() == QNetworkReply::AuthenticationRequiredError) {
-        reply->deleteLater();
         return {0, QByteArray(), KIO::ERR_ACCESS_DENIED};
     }
 
+    if (redirectToTrailingSlash) {
+        // The streamed data is gone, it can't be sent again to the new URL.
+        // Restarting the job with it would send an empty body.
+        qCWarning(KIOHTTP_LOG) << "Can't follow the redirection of" << url << "to a trailing slash after streaming the request body";
+        return {0, QByteArray(), KIO::ERR_CANNOT_WRITE};
+    }
+
+    if (jobData && jobData->sizeMismatch()) {
+        qCWarning(KIOHTTP_LOG) << "The data sent to" << url << "doesn't match the announced size";
+        return {0, QByteArray(), KIO::ERR_CANNOT_WRITE};
+    }
+
+    if (reply->error() == QNetworkReply::ContentNotFoundError && !reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid()) {
+        // "cache" was "cacheonly", and there was nothing in the cache
+        return {0, QByteArray(), KIO::ERR_DOES_NOT_EXIST};
+    }
+
     if (configValue(QStringLiteral("PropagateHttpHeader"), false)) {
         QStringList headers;
 
@@ -599,9 +909,7 @@ HTTPProtocol::Response HTTPProtocol::makeRequest(const QUrl &url,
     setMetaData(QStringLiteral("responsecode"), QString::number(statusCode));
     setMetaData(QStringLiteral("content-type"), readMimeType(reply));
 
-    reply->deleteLater();
-
-    return {statusCode, returnData};
+    return {statusCode, returnData, 0, reply->rawHeaderPairs()};
 }
 
 KIO::WorkerResult HTTPProtocol::get(const QUrl &url)
@@ -637,8 +945,17 @@ KIO::WorkerResult HTTPProtocol::put(const QUrl &url, int /*_mode*/, KIO::JobFlag
         }
     }
 
-    QByteArray inputData = getData();
-    Response response = makeRequest(url, KIO::HTTP_PUT, inputData, DataMode::Emit);
+    QMap<QByteArray, QByteArray> headers;
+
+    // Set by file_copy when it knows the size of the source. That's what the source
+    // had when stat'ed, the device checks that the job sends exactly that much.
+    const QString size = metaData(QStringLiteral("size"));
+    if (!size.isEmpty()) {
+        headers.insert("Content-Length", size.toLatin1());
+    }
+
+    JobDataDevice inputData(this, size.isEmpty() ? -1 : size.toLongLong());
+    Response response = makeRequest(url, KIO::HTTP_PUT, &inputData, DataMode::Emit, headers);
 
     return sendHttpError(url, KIO::HTTP_PUT, response);
 }
@@ -651,10 +968,15 @@ KIO::WorkerResult HTTPProtocol::mimetype(const QUrl &url)
     return sendHttpError(url, KIO::HTTP_HEAD, response);
 }
 
-KIO::WorkerResult HTTPProtocol::post(const QUrl &url, qint64 /*size*/)
+KIO::WorkerResult HTTPProtocol::post(const QUrl &url, qint64 size)
 {
-    QByteArray inputData = getData();
-    Response response = makeRequest(url, KIO::HTTP_POST, inputData, DataMode::Emit);
+    QMap<QByteArray, QByteArray> headers;
+    if (size >= 0) {
+        headers.insert("Content-Length", QByteArray::number(size));
+    }
+
+    JobDataDevice inputData(this, size >= 0 ? size : -1);
+    Response response = makeRequest(url, KIO::HTTP_POST, &inputData, DataMode::Emit, headers);
 
     return sendHttpError(url, KIO::HTTP_POST, response);
 }
@@ -685,7 +1007,7 @@ KIO::WorkerResult HTTPProtocol::special(const QByteArray &data)
 
 QByteArray HTTPProtocol::getData()
 {
-    // TODO this is probably not great. Instead create a QIODevice that calls readData and pass that to QNAM?
+    // Only meant for small request bodies, put() and post() stream theirs using JobDataDevice
     QByteArray dataBuffer;
 
     while (true) {
@@ -722,10 +1044,6 @@ KIO::WorkerResult HTTPProtocol::listDir(const QUrl &url)
 
 KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
 {
-    KIO::UDSEntry entry;
-
-    QMimeDatabase db;
-
     KIO::HTTP_METHOD method;
     QByteArray inputData;
 
@@ -762,77 +1080,128 @@ KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
         method = KIO::DAV_PROPFIND;
     }
 
-    const QMap<QByteArray, QByteArray> extraHeaders = {
+    QMap<QByteArray, QByteArray> extraHeaders = {
         {"Depth", stat ? "0" : "1"},
     };
 
-    Response response = makeDavRequest(url, method, inputData, DataMode::Return, extraHeaders);
-
-    // Has a redirection already been called? If so, we're done.
-    // if (m_isRedirection || m_kioError) {
-    // if (m_isRedirection) {
-    // return davFinished();
-    // }
-    // return WorkerResult::pass();
-    // }
-
-    QDomDocument multiResponse;
-    multiResponse.setContent(response.data, QDomDocument::ParseOption::UseNamespaceProcessing);
+    // Optionally ask for huge collections in pages, with the X-NC-Paginate headers
+    // understood by Nextcloud. Other servers ignore them and send everything at once.
+    const int pageSize = stat ? 0 : metaData(QStringLiteral("davPageSize")).toInt();
+    if (pageSize > 0) {
+        extraHeaders.insert("X-NC-Paginate", "true");
+        extraHeaders.insert("X-NC-Paginate-Count", QByteArray::number(pageSize));
+    }
 
     bool hasResponse = false;
-
-    for (QDomNode n = multiResponse.documentElement().firstChild(); !n.isNull(); n = n.nextSibling()) {
-        QDomElement thisResponse = n.toElement();
-        if (thisResponse.isNull()) {
-            continue;
-        }
-
-        hasResponse = true;
-
-        QDomElement href = thisResponse.namedItem(QStringLiteral("href")).toElement();
-        if (!href.isNull()) {
-            entry.clear();
-
-            const QUrl thisURL(href.text()); // href.text() is a percent-encoded url.
-            if (thisURL.isValid()) {
-                const QUrl adjustedThisURL = thisURL.adjusted(QUrl::StripTrailingSlash);
-                const QUrl adjustedUrl = url.adjusted(QUrl::StripTrailingSlash);
-
-                // base dir of a listDir(): name should be "."
-                QString name;
-                if (!stat && adjustedThisURL.path() == adjustedUrl.path()) {
-                    name = QLatin1Char('.');
+    bool hasBaseDir = false;
+    bool done = false;
+
+    // Parse the multistatus response as it comes in, building a DOM only for the
+    // <D:response> element being read, which gets handled as soon as it is complete
+    QXmlStreamReader reader;
+    QDomDocument responseDoc;
+    QList<QDomElement> openElements;
+
+    const auto parse = [&](const QByteArray &chunk) {
+        reader.addData(chunk);
+        while (!done && !reader.atEnd()) {
+            switch (reader.readNext()) {
+            case QXmlStreamReader::StartElement: {
+                if (openElements.isEmpty()) {
+                    if (reader.name() != QLatin1String("response") || reader.namespaceUri() != QLatin1String("DAV:")) {
+                        break;
+                    }
+                    responseDoc = QDomDocument();
+                }
+                QDomElement element = responseDoc.createElementNS(reader.namespaceUri().toString(), reader.qualifiedName().toString());
+                const QXmlStreamAttributes attributes = reader.attributes();
+                for (const QXmlStreamAttribute &attribute : attributes) {
+                    if (attribute.namespaceUri().isEmpty()) {
+                        element.setAttribute(attribute.name().toString(), attribute.value().toString());
+                    } else {
+                        element.setAttributeNS(attribute.namespaceUri().toString(), attribute.qualifiedName().toString(), attribute.value().toString());
+                    }
+                }
+                if (openElements.isEmpty()) {
+                    responseDoc.appendChild(element);
                 } else {
-                    name = adjustedThisURL.fileName();
+                    openElements.last().appendChild(element);
                 }
-
-                entry.fastInsert(KIO::UDSEntry::UDS_NAME, name.isEmpty() ? href.text() : name);
+                openElements.append(element);
+                break;
             }
-
-            QDomNodeList propstats = thisResponse.elementsByTagName(QStringLiteral("propstat"));
-
-            davParsePropstats(propstats, entry);
-
-            // Since a lot of webdav servers seem not to send the content-type information
-            // for the requested directory listings, we attempt to guess the MIME type from
-            // the resource name so long as the resource is not a directory.
-            if (entry.stringValue(KIO::UDSEntry::UDS_MIME_TYPE).isEmpty() && entry.numberValue(KIO::UDSEntry::UDS_FILE_TYPE) != S_IFDIR) {
-                QMimeType mime = db.mimeTypeForFile(thisURL.path(), QMimeDatabase::MatchExtension);
-                if (mime.isValid() && !mime.isDefault()) {
-                    // qCDebug(KIO_HTTP) << "Setting" << mime.name() << "as guessed MIME type for" << thisURL.path();
-                    entry.fastInsert(KIO::UDSEntry::UDS_GUESSED_MIME_TYPE, mime.name());
+            case QXmlStreamReader::EndElement:
+                if (openElements.isEmpty()) {
+                    break;
                 }
+                if (openElements.size() == 1) {
+                    const QDomElement thisResponse = openElements.takeLast();
+                    hasResponse = true;
+
+                    KIO::UDSEntry entry;
+                    davParseResponse(thisResponse, url, stat, entry);
+                    if (entry.count() == 0) {
+                        break;
+                    }
+                    if (stat) {
+                        // return an item
+                        statEntry(entry);
+                        done = true;
+                        break;
+                    }
+                    if (entry.stringValue(KIO::UDSEntry::UDS_NAME) == QLatin1Char('.')) {
+                        // The base dir may come again with every page
+                        if (hasBaseDir) {
+                            break;
+                        }
+                        hasBaseDir = true;
+                    }
+                    listEntry(entry);
+                } else {
+                    openElements.removeLast();
+                }
+                break;
+            case QXmlStreamReader::Characters:
+                if (!openElements.isEmpty() && !reader.isWhitespace()) {
+                    openElements.last().appendChild(responseDoc.createTextNode(reader.text().toString()));
+                }
+                break;
+            default:
+                break;
             }
+        }
+    };
+
+    qint64 offset = 0;
+    while (true) {
+        Response response = makeDavRequest(url, method, inputData, DataMode::Callback, extraHeaders, parse);
+        if (done) {
+            return KIO::WorkerResult::pass();
+        }
+        if (reader.hasError() && reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+            qCWarning(KIOHTTP_LOG) << "Failed to parse the response to PROPFIND on" << url << reader.errorString();
+        }
 
-            if (stat) {
-                // return an item
-                statEntry(entry);
-                return KIO::WorkerResult::pass();
+        QByteArray paginateToken;
+        qint64 paginateTotal = 0;
+        for (const auto &[key, value] : std::as_const(response.headers)) {
+            if (key.compare("X-NC-Paginate-Token", Qt::CaseInsensitive) == 0) {
+                paginateToken = value;
+            } else if (key.compare("X-NC-Paginate-Total", Qt::CaseInsensitive) == 0) {
+                paginateTotal = value.toLongLong();
             }
-            listEntry(entry);
-        } else {
-            // qCDebug(KIO_HTTP) << "Error: no URL contained in response to PROPFIND on" << url;
         }
+
+        offset += pageSize;
+        if (pageSize <= 0 || paginateToken.isEmpty() || offset >= paginateTotal) {
+            break;
+        }
+
+        // Next page, with a fresh parser: each page is a document of its own
+        extraHeaders.insert("X-NC-Paginate-Token", paginateToken);
+        extraHeaders.insert("X-NC-Paginate-Offset", QByteArray::number(offset));
+        reader.clear();
+        openElements.clear();
     }
 
     if (stat || !hasResponse) {
@@ -842,6 +1211,46 @@ KIO::WorkerResult HTTPProtocol::davStatList(const QUrl &url, bool stat)
     return KIO::WorkerResult::pass();
 }
 
+void HTTPProtocol::davParseResponse(const QDomElement &thisResponse, const QUrl &url, bool stat, KIO::UDSEntry &entry)
+{
+    QDomElement href = thisResponse.namedItem(QStringLiteral("href")).toElement();
+    if (href.isNull()) {
+        // qCDebug(KIO_HTTP) << "Error: no URL contained in response to PROPFIND on" << url;
+        return;
+    }
+
+    const QUrl thisURL(href.text()); // href.text() is a percent-encoded url.
+    if (thisURL.isValid()) {
+        const QUrl adjustedThisURL = thisURL.adjusted(QUrl::StripTrailingSlash);
+        const QUrl adjustedUrl = url.adjusted(QUrl::StripTrailingSlash);
+
+        // base dir of a listDir(): name should be "."
+        QString name;
+        if (!stat && adjustedThisURL.path() == adjustedUrl.path()) {
+            name = QLatin1Char('.');
+        } else {
+            name = adjustedThisURL.fileName();
+        }
+
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, name.isEmpty() ? href.text() : name);
+    }
+
+    QDomNodeList propstats = thisResponse.elementsByTagName(QStringLiteral("propstat"));
+
+    davParsePropstats(propstats, entry);
+
+    // Since a lot of webdav servers seem not to send the content-type information
+    // for the requested directory listings, we attempt to guess the MIME type from
+    // the resource name so long as the resource is not a directory.
+    if (entry.stringValue(KIO::UDSEntry::UDS_MIME_TYPE).isEmpty() && entry.numberValue(KIO::UDSEntry::UDS_FILE_TYPE) != S_IFDIR) {
+        QMimeType mime = m_mimeDatabase.mimeTypeForFile(thisURL.path(), QMimeDatabase::MatchExtension);
+        if (mime.isValid() && !mime.isDefault()) {
+            // qCDebug(KIO_HTTP) << "Setting" << mime.name() << "as guessed MIME type for" << thisURL.path();
+            entry.fastInsert(KIO::UDSEntry::UDS_GUESSED_MIME_TYPE, mime.name());
+        }
+    }
+}
+
 void HTTPProtocol::davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntry &entry)
 {
     QString mimeType;
@@ -1627,7 +2036,7 @@ KIO::WorkerResult HTTPProtocol::sendHttpError(const QUrl &url, KIO::HTTP_METHOD
     QString errorString;
     int errorCode = 0;
 
-    if (response.kioCode == KIO::ERR_ACCESS_DENIED) {
+    if (response.kioCode == KIO::ERR_ACCESS_DENIED || response.kioCode == KIO::ERR_DOES_NOT_EXIST || response.kioCode == KIO::ERR_CANNOT_WRITE) {
         return KIO::WorkerResult::fail(response.kioCode, url.toDisplayString());
     }
 
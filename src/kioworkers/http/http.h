@@ -17,11 +17,18 @@
 
 #include <KIO/WorkerBase>
 
+#include <QMimeDatabase>
+#include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QSet>
 #include <QSslError>
 
+#include <functional>
+#include <memory>
+
 #include "httpmethod_p.h"
 
+class QDomElement;
 class QDomNodeList;
 
 class HTTPProtocol : public QObject, public KIO::WorkerBase
@@ -42,6 +49,7 @@ public:
     KIO::WorkerResult copy(const QUrl &src, const QUrl &dest, int, KIO::JobFlags flags) override;
     KIO::WorkerResult del(const QUrl &url, bool _isfile) override;
     KIO::WorkerResult fileSystemFreeSpace(const QUrl &url) override;
+    void closeConnection() override;
 
 Q_SIGNALS:
     void errorOut(KIO::Error error);
@@ -54,12 +62,17 @@ private:
         Return,
         // discard any response data
         Discard,
+        // pass the data of a successful response to a DataCallback as it is received
+        Callback,
     };
 
+    using DataCallback = std::function<void(const QByteArray &)>;
+
     struct Response {
         int httpCode;
         QByteArray data;
         int kioCode = 0;
+        QList<QNetworkReply::RawHeaderPair> headers;
     };
 
     /**
@@ -70,6 +83,7 @@ private:
     void handleSslErrors(QNetworkReply *reply, const QList<QSslError> errors);
 
     [[nodiscard]] KIO::WorkerResult davStatList(const QUrl &url, bool stat);
+    void davParseResponse(const QDomElement &response, const QUrl &url, bool stat, KIO::UDSEntry &entry);
     void davParsePropstats(const QDomNodeList &propstats, KIO::UDSEntry &entry);
     QDateTime parseDateTime(const QString &input, const QString &type);
     void davParseActiveLocks(const QDomNodeList &activeLocks, uint &lockCount);
@@ -80,14 +94,32 @@ private:
 
     void setSslMetaData();
 
-    [[nodiscard]] KIO::WorkerResult post(const QUrl &url, qint64 size);
-    [[nodiscard]] Response
-    makeRequest(const QUrl &url, KIO::HTTP_METHOD method, QIODevice *inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
+    /**
+     * Returns the network access manager to use for a request to @p url.
+     * It is kept across requests to the same server, to reuse its connections.
+     */
+    QNetworkAccessManager *networkAccessManager(const QUrl &url);
 
-    [[nodiscard]] Response
-    makeDavRequest(const QUrl &url, KIO::HTTP_METHOD, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
-    [[nodiscard]] Response
-    makeRequest(const QUrl &url, KIO::HTTP_METHOD, QByteArray &inputData, DataMode dataMode, const QMap<QByteArray, QByteArray> &extraHeaders = {});
+    [[nodiscard]] KIO::WorkerResult post(const QUrl &url, qint64 size);
+    [[nodiscard]] Response makeRequest(const QUrl &url,
+                                       KIO::HTTP_METHOD method,
+                                       QIODevice *inputData,
+                                       DataMode dataMode,
+                                       const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                                       const DataCallback &dataCallback = {});
+
+    [[nodiscard]] Response makeDavRequest(const QUrl &url,
+                                          KIO::HTTP_METHOD,
+                                          QByteArray &inputData,
+                                          DataMode dataMode,
+                                          const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                                          const DataCallback &dataCallback = {});
+    [[nodiscard]] Response makeRequest(const QUrl &url,
+                                       KIO::HTTP_METHOD,
+                                       QByteArray &inputData,
+                                       DataMode dataMode,
+                                       const QMap<QByteArray, QByteArray> &extraHeaders = {},
+                                       const DataCallback &dataCallback = {});
 
     [[nodiscard]] KIO::WorkerResult davError(KIO::HTTP_METHOD method, const QUrl &url, const Response &response);
     [[nodiscard]] KIO::WorkerResult davError(QString &errorMsg, KIO::HTTP_METHOD method, int code, const QUrl &_url, const QByteArray &responseData);
@@ -116,6 +148,11 @@ private:
     KIO::Error lastError = (KIO::Error)KJob::NoError;
     QString m_hostName;
     QString m_defaultUserAgent;
+    QMimeDatabase m_mimeDatabase;
+    std::unique_ptr<QNetworkAccessManager> m_nam;
+    QString m_namKey;
+    // The servers (as in m_namKey) that asked for credentials, their responses aren't cached
+    QSet<QString> m_authenticatedServers;
 };
 
 #endif
@@ -0,0 +1,155 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "httpcache.h"
+#include "debug.h"
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#include <algorithm>
+
+// Per-entry overhead QNetworkDiskCache accounts for besides the data
+static constexpr qint64 s_entryOverhead = 1024;
+
+struct EvictionScan {
+    // The oldest entries first
+    QStringList filesToRemove;
+    // The size of the cache once they're removed
+    qint64 sizeAfter = 0;
+};
+
+// Finds the oldest entries of the cache in @p directory to remove for it to get under @p targetSize,
+// if it's over @p maximumSize. Only reads the directory, runs on the eviction thread.
+static EvictionScan scanForEviction(const QString &directory, qint64 maximumSize, qint64 targetSize)
+{
+    struct CacheFile {
+        QString path;
+        qint64 size;
+        QDateTime time;
+    };
+
+    QList<CacheFile> cacheFiles;
+    qint64 totalSize = 0;
+    // QNetworkDiskCache keeps its entries as "*.d" files in subdirectories of "data*";
+    // entries being written live in "prepared" and are left alone
+    QDirIterator it(directory, {QStringLiteral("*.d")}, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo info = it.nextFileInfo();
+        if (info.path().endsWith(QLatin1String("/prepared"))) {
+            continue;
+        }
+        cacheFiles.append({info.filePath(), info.size(), info.lastModified()});
+        totalSize += info.size() + s_entryOverhead;
+    }
+
+    EvictionScan scan;
+    if (totalSize > maximumSize) {
+        std::sort(cacheFiles.begin(), cacheFiles.end(), [](const CacheFile &a, const CacheFile &b) {
+            return a.time < b.time;
+        });
+        for (const CacheFile &file : std::as_const(cacheFiles)) {
+            if (totalSize <= targetSize) {
+                break;
+            }
+            scan.filesToRemove.append(file.path);
+            totalSize -= file.size + s_entryOverhead;
+        }
+    }
+    scan.sizeAfter = totalSize;
+    return scan;
+}
+
+HttpDiskCache::HttpDiskCache(const QString &directory, qint64 maximumSize)
+{
+    setCacheDirectory(directory);
+    setMaximumCacheSize(maximumSize);
+}
+
+HttpDiskCache::~HttpDiskCache()
+{
+    if (m_evictionThread) {
+        m_evictionThread->wait();
+    }
+}
+
+QIODevice *HttpDiskCache::prepare(const QNetworkCacheMetaData &metaData)
+{
+    const QNetworkCacheMetaData::RawHeaderList headers = metaData.rawHeaders();
+    for (const auto &[name, value] : headers) {
+        if (name.compare("Vary", Qt::CaseInsensitive) == 0 && value.trimmed().compare("Accept-Encoding", Qt::CaseInsensitive) != 0) {
+            return nullptr;
+        }
+    }
+    return QNetworkDiskCache::prepare(metaData);
+}
+
+void HttpDiskCache::insert(QIODevice *device)
+{
+    const qint64 entrySize = device->size() + s_entryOverhead;
+    if (m_estimatedSize >= 0) {
+        m_estimatedSize += entrySize;
+    }
+    if (m_evicting) {
+        m_insertedDuringEviction += entrySize;
+    }
+    QNetworkDiskCache::insert(device);
+}
+
+qint64 HttpDiskCache::expire()
+{
+    // Called by QNetworkDiskCache after every insertion
+    if (m_estimatedSize < 0 || m_estimatedSize > maximumCacheSize()) {
+        startEviction();
+    }
+    return std::max<qint64>(m_estimatedSize, 0);
+}
+
+void HttpDiskCache::startEviction()
+{
+    if (m_evicting) {
+        return;
+    }
+    if (m_evictionThread) {
+        m_evictionThread->wait(); // only the queued finishEviction() call was left
+    }
+    m_evicting = true;
+    m_insertedDuringEviction = 0;
+
+    // Trim to 90% of the maximum size, so that this doesn't happen again with the next insertion
+    const QString directory = cacheDirectory();
+    const qint64 maximumSize = maximumCacheSize();
+    m_evictionThread.reset(QThread::create([this, directory, maximumSize]() {
+        const EvictionScan scan = scanForEviction(directory, maximumSize, maximumSize * 9 / 10);
+        QMetaObject::invokeMethod(
+            this,
+            [this, scan]() {
+                finishEviction(scan.filesToRemove, scan.sizeAfter);
+            },
+            Qt::QueuedConnection);
+    }));
+    m_evictionThread->start(QThread::LowPriority);
+}
+
+void HttpDiskCache::finishEviction(const QStringList &filesToRemove, qint64 sizeAfter)
+{
+    // Through QNetworkDiskCache, which keeps track of its entries and of its size
+    int removed = 0;
+    for (const QString &path : filesToRemove) {
+        // Another kio_http may have removed it already
+        const QUrl url = fileMetaData(path).url();
+        if (url.isValid() && remove(url)) {
+            ++removed;
+        }
+    }
+
+    m_estimatedSize = sizeAfter + m_insertedDuringEviction;
+    m_evicting = false;
+    qCDebug(KIOHTTP_LOG) << "Removed" << removed << "entries from the cache, now about" << m_estimatedSize << "bytes";
+}
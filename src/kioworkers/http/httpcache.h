@@ -0,0 +1,57 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+#include <QNetworkDiskCache>
+
+#include <memory>
+
+class QThread;
+
+/**
+ * The on-disk cache of kio_http, shared by all its instances.
+ *
+ * QNetworkDiskCache takes care of storing the responses along with their
+ * validators, and of the conditional requests to revalidate them. Trimming the
+ * cache however walks the whole cache directory: finding the entries to remove
+ * is done on a thread of its own here, instead of blocking the request that
+ * happened to fill the cache. They are then removed through QNetworkDiskCache,
+ * in the thread of the cache.
+ *
+ * Entries are keyed by URL only, so responses that vary on request headers
+ * (other than Accept-Encoding, which QNAM handles itself) aren't stored.
+ */
+class HttpDiskCache : public QNetworkDiskCache
+{
+public:
+    /**
+     * @param directory the cache directory
+     * @param maximumSize the size in bytes over which the oldest entries get removed
+     */
+    HttpDiskCache(const QString &directory, qint64 maximumSize);
+    ~HttpDiskCache() override;
+
+    QIODevice *prepare(const QNetworkCacheMetaData &metaData) override;
+    void insert(QIODevice *device) override;
+
+protected:
+    qint64 expire() override;
+
+private:
+    void startEviction();
+    void finishEviction(const QStringList &filesToRemove, qint64 sizeAfter);
+
+    std::unique_ptr<QThread> m_evictionThread;
+    bool m_evicting = false;
+    // Size of the cache as of the last eviction plus what was inserted since, -1 if unknown yet
+    qint64 m_estimatedSize = -1;
+    // What was inserted while the eviction thread was walking the cache
+    qint64 m_insertedDuringEviction = 0;
+};
+
+#endif
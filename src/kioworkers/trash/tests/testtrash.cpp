@@ -10,6 +10,7 @@
 #include <QTest>
 
 #include "../../../utils_p.h"
+#include "discspaceutil.h"
 #include "filecopyjob.h"
 #include "kio_trash.h"
 
@@ -35,6 +36,8 @@
 #include <QTemporaryFile>
 #include <QUrl>
 
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // There are two ways to test encoding things:
@@ -1271,6 +1274,71 @@ void TestTrash::listRecursiveRootDir()
     QCOMPARE(m_displayNameListResult.count(QStringLiteral("subDirBrokenSymlink/link")), 1);
 }
 
+void TestTrash::listRootDirAfterExternalChange()
+{
+    // Another program trashes a file, behind the back of the index
+    const QString fileName = QStringLiteral("externallyTrashedFile");
+    const QString filePath = m_trashDir + QLatin1String("/files/") + fileName;
+    const QString infoPath = m_trashDir + QLatin1String("/info/") + fileName + QLatin1String(".trashinfo");
+    createTestFile(filePath);
+    QFile infoFile(infoPath);
+    QVERIFY(infoFile.open(QIODevice::WriteOnly));
+    infoFile.write("[Trash Info]\nPath=" + QUrl::toPercentEncoding(homeTmpDir() + fileName, "/") + "\nDeletionDate=2026-01-01T12:00:00\n");
+    infoFile.close();
+
+    m_displayNameListResult.clear();
+    KIO::ListJob *job = KIO::listDir(QUrl(QStringLiteral("trash:/")), KIO::HideProgressInfo);
+    connect(job, &KIO::ListJob::entries, this, &TestTrash::slotEntries);
+    QVERIFY(job->exec());
+    QCOMPARE(m_displayNameListResult.count(fileName), 1);
+    QCOMPARE(m_displayNameListResult.count(QStringLiteral("fileFromHome")), 1);
+
+    // ... and removes it again
+    QVERIFY(QFile::remove(infoPath));
+    QVERIFY(QFile::remove(filePath));
+
+    m_displayNameListResult.clear();
+    job = KIO::listDir(QUrl(QStringLiteral("trash:/")), KIO::HideProgressInfo);
+    connect(job, &KIO::ListJob::entries, this, &TestTrash::slotEntries);
+    QVERIFY(job->exec());
+    QCOMPARE(m_displayNameListResult.count(fileName), 0);
+    QCOMPARE(m_displayNameListResult.count(QStringLiteral("fileFromHome")), 1);
+}
+
+void TestTrash::listRootDirAfterExternalChangeKeepingTime()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("Restores the time of the info dir with utimensat");
+#else
+    // Another program trashes a file within the resolution of the time of the info dir
+    const QByteArray infoDir = QFile::encodeName(m_trashDir + QLatin1String("/info"));
+    struct stat buff;
+    QCOMPARE(::stat(infoDir.constData(), &buff), 0);
+
+    const QString fileName = QStringLiteral("externallyTrashedFileKeepingTime");
+    const QString filePath = m_trashDir + QLatin1String("/files/") + fileName;
+    const QString infoPath = m_trashDir + QLatin1String("/info/") + fileName + QLatin1String(".trashinfo");
+    createTestFile(filePath);
+    QFile infoFile(infoPath);
+    QVERIFY(infoFile.open(QIODevice::WriteOnly));
+    infoFile.write("[Trash Info]\nPath=" + QUrl::toPercentEncoding(homeTmpDir() + fileName, "/") + "\nDeletionDate=2026-01-01T12:00:00\n");
+    infoFile.close();
+
+    const struct timespec times[2] = {{0, UTIME_OMIT}, buff.st_mtim};
+    QCOMPARE(::utimensat(AT_FDCWD, infoDir.constData(), times, 0), 0);
+
+    // The number of .trashinfo files tells the index is out of date
+    m_displayNameListResult.clear();
+    KIO::ListJob *job = KIO::listDir(QUrl(QStringLiteral("trash:/")), KIO::HideProgressInfo);
+    connect(job, &KIO::ListJob::entries, this, &TestTrash::slotEntries);
+    QVERIFY(job->exec());
+    QCOMPARE(m_displayNameListResult.count(fileName), 1);
+
+    QVERIFY(QFile::remove(infoPath));
+    QVERIFY(QFile::remove(filePath));
+#endif
+}
+
 void TestTrash::listSubDir()
 {
     m_entryCount = 0;
@@ -1361,6 +1429,217 @@ void TestTrash::testEmptyTrashSize()
     }
 }
 
+static void createTestFile(const QString &path, int size)
+{
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    QCOMPARE(f.write(QByteArray(size, 'x')), size);
+}
+
+// Sets the limits of the home trash like its settings page does
+static void setTrashLimits(const QString &trashDir, qint64 maxSize, int limitReachedAction, int maxDays = 0)
+{
+    KConfig config(QStringLiteral("ktrashrc"));
+    KConfigGroup group = config.group(trashDir);
+    group.writeEntry("UseSizeLimit", maxSize > 0);
+    if (maxSize > 0) {
+        const DiscSpaceUtil util(trashDir + QLatin1String("/files/"));
+        group.writeEntry("Percent", maxSize * 100.0 / util.size());
+    }
+    group.writeEntry("LimitReachedAction", limitReachedAction);
+    group.writeEntry("UseTimeLimit", maxDays > 0);
+    group.writeEntry("Days", maxDays);
+    config.sync();
+}
+
+static void resetTrashLimits(const QString &trashDir)
+{
+    KConfig config(QStringLiteral("ktrashrc"));
+    config.deleteGroup(trashDir);
+    config.sync();
+}
+
+// Trashes @p origPath like kio_trash does, returns the file id, or an empty string on failure
+QString TestTrash::trashWithLimits(TrashImpl &impl, const QString &origPath)
+{
+    int trashId;
+    QString fileId;
+    if (!impl.createInfo(origPath, trashId, fileId)) {
+        return QString();
+    }
+    if (!impl.moveToTrash(origPath, trashId, fileId)) {
+        impl.deleteInfo(trashId, fileId);
+        return QString();
+    }
+    return fileId;
+}
+
+void TestTrash::setDeletionDate(const QString &fileId, const QDateTime &date) const
+{
+    KConfig info(m_trashDir + QLatin1String("/info/") + fileId + QLatin1String(".trashinfo"), KConfig::SimpleConfig);
+    info.group(QStringLiteral("Trash Info")).writeEntry("DeletionDate", date.toString(Qt::ISODate));
+    info.sync();
+}
+
+void TestTrash::trashSizeLimitRemovesOldestFirst()
+{
+    removeDirRecursive(m_trashDir);
+    TrashImpl impl;
+    QVERIFY(impl.init());
+    setTrashLimits(m_trashDir, 100000, 0);
+
+    QStringList fileIds;
+    for (const QString &name : {QStringLiteral("oldest"), QStringLiteral("older"), QStringLiteral("newest")}) {
+        createTestFile(homeTmpDir() + name, 1000);
+        fileIds.append(trashWithLimits(impl, homeTmpDir() + name));
+        QCOMPARE(fileIds.last(), name);
+    }
+    setDeletionDate(QStringLiteral("oldest"), QDateTime(QDate(2001, 1, 1), QTime(0, 0)));
+    setDeletionDate(QStringLiteral("older"), QDateTime(QDate(2002, 1, 1), QTime(0, 0)));
+
+    // Room for three and a half of them: the oldest one has to go
+    setTrashLimits(m_trashDir, 3500, 1);
+    createTestFile(homeTmpDir() + QLatin1String("new"), 1000);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("new")), QStringLiteral("new"));
+
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/files/oldest")));
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/info/oldest.trashinfo")));
+    for (const QString &name : {QStringLiteral("older"), QStringLiteral("newest"), QStringLiteral("new")}) {
+        QVERIFY2(QFile::exists(m_trashDir + QLatin1String("/files/") + name), qPrintable(name));
+        QVERIFY2(QFile::exists(m_trashDir + QLatin1String("/info/") + name + QLatin1String(".trashinfo")), qPrintable(name));
+    }
+    QVERIFY(!QFile::exists(homeTmpDir() + QLatin1String("new")));
+
+    resetTrashLimits(m_trashDir);
+    removeDirRecursive(m_trashDir);
+}
+
+void TestTrash::trashSizeLimitRemovesBiggestFirst()
+{
+    removeDirRecursive(m_trashDir);
+    TrashImpl impl;
+    QVERIFY(impl.init());
+    setTrashLimits(m_trashDir, 100000, 0);
+
+    const QList<std::pair<QString, int>> items{{QStringLiteral("medium"), 2000}, {QStringLiteral("biggest"), 3000}, {QStringLiteral("small"), 1000}};
+    for (const auto &[name, size] : items) {
+        createTestFile(homeTmpDir() + name, size);
+        QCOMPARE(trashWithLimits(impl, homeTmpDir() + name), name);
+    }
+
+    // 7000 bytes for a limit of 6500: removing the biggest one is enough
+    setTrashLimits(m_trashDir, 6500, 2);
+    createTestFile(homeTmpDir() + QLatin1String("new"), 1000);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("new")), QStringLiteral("new"));
+
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/files/biggest")));
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/info/biggest.trashinfo")));
+    for (const QString &name : {QStringLiteral("medium"), QStringLiteral("small"), QStringLiteral("new")}) {
+        QVERIFY2(QFile::exists(m_trashDir + QLatin1String("/files/") + name), qPrintable(name));
+    }
+
+    resetTrashLimits(m_trashDir);
+    removeDirRecursive(m_trashDir);
+}
+
+void TestTrash::trashTooLargeForSizeLimit()
+{
+    removeDirRecursive(m_trashDir);
+    TrashImpl impl;
+    QVERIFY(impl.init());
+    setTrashLimits(m_trashDir, 100000, 0);
+    createTestFile(homeTmpDir() + QLatin1String("kept"), 1000);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("kept")), QStringLiteral("kept"));
+
+    // The item is moved into the trash before its size is known: it has to come back
+    setTrashLimits(m_trashDir, 3500, 1);
+    const QString origPath = homeTmpDir() + QLatin1String("tooLarge");
+    createTestFile(origPath, 5000);
+    int trashId;
+    QString fileId;
+    QVERIFY(impl.createInfo(origPath, trashId, fileId));
+    QVERIFY(!impl.moveToTrash(origPath, trashId, fileId));
+    QCOMPARE(impl.lastErrorCode(), int(KIO::ERR_TRASH_FILE_TOO_LARGE));
+    QVERIFY(impl.deleteInfo(trashId, fileId));
+
+    QCOMPARE(QFileInfo(origPath).size(), 5000);
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/files/tooLarge")));
+    // Nothing else was removed for it
+    QVERIFY(QFile::exists(m_trashDir + QLatin1String("/files/kept")));
+
+    QVERIFY(QFile::remove(origPath));
+    resetTrashLimits(m_trashDir);
+    removeDirRecursive(m_trashDir);
+}
+
+void TestTrash::trashSizeLimitWarnsAfterRename()
+{
+    removeDirRecursive(m_trashDir);
+    TrashImpl impl;
+    QVERIFY(impl.init());
+
+    // With the default settings, the item is sized once renamed into the trash
+    setTrashLimits(m_trashDir, 1500, 0);
+    createTestFile(homeTmpDir() + QLatin1String("fits"), 1000);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("fits")), QStringLiteral("fits"));
+    QCOMPARE(impl.lastSizedPath(), m_trashDir + QLatin1String("/files/fits"));
+    QVERIFY(!QFile::exists(homeTmpDir() + QLatin1String("fits")));
+
+    // The trash is full: the item is renamed back, with the warning
+    const QString origPath = homeTmpDir() + QLatin1String("full");
+    createTestFile(origPath, 1000);
+    int trashId;
+    QString fileId;
+    QVERIFY(impl.createInfo(origPath, trashId, fileId));
+    QVERIFY(!impl.moveToTrash(origPath, trashId, fileId));
+    QCOMPARE(impl.lastErrorCode(), int(KIO::ERR_WORKER_DEFINED));
+    QCOMPARE(impl.lastSizedPath(), m_trashDir + QLatin1String("/files/full"));
+    QVERIFY(impl.deleteInfo(trashId, fileId));
+
+    QCOMPARE(QFileInfo(origPath).size(), 1000);
+    QVERIFY(!QFile::exists(m_trashDir + QLatin1String("/files/full")));
+    // Nothing was removed for it
+    QVERIFY(QFile::exists(m_trashDir + QLatin1String("/files/fits")));
+
+    QVERIFY(QFile::remove(origPath));
+    resetTrashLimits(m_trashDir);
+    removeDirRecursive(m_trashDir);
+}
+
+void TestTrash::trashTimeLimit()
+{
+    removeDirRecursive(m_trashDir);
+    TrashImpl impl;
+    QVERIFY(impl.init());
+    resetTrashLimits(m_trashDir);
+
+    const QStringList expired{QStringLiteral("expired1"), QStringLiteral("expired2"), QStringLiteral("expired3")};
+    for (const QString &name : expired) {
+        createTestFile(homeTmpDir() + name, 10);
+        QCOMPARE(trashWithLimits(impl, homeTmpDir() + name), name);
+        setDeletionDate(name, QDateTime::currentDateTime().addDays(-30));
+    }
+    createTestFile(homeTmpDir() + QLatin1String("recent"), 10);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("recent")), QStringLiteral("recent"));
+    setDeletionDate(QStringLiteral("recent"), QDateTime::currentDateTime().addDays(-2));
+
+    // Trashing the next item removes all those older than a week at once
+    setTrashLimits(m_trashDir, 0, 0, 7);
+    createTestFile(homeTmpDir() + QLatin1String("new"), 10);
+    QCOMPARE(trashWithLimits(impl, homeTmpDir() + QLatin1String("new")), QStringLiteral("new"));
+
+    for (const QString &name : expired) {
+        QVERIFY2(!QFile::exists(m_trashDir + QLatin1String("/files/") + name), qPrintable(name));
+        QVERIFY2(!QFile::exists(m_trashDir + QLatin1String("/info/") + name + QLatin1String(".trashinfo")), qPrintable(name));
+    }
+    QVERIFY(QFile::exists(m_trashDir + QLatin1String("/files/recent")));
+    QVERIFY(QFile::exists(m_trashDir + QLatin1String("/files/new")));
+    QCOMPARE(QDir(m_trashDir + QLatin1String("/info")).entryList(QDir::Files).count(), 2);
+
+    resetTrashLimits(m_trashDir);
+    removeDirRecursive(m_trashDir);
+}
+
 static void checkIcon(const QUrl &url, const QString &expectedIcon)
 {
     QString icon = KIO::iconNameForUrl(url); // #100321
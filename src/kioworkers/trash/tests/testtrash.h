@@ -14,6 +14,8 @@
 
 #include <KIO/Job>
 
+class TrashImpl;
+
 class TestTrash : public QObject
 {
     Q_OBJECT
@@ -77,6 +79,8 @@ private Q_SLOTS:
 
     void listRootDir();
     void listRecursiveRootDir();
+    void listRootDirAfterExternalChange();
+    void listRootDirAfterExternalChangeKeepingTime();
     void mostLocalUrlTest();
     void listSubDir();
 
@@ -92,6 +96,12 @@ private Q_SLOTS:
     void emptyTrash();
     void testEmptyTrashSize();
 
+    void trashSizeLimitRemovesOldestFirst();
+    void trashSizeLimitRemovesBiggestFirst();
+    void trashTooLargeForSizeLimit();
+    void trashSizeLimitWarnsAfterRename();
+    void trashTimeLimit();
+
 protected Q_SLOTS:
     void slotEntries(KIO::Job *, const KIO::UDSEntryList &);
 
@@ -103,6 +113,8 @@ private:
     void moveInTrash(const QString &fileId, const QString &destFileId);
     void moveFromTrash(const QString &fileId, const QString &destPath, const QString &relativePath = QString());
     void checkDirCacheValidity();
+    QString trashWithLimits(TrashImpl &impl, const QString &origPath);
+    void setDeletionDate(const QString &fileId, const QDateTime &date) const;
 
     QString homeTmpDir() const;
     QString otherTmpDir() const;
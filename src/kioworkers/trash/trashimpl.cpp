@@ -8,6 +8,7 @@
 #include "trashimpl.h"
 #include "discspaceutil.h"
 #include "kiotrashdebug.h"
+#include "trashindex.h"
 #include "trashsizecache.h"
 
 #include "../utils_p.h"
@@ -37,9 +38,12 @@
 #include <QStandardPaths>
 #include <QUrl>
 
+#include <algorithm>
 #include <cerrno>
 #include <dirent.h>
 #include <fcntl.h>
+#include <functional>
+#include <future>
 #include <stdlib.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -269,6 +273,8 @@ bool TrashImpl::createInfo(const QString &origPath, int &trashId, QString &fileI
 #endif
     url.setPath(infoPath(trashId, origFileName)); // we first try with origFileName
     QUrl baseDirectory = QUrl::fromLocalFile(url.path());
+    TrashIndex index(trashDirectoryPath(trashId));
+    const qint64 infoDirMTime = index.infoDirModificationTime();
     // Here we need to use O_EXCL to avoid race conditions with other kioworker processes
     int fd = 0;
     QString fileName;
@@ -309,8 +315,12 @@ bool TrashImpl::createInfo(const QString &origPath, int &trashId, QString &fileI
     } else {
         info += QUrl::toPercentEncoding(makeRelativePath(topDirectoryPath(trashId), origPath), "/");
     }
+    TrashIndex::Entry indexEntry;
+    indexEntry.fileId = fileId;
+    indexEntry.path = info.mid(info.indexOf("Path=") + 5);
+    indexEntry.deletionDate = QDateTime::currentDateTime().toString(Qt::ISODate).toLatin1();
     info += '\n';
-    info += "DeletionDate=" + QDateTime::currentDateTime().toString(Qt::ISODate).toLatin1() + '\n';
+    info += "DeletionDate=" + indexEntry.deletionDate + '\n';
     size_t sz = info.size();
 
     size_t written = ::fwrite(info.data(), 1, sz, file);
@@ -322,6 +332,7 @@ bool TrashImpl::createInfo(const QString &origPath, int &trashId, QString &fileI
     }
 
     ::fclose(file);
+    index.add(indexEntry, infoDirMTime);
 
     // qCDebug(KIO_TRASH) << "info file created in trashId=" << trashId << ":" << fileId;
     return true;
@@ -373,7 +384,10 @@ bool TrashImpl::deleteInfo(int trashId, const QString &fileId)
     createTrashInfrastructure(trashId);
 #endif
 
+    TrashIndex index(trashDirectoryPath(trashId));
+    const qint64 infoDirMTime = index.infoDirModificationTime();
     if (QFile::remove(infoPath(trashId, fileId))) {
+        index.remove(fileId, infoDirMTime);
         fileRemoved();
         return true;
     }
@@ -384,29 +398,57 @@ bool TrashImpl::deleteInfo(int trashId, const QString &fileId)
 bool TrashImpl::moveToTrash(const QString &origPath, int trashId, const QString &fileId)
 {
     // qCDebug(KIO_TRASH) << "Trashing" << origPath << trashId << fileId;
-    if (!adaptTrashSize(origPath, trashId)) {
-        return false;
-    }
-
 #ifdef Q_OS_OSX
     createTrashInfrastructure(trashId);
 #endif
     const QString dest = filesPath(trashId, fileId);
-    if (!move(origPath, dest)) {
-        // Maybe the move failed due to no permissions to delete source.
-        // In that case, delete dest to keep things consistent, since KIO doesn't do it.
-        if (QFileInfo(dest).isFile()) {
-            QFile::remove(dest);
-        } else {
-            synchronousDel(dest, false, true);
+    qint64 pathSize = 0;
+
+    // Renaming the item into the trash is usually instant, unlike walking all of it for the size
+    // limit: enforce the limits once it's in the trash, and rename it back if it doesn't fit
+    if (directRename(origPath, dest)) {
+        if (!adaptTrashSize(dest, trashId, fileId, pathSize)) {
+            const int errorCode = m_lastErrorCode;
+            const QString errorMessage = m_lastErrorMessage;
+            if (directRename(dest, origPath)) {
+                error(errorCode, errorMessage);
+                return false;
+            }
+            // Better over the limit than lost
+            qCWarning(KIO_TRASH) << "Couldn't move" << dest << "back to" << origPath << "after exceeding the size limit of the trash";
+            pathSize = DiscSpaceUtil::sizeOfPath(dest);
+        }
+        // This notification is done by KIO::moveAs when using move()
+#ifdef WITH_QTDBUS
+        org::kde::KDirNotify::emitFilesAdded(QUrl::fromLocalFile(dest));
+#endif
+    } else {
+        if (m_lastErrorCode != KIO::ERR_UNSUPPORTED_ACTION) {
+            return false;
+        }
+        // On another device the item gets copied, better not for one too large for the trash
+        if (!adaptTrashSize(origPath, trashId, fileId, pathSize)) {
+            return false;
+        }
+        if (!move(origPath, dest)) {
+            // Maybe the move failed due to no permissions to delete source.
+            // In that case, delete dest to keep things consistent, since KIO doesn't do it.
+            if (QFileInfo(dest).isFile()) {
+                QFile::remove(dest);
+            } else {
+                synchronousDel(dest, false, true);
+            }
+            return false;
         }
-        return false;
     }
 
-    if (QFileInfo(dest).isDir()) {
-        TrashSizeCache trashSize(trashDirectoryPath(trashId));
-        const qint64 pathSize = DiscSpaceUtil::sizeOfPath(dest);
-        trashSize.add(fileId, pathSize);
+    // Without a size limit the size wasn't computed, it will be when needed
+    if (pathSize >= 0) {
+        if (QFileInfo(dest).isDir()) {
+            TrashSizeCache trashSize(trashDirectoryPath(trashId));
+            trashSize.add(fileId, pathSize);
+        }
+        TrashIndex(trashDirectoryPath(trashId)).setSize(fileId, pathSize);
     }
 
     fileAdded();
@@ -425,6 +467,10 @@ bool TrashImpl::moveFromTrash(const QString &dest, int trashId, const QString &f
 
     TrashSizeCache trashSize(trashDirectoryPath(trashId));
     trashSize.remove(fileId);
+    if (!relativePath.isEmpty()) {
+        // Only part of the trashed directory went away
+        TrashIndex(trashDirectoryPath(trashId)).setSize(fileId, -1);
+    }
 
     return true;
 }
@@ -466,7 +512,8 @@ void TrashImpl::jobFinished(KJob *job)
 bool TrashImpl::copyToTrash(const QString &origPath, int trashId, const QString &fileId)
 {
     // qCDebug(KIO_TRASH);
-    if (!adaptTrashSize(origPath, trashId)) {
+    qint64 pathSize = 0;
+    if (!adaptTrashSize(origPath, trashId, fileId, pathSize)) {
         return false;
     }
 
@@ -478,10 +525,13 @@ bool TrashImpl::copyToTrash(const QString &origPath, int trashId, const QString
         return false;
     }
 
-    if (QFileInfo(dest).isDir()) {
-        TrashSizeCache trashSize(trashDirectoryPath(trashId));
-        const qint64 pathSize = DiscSpaceUtil::sizeOfPath(dest);
-        trashSize.add(fileId, pathSize);
+    // Without a size limit the size wasn't computed, it will be when needed
+    if (pathSize >= 0) {
+        if (QFileInfo(dest).isDir()) {
+            TrashSizeCache trashSize(trashDirectoryPath(trashId));
+            trashSize.add(fileId, pathSize);
+        }
+        TrashIndex(trashDirectoryPath(trashId)).setSize(fileId, pathSize);
     }
 
     fileAdded();
@@ -545,9 +595,12 @@ bool TrashImpl::moveInTrash(int trashId, const QString &oldFileId, const QString
     const QString newInfo = infoPath(trashId, newFileId);
     const QString newFile = filesPath(trashId, newFileId);
 
+    TrashIndex index(trashDirectoryPath(trashId));
+    const qint64 infoDirMTime = index.infoDirModificationTime();
     if (directRename(oldInfo, newInfo)) {
         if (directRename(oldFile, newFile)) {
             // success
+            index.rename(oldFileId, newFileId, infoDirMTime);
 
             if (QFileInfo(newFile).isDir()) {
                 TrashSizeCache trashSize(trashDirectoryPath(trashId));
@@ -563,37 +616,58 @@ bool TrashImpl::moveInTrash(int trashId, const QString &oldFileId, const QString
 }
 
 bool TrashImpl::del(int trashId, const QString &fileId)
+{
+    return !deleteTrashedItems(trashId, {fileId}).isEmpty();
+}
+
+QStringList TrashImpl::deleteTrashedItems(int trashId, const QStringList &fileIds)
 {
 #ifdef Q_OS_OSX
     createTrashInfrastructure(trashId);
 #endif
 
-    const QString info = infoPath(trashId, fileId);
-    const QString file = filesPath(trashId, fileId);
+    TrashIndex index(trashDirectoryPath(trashId));
+    qint64 infoDirMTime = 0;
+    QStringList deleted;
+    QStringList deletedDirs;
+    for (const QString &fileId : fileIds) {
+        const QString info = infoPath(trashId, fileId);
+        const QString file = filesPath(trashId, fileId);
+
+        QT_STATBUF buff;
+        if (QT_LSTAT(QFile::encodeName(info).constData(), &buff) == -1) {
+            if (errno == EACCES) {
+                error(KIO::ERR_ACCESS_DENIED, file);
+            } else {
+                error(KIO::ERR_DOES_NOT_EXIST, file);
+            }
+            continue;
+        }
 
-    QT_STATBUF buff;
-    if (QT_LSTAT(QFile::encodeName(info).constData(), &buff) == -1) {
-        if (errno == EACCES) {
-            error(KIO::ERR_ACCESS_DENIED, file);
-        } else {
-            error(KIO::ERR_DOES_NOT_EXIST, file);
+        const bool isDir = QFileInfo(file).isDir();
+        if (!synchronousDel(file, true, isDir)) {
+            continue;
         }
-        return false;
-    }
 
-    const bool isDir = QFileInfo(file).isDir();
-    if (!synchronousDel(file, true, isDir)) {
-        return false;
+        if (isDir) {
+            deletedDirs.append(fileId);
+        }
+        if (deleted.isEmpty()) {
+            infoDirMTime = index.infoDirModificationTime();
+        }
+        QFile::remove(info);
+        deleted.append(fileId);
     }
 
-    if (isDir) {
+    if (!deletedDirs.isEmpty()) {
         TrashSizeCache trashSize(trashDirectoryPath(trashId));
-        trashSize.remove(fileId);
+        trashSize.remove(deletedDirs);
     }
-
-    QFile::remove(info);
-    fileRemoved();
-    return true;
+    if (!deleted.isEmpty()) {
+        index.remove(deleted, infoDirMTime);
+        fileRemoved();
+    }
+    return deleted;
 }
 
 bool TrashImpl::synchronousDel(const QString &path, bool setLastErrorCode, bool isDir)
@@ -673,6 +747,9 @@ bool TrashImpl::emptyTrash()
                 QFile::remove(filePath);
             }
         }
+
+        // Whatever couldn't be removed will be found again in the info dir
+        TrashIndex(trit.value()).clear();
     }
 
     m_lastErrorCode = myErrorCode;
@@ -693,28 +770,12 @@ TrashImpl::TrashedFileInfoList TrashImpl::list()
     // For each known trash directory...
     for (auto it = m_trashDirectories.cbegin(); it != m_trashDirectories.cend(); ++it) {
         const int trashId = it.key();
-        QString infoPath = it.value();
-        infoPath += QLatin1String("/info");
-        // Code taken from kio_file
-        const QStringList entryNames = listDir(infoPath);
-        // char path_buffer[PATH_MAX];
-        // getcwd(path_buffer, PATH_MAX - 1);
-        // if ( chdir( infoPathEnc ) )
-        //    continue;
-
-        const QLatin1String tail(".trashinfo");
-        const int tailLength = tail.size();
-        for (const QString &fileName : entryNames) {
-            if (fileName == QLatin1Char('.') || fileName == QLatin1String("..")) {
-                continue;
-            }
-            if (!fileName.endsWith(tail)) {
-                qCWarning(KIO_TRASH) << "Invalid info file found in" << infoPath << ":" << fileName;
-                continue;
-            }
-
+        // The index saves us from parsing every .trashinfo file
+        const QList<TrashIndex::Entry> entries = TrashIndex(it.value()).entries();
+        lst.reserve(lst.size() + entries.size());
+        for (const TrashIndex::Entry &entry : entries) {
             TrashedFileInfo info;
-            if (infoForFile(trashId, fileName.chopped(tailLength), info)) {
+            if (infoFromIndexEntry(trashId, entry, info)) {
                 lst << info;
             }
         }
@@ -770,27 +831,29 @@ bool TrashImpl::trashSpaceInfo(const QString &path, TrashSpaceInfo &info)
 
 bool TrashImpl::readInfoFile(const QString &infoPath, TrashedFileInfo &info, int trashId)
 {
-    KConfig cfg(infoPath, KConfig::SimpleConfig);
-    if (!cfg.hasGroup(QStringLiteral("Trash Info"))) {
+    TrashIndex::Entry entry;
+    if (!TrashIndex::parseInfoFile(infoPath, entry)) {
         error(KIO::ERR_CANNOT_OPEN_FOR_READING, infoPath);
         return false;
     }
-    const KConfigGroup group = cfg.group(QStringLiteral("Trash Info"));
-    info.origPath = QUrl::fromPercentEncoding(group.readEntry("Path").toLatin1());
+    entry.fileId = info.fileId;
+    return infoFromIndexEntry(trashId, entry, info);
+}
+
+bool TrashImpl::infoFromIndexEntry(int trashId, const TrashIndex::Entry &entry, TrashedFileInfo &info) const
+{
+    info.trashId = trashId;
+    info.fileId = entry.fileId;
+    info.physicalPath = filesPath(trashId, entry.fileId);
+    info.origPath = QUrl::fromPercentEncoding(entry.path);
     if (info.origPath.isEmpty()) {
         return false; // path is mandatory...
     }
-    if (trashId == 0) {
-        Q_ASSERT(info.origPath[0] == QLatin1Char('/'));
-    } else {
-        if (!info.origPath.startsWith(QLatin1Char('/'))) {
-            const QString topdir = topDirectoryPath(trashId); // includes trailing slash
-            info.origPath.prepend(topdir);
-        }
+    if (trashId != 0 && !info.origPath.startsWith(QLatin1Char('/'))) {
+        info.origPath.prepend(topDirectoryPath(trashId)); // includes trailing slash
     }
-    const QString line = group.readEntry("DeletionDate");
-    if (!line.isEmpty()) {
-        info.deletionDate = QDateTime::fromString(line, Qt::ISODate);
+    if (!entry.deletionDate.isEmpty()) {
+        info.deletionDate = QDateTime::fromString(QString::fromLatin1(entry.deletionDate), Qt::ISODate);
     }
     return true;
 }
@@ -1272,7 +1335,7 @@ bool TrashImpl::parseURL(const QUrl &url, int &trashId, QString &fileId, QString
     return true;
 }
 
-bool TrashImpl::adaptTrashSize(const QString &origPath, int trashId)
+bool TrashImpl::adaptTrashSize(const QString &origPath, int trashId, const QString &fileId, qint64 &additionalSize)
 {
     KConfig config(QStringLiteral("ktrashrc"));
 
@@ -1284,35 +1347,53 @@ bool TrashImpl::adaptTrashSize(const QString &origPath, int trashId)
     const double percent = group.readEntry("Percent", 10.0);
     const int actionType = group.readEntry("LimitReachedAction", 0);
 
+    // Only a size limit needs the size of what's being trashed, and only at the end: compute it meanwhile
+    additionalSize = -1;
+    std::future<qint64> futureSize;
+    if (useSizeLimit) {
+        m_lastSizedPath = origPath;
+        futureSize = std::async(std::launch::async, &DiscSpaceUtil::sizeOfPath, origPath);
+    } else if (!useTimeLimit) {
+        return true;
+    }
+
+    TrashIndex index(trashPath);
+    QList<TrashIndex::Entry> entries = index.entries();
+    // createInfo() already added the file being trashed
+    entries.removeIf([&fileId](const TrashIndex::Entry &entry) {
+        return entry.fileId == fileId;
+    });
+
     if (useTimeLimit) { // delete all files in trash older than X days
         const int maxDays = group.readEntry("Days", 7);
         const QDateTime currentDate = QDateTime::currentDateTime();
 
-        const TrashedFileInfoList trashedFiles = list();
-        for (const auto &info : trashedFiles) {
-            if (info.trashId != trashId) {
-                continue;
-            }
-
-            if (info.deletionDate.daysTo(currentDate) > maxDays) {
-                del(info.trashId, info.fileId);
+        QStringList expired;
+        entries.removeIf([&](const TrashIndex::Entry &entry) {
+            TrashedFileInfo info;
+            if (infoFromIndexEntry(trashId, entry, info) && info.deletionDate.daysTo(currentDate) > maxDays) {
+                expired.append(entry.fileId);
+                return true;
             }
-        }
+            return false;
+        });
+        deleteTrashedItems(trashId, expired);
     }
 
     if (!useSizeLimit) { // check if size limit exceeded
         return true;
     }
 
-    // calculate size of the files to be put into the trash
-    const qint64 additionalSize = DiscSpaceUtil::sizeOfPath(origPath);
-
 #ifdef Q_OS_OSX
     createTrashInfrastructure(trashId);
 #endif
     DiscSpaceUtil util(trashPath + QLatin1String("/files/"));
+    // The index knows the size of each trashed item, only the unknown ones get computed
     auto cache = TrashSizeCache(trashPath);
-    auto trashSize = cache.calculateSize();
+    auto trashSize = cache.calculateSize(entries, index);
+
+    // calculate size of the files to be put into the trash
+    additionalSize = futureSize.get();
 
     if (util.usage(trashSize + additionalSize) < percent) {
         return true;
@@ -1321,9 +1402,7 @@ bool TrashImpl::adaptTrashSize(const QString &origPath, int trashId)
     // before we start to remove any files from the trash,
     // check whether the new file will fit into the trash
     // at all...
-    const qint64 partitionSize = util.size();
-
-    if ((util.usage(partitionSize + additionalSize)) >= percent) {
+    if (util.usage(additionalSize) >= percent) {
         m_lastErrorCode = KIO::ERR_TRASH_FILE_TOO_LARGE;
         m_lastErrorMessage = KIO::buildErrorString(m_lastErrorCode, {});
         return false;
@@ -1337,32 +1416,32 @@ bool TrashImpl::adaptTrashSize(const QString &origPath, int trashId)
 
     // Start removing some other files from the trash
 
-    QDir::SortFlags sortFlags;
-    if (actionType == 1) {
-        sortFlags = QDir::Time | QDir::Reversed; // Delete oldest files first
-    } else if (actionType == 2) {
-        sortFlags = QDir::Size; // Delete biggest files first
+    // A heap of the trashed items, with the next one to remove on top
+    std::function<bool(const TrashIndex::Entry &, const TrashIndex::Entry &)> removeLater;
+    if (actionType == 1) { // Delete oldest files first
+        // ISO dates compare like the dates they represent
+        removeLater = [](const TrashIndex::Entry &a, const TrashIndex::Entry &b) {
+            return a.deletionDate > b.deletionDate;
+        };
+    } else if (actionType == 2) { // Delete biggest files first
+        removeLater = [](const TrashIndex::Entry &a, const TrashIndex::Entry &b) {
+            return a.size < b.size;
+        };
     } else {
         qWarning() << "Called with actionType" << actionType << ", which theoretically should never happen!";
         return false; // Bail out
     }
 
-    const auto dirCache = cache.readDirCache();
-    constexpr QDir::Filters dirFilters = QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot;
-    const QFileInfoList infoList = QDir(trashPath + QLatin1String("/files")).entryInfoList(dirFilters, sortFlags);
-    for (const auto &info : infoList) {
-        auto fileSizeFreed = info.size();
-        if (info.isDir()) {
-            fileSizeFreed = dirCache.constFind(info.path().toUtf8())->size;
-        }
-
-        del(trashId, info.fileName()); // delete trashed file
-        trashSize -= fileSizeFreed;
-
-        if (util.usage(trashSize + additionalSize) < percent) { // check whether we have enough space now
-            return true;
-        }
+    // Pick the items until we have enough space, then delete them all at once
+    QStringList toDelete;
+    std::make_heap(entries.begin(), entries.end(), removeLater);
+    while (!entries.isEmpty() && util.usage(trashSize + additionalSize) >= percent) {
+        std::pop_heap(entries.begin(), entries.end(), removeLater);
+        const TrashIndex::Entry entry = entries.takeLast();
+        toDelete.append(entry.fileId);
+        trashSize -= entry.size;
     }
+    deleteTrashedItems(trashId, toDelete);
 
     return true;
 }
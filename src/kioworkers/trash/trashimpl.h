@@ -9,6 +9,7 @@
 #define TRASHIMPL_H
 
 #include "global.h"
+#include "trashindex.h"
 #include "udsentry.h"
 #include <kio/job.h>
 
@@ -125,6 +126,11 @@ public:
     TrashDirMap trashDirectories() const;
     /// @internal This method is for TestTrash only. No entry with id 0.
     TrashDirMap topDirectories() const;
+    /// @internal This method is for TestTrash only. The path of the last item sized for the size limit of a trash.
+    QString lastSizedPath() const
+    {
+        return m_lastSizedPath;
+    }
 
 Q_SIGNALS:
     void leaveModality();
@@ -139,13 +145,22 @@ private:
     void fileAdded();
     void fileRemoved();
 
-    bool adaptTrashSize(const QString &origPath, int trashId);
+    /// Deletes the trashed items @p fileIds, updating the index and the size cache once for all of them.
+    /// Returns the file IDs of the items actually deleted.
+    QStringList deleteTrashedItems(int trashId, const QStringList &fileIds);
+
+    /// Enforces the limits of the trash for trashing @p origPath, whose info file @p fileId exists already.
+    /// @p origPath may also be the item already moved into the trash, see moveToTrash().
+    /// @p additionalSize is set to the size of @p origPath for the caller to reuse, or to -1 if no size limit
+    /// made it necessary to compute it.
+    bool adaptTrashSize(const QString &origPath, int trashId, const QString &fileId, qint64 &additionalSize);
 
     // Warning, returns error code, not a bool
     int testDir(const QString &name) const;
     void error(int e, const QString &s);
 
     bool readInfoFile(const QString &infoPath, TrashedFileInfo &info, int trashId);
+    bool infoFromIndexEntry(int trashId, const TrashIndex::Entry &entry, TrashedFileInfo &info) const;
 
     QString infoPath(int trashId, const QString &fileId) const;
     QString filesPath(int trashId, const QString &fileId) const;
@@ -194,6 +209,8 @@ private:
     /// Note that this means almost no method can be const.
     int m_lastErrorCode;
     QString m_lastErrorMessage;
+    // See lastSizedPath()
+    QString m_lastSizedPath;
 
     enum {
         InitToBeDone,
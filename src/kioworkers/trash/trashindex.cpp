@@ -0,0 +1,370 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "trashindex.h"
+
+#include "kiotrashdebug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QLockFile>
+#include <QSaveFile>
+#include <qplatformdefs.h> // QT_LSTAT, QT_STAT, QT_STATBUF
+
+#include <sys/stat.h>
+
+#include <algorithm>
+
+// Bump this when changing the format of the index file:
+//   "<version> <mtime of the info dir> <invalid .trashinfo files>\n", then one record per line:
+//   "e <size> <deletion date> <path> <file id>"                  an entry of the snapshot
+//   "+ <mtime before> <mtime after> <size> <date> <path> <id>"    a trashed item
+//   "- <mtime before> <mtime after> <file id>"                    a deleted item
+//   "> <mtime before> <mtime after> <old file id> <new file id>"  a renamed item
+//   "= <size> <file id>"                                          the size of an item
+// The dates, paths and file IDs being percent-encoded
+static constexpr int s_indexVersion = 2;
+
+// The journal is folded into a new snapshot once it has more records than the snapshot has entries,
+// and at least this many
+static constexpr qsizetype s_minJournalRecords = 64;
+
+// Percent-encodes @p value, keeping it free of spaces and never empty
+static QByteArray encodeField(const QByteArray &value)
+{
+    return value.isEmpty() ? QByteArrayLiteral("-") : value.toPercentEncoding(QByteArray(), QByteArrayLiteral("-"));
+}
+
+static QByteArray decodeField(const QByteArray &field)
+{
+    return field == "-" ? QByteArray() : QByteArray::fromPercentEncoding(field);
+}
+
+static QByteArray encodeFileId(const QString &fileId)
+{
+    return encodeField(QFile::encodeName(fileId));
+}
+
+static QString decodeFileId(const QByteArray &field)
+{
+    return QFile::decodeName(decodeField(field));
+}
+
+// "<size> <deletion date> <path> <file id>"
+static QByteArray encodeEntry(const TrashIndex::Entry &entry)
+{
+    return QByteArray::number(entry.size) + ' ' + encodeField(entry.deletionDate) + ' ' + encodeField(entry.path) + ' ' + encodeFileId(entry.fileId);
+}
+
+static TrashIndex::Entry decodeEntry(const QList<QByteArray> &fields, qsizetype first)
+{
+    TrashIndex::Entry entry;
+    entry.size = fields.at(first).toLongLong();
+    entry.deletionDate = decodeField(fields.at(first + 1));
+    entry.path = decodeField(fields.at(first + 2));
+    entry.fileId = decodeFileId(fields.at(first + 3));
+    return entry;
+}
+
+TrashIndex::TrashIndex(const QString &path)
+    : mTrashPath(path)
+    , mIndexPath(path + QLatin1String("/kio_trash.index"))
+{
+}
+
+qint64 TrashIndex::infoDirModificationTime() const
+{
+    QT_STATBUF buff;
+    if (QT_STAT(QFile::encodeName(mTrashPath + QLatin1String("/info")).constData(), &buff) != 0) {
+        return 0;
+    }
+    // The nanoseconds tell apart changes made within the same second
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD) || defined(Q_OS_HAIKU)
+    return qint64(buff.st_mtim.tv_sec) * 1000000000 + buff.st_mtim.tv_nsec;
+#elif defined(Q_OS_DARWIN)
+    return qint64(buff.st_mtimespec.tv_sec) * 1000000000 + buff.st_mtimespec.tv_nsec;
+#else
+    return qint64(buff.st_mtime) * 1000000000;
+#endif
+}
+
+QList<TrashIndex::Entry> TrashIndex::entries()
+{
+    QLockFile lock(mIndexPath + QLatin1String(".lock"));
+    if (!lock.lock()) {
+        qCWarning(KIO_TRASH) << "Couldn't lock" << mIndexPath;
+    }
+
+    // Take the time first: a change made while we read the directory will be noticed next time
+    const qint64 infoDirMTime = infoDirModificationTime();
+    if (infoDirMTime == 0) {
+        return {}; // no info dir, nothing trashed here
+    }
+    // Only the names, which is cheap next to parsing the files. Counting them catches the
+    // changes made by others within the resolution of the time of the directory
+    const QStringList infoFiles =
+        QDir(mTrashPath + QLatin1String("/info"), QStringLiteral("*.trashinfo"), QDir::Unsorted, QDir::Files | QDir::Hidden | QDir::System).entryList();
+
+    Index index = read();
+    if (index.infoDirMTime != infoDirMTime || index.entries.size() + index.invalidInfoFiles != infoFiles.size()) {
+        synchronize(index, infoDirMTime, infoFiles);
+        write(index);
+    } else if (index.journalRecords > std::max(s_minJournalRecords, index.entries.size())) {
+        write(index);
+    }
+    return index.entries;
+}
+
+void TrashIndex::add(const Entry &entry, qint64 infoDirMTime)
+{
+    append("+ " + QByteArray::number(infoDirMTime) + ' ' + QByteArray::number(infoDirModificationTime()) + ' ' + encodeEntry(entry) + '\n');
+}
+
+void TrashIndex::remove(const QString &fileId, qint64 infoDirMTime)
+{
+    remove(QStringList{fileId}, infoDirMTime);
+}
+
+void TrashIndex::remove(const QStringList &fileIds, qint64 infoDirMTime)
+{
+    // The first record covers the whole batch of changes, the others change nothing more
+    const QByteArray after = QByteArray::number(infoDirModificationTime());
+    QByteArray before = QByteArray::number(infoDirMTime);
+    QByteArray records;
+    for (const QString &fileId : fileIds) {
+        records += "- " + before + ' ' + after + ' ' + encodeFileId(fileId) + '\n';
+        before = after;
+    }
+    append(records);
+}
+
+void TrashIndex::rename(const QString &oldFileId, const QString &newFileId, qint64 infoDirMTime)
+{
+    append("> " + QByteArray::number(infoDirMTime) + ' ' + QByteArray::number(infoDirModificationTime()) + ' ' + encodeFileId(oldFileId) + ' '
+           + encodeFileId(newFileId) + '\n');
+}
+
+void TrashIndex::setSize(const QString &fileId, qint64 size)
+{
+    setSizes({{fileId, size}});
+}
+
+void TrashIndex::setSizes(const QHash<QString, qint64> &sizes)
+{
+    QByteArray records;
+    for (auto it = sizes.cbegin(); it != sizes.cend(); ++it) {
+        records += "= " + QByteArray::number(it.value()) + ' ' + encodeFileId(it.key()) + '\n';
+    }
+    append(records);
+}
+
+void TrashIndex::clear()
+{
+    QFile::remove(mIndexPath);
+}
+
+void TrashIndex::append(const QByteArray &records)
+{
+    if (records.isEmpty() || !QFile::exists(mIndexPath)) {
+        return; // entries() will create it
+    }
+
+    QLockFile lock(mIndexPath + QLatin1String(".lock"));
+    if (!lock.lock()) {
+        qCWarning(KIO_TRASH) << "Couldn't lock" << mIndexPath;
+    }
+
+    QFile file(mIndexPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::ExistingOnly)) {
+        return;
+    }
+    // A record cut short is noticed by read(), which then synchronizes the index
+    if (file.write(records) != records.size()) {
+        qCWarning(KIO_TRASH) << "Couldn't append to" << mIndexPath << file.errorString();
+    }
+}
+
+TrashIndex::Index TrashIndex::read() const
+{
+    Index index;
+    QFile file(mIndexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return index;
+    }
+
+    const QList<QByteArray> header = file.readLine().trimmed().split(' ');
+    if (header.size() != 3 || header.at(0).toInt() != s_indexVersion) {
+        return index;
+    }
+    qint64 infoDirMTime = header.at(1).toLongLong();
+    index.invalidInfoFiles = header.at(2).toLongLong();
+
+    // Where each file ID is in index.entries; deleted entries are left without file ID until the end
+    QHash<QString, qsizetype> positions;
+    const auto insert = [&index, &positions](const Entry &entry) {
+        const auto it = positions.constFind(entry.fileId);
+        if (it != positions.cend()) {
+            index.entries[*it] = entry;
+        } else {
+            positions.insert(entry.fileId, index.entries.size());
+            index.entries.append(entry);
+        }
+    };
+    // Takes @p fileId out of the positions, returning -1 if it has no entry
+    const auto take = [&positions](const QString &fileId) -> qsizetype {
+        const auto it = positions.constFind(fileId);
+        if (it == positions.cend()) {
+            return -1;
+        }
+        const qsizetype position = *it;
+        positions.erase(it);
+        return position;
+    };
+    // The change of a record moves the index to the time after it, if it was up to date before it
+    const auto changeInfoDir = [&infoDirMTime](const QByteArray &before, const QByteArray &after) {
+        if (before.toLongLong() == infoDirMTime) {
+            infoDirMTime = after.toLongLong();
+        }
+    };
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine();
+        if (!line.endsWith('\n')) {
+            // Cut short while being appended: the change it records is in the info dir only
+            qCWarning(KIO_TRASH) << "Truncated record in" << mIndexPath;
+            infoDirMTime = -1;
+            break;
+        }
+        const QList<QByteArray> fields = line.trimmed().split(' ');
+        const QByteArray &type = fields.at(0);
+        if (type == "e" && fields.size() == 5) {
+            insert(decodeEntry(fields, 1));
+        } else if (type == "+" && fields.size() == 7) {
+            changeInfoDir(fields.at(1), fields.at(2));
+            insert(decodeEntry(fields, 3));
+        } else if (type == "-" && fields.size() == 4) {
+            changeInfoDir(fields.at(1), fields.at(2));
+            const qsizetype position = take(decodeFileId(fields.at(3)));
+            if (position != -1) {
+                index.entries[position].fileId.clear();
+            }
+        } else if (type == ">" && fields.size() == 5) {
+            changeInfoDir(fields.at(1), fields.at(2));
+            const qsizetype position = take(decodeFileId(fields.at(3)));
+            if (position != -1) {
+                Entry entry = index.entries.at(position);
+                index.entries[position].fileId.clear();
+                entry.fileId = decodeFileId(fields.at(4));
+                insert(entry);
+            }
+        } else if (type == "=" && fields.size() == 3) {
+            const auto it = positions.constFind(decodeFileId(fields.at(2)));
+            if (it != positions.cend()) {
+                index.entries[*it].size = fields.at(1).toLongLong();
+            }
+        } else {
+            qCWarning(KIO_TRASH) << "Invalid line in" << mIndexPath;
+            return Index();
+        }
+        if (type != "e") {
+            ++index.journalRecords;
+        }
+    }
+
+    index.entries.removeIf([](const Entry &entry) {
+        return entry.fileId.isEmpty();
+    });
+    index.infoDirMTime = infoDirMTime;
+    return index;
+}
+
+void TrashIndex::write(const Index &index)
+{
+    QSaveFile out(mIndexPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qCWarning(KIO_TRASH) << "Couldn't write" << mIndexPath << out.errorString();
+        return;
+    }
+
+    out.write(QByteArray::number(s_indexVersion) + ' ' + QByteArray::number(index.infoDirMTime) + ' ' + QByteArray::number(index.invalidInfoFiles) + '\n');
+    for (const Entry &entry : index.entries) {
+        out.write("e " + encodeEntry(entry) + '\n');
+    }
+    out.commit();
+}
+
+void TrashIndex::synchronize(Index &index, qint64 infoDirMTime, const QStringList &infoFiles) const
+{
+    index.infoDirMTime = infoDirMTime;
+    index.invalidInfoFiles = 0;
+    index.journalRecords = 0;
+
+    QHash<QString, Entry> known;
+    known.reserve(index.entries.size());
+    for (const Entry &entry : std::as_const(index.entries)) {
+        known.insert(entry.fileId, entry);
+    }
+    index.entries.clear();
+    index.entries.reserve(infoFiles.size());
+
+    const QString infoPath = mTrashPath + QLatin1String("/info/");
+    const QString filesPath = mTrashPath + QLatin1String("/files/");
+    const QLatin1String tail(".trashinfo");
+    int parsed = 0;
+    for (const QString &infoFile : infoFiles) {
+        const QString fileId = infoFile.chopped(tail.size());
+        const auto it = known.constFind(fileId);
+        if (it != known.cend()) {
+            index.entries.append(*it);
+            continue;
+        }
+
+        Entry entry;
+        if (!parseInfoFile(infoPath + infoFile, entry)) {
+            ++index.invalidInfoFiles;
+            continue;
+        }
+        entry.fileId = fileId;
+        QT_STATBUF buff;
+        if (QT_LSTAT(QFile::encodeName(filesPath + fileId).constData(), &buff) == 0 && !S_ISDIR(buff.st_mode)) {
+            entry.size = buff.st_size;
+        }
+        index.entries.append(entry);
+        ++parsed;
+    }
+    qCDebug(KIO_TRASH) << "synchronized" << mIndexPath << ":" << index.entries.size() << "entries," << parsed << "parsed";
+}
+
+bool TrashIndex::parseInfoFile(const QString &infoPath, Entry &entry)
+{
+    QFile file(infoPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    bool inGroup = false;
+    bool hasGroup = false;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.startsWith('[')) {
+            inGroup = line == "[Trash Info]";
+            hasGroup = hasGroup || inGroup;
+            continue;
+        }
+        const qsizetype equal = line.indexOf('=');
+        if (!inGroup || equal == -1) {
+            continue; // also skips the comments
+        }
+        const QByteArray key = line.left(equal).trimmed();
+        if (key == "Path") {
+            entry.path = line.mid(equal + 1).trimmed();
+        } else if (key == "DeletionDate") {
+            entry.deletionDate = line.mid(equal + 1).trimmed();
+        }
+    }
+    return hasGroup && !entry.path.isEmpty(); // path is mandatory...
+}
@@ -0,0 +1,132 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef TRASHINDEX_H
+#define TRASHINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @short An index of the .trashinfo files of a trash directory.
+ *
+ * Listing the trash would otherwise mean opening and parsing every .trashinfo file.
+ * The index is a file next to the "info" and "files" subdirectories, holding for each
+ * trashed item its file ID, the Path and DeletionDate values of its .trashinfo file,
+ * and its size if known.
+ *
+ * The index file is a snapshot of the entries followed by a journal: trashing, deleting
+ * or renaming an item only appends a record to it. The records are folded into a new
+ * snapshot, written with QSaveFile, once the journal gets longer than the snapshot.
+ *
+ * The index also holds the modification time of the "info" directory it matches, in
+ * nanoseconds. If another program changed the trash behind our back, either that time
+ * or the number of .trashinfo files disagree, and the index is brought up to date with
+ * the "info" directory, parsing only the new .trashinfo files.
+ *
+ * The index is never more than an index: losing it only costs parsing the .trashinfo
+ * files again.
+ */
+class TrashIndex
+{
+public:
+    struct Entry {
+        QString fileId;
+        QByteArray path; // the Path value of the .trashinfo file, percent-encoded, maybe relative
+        QByteArray deletionDate; // the DeletionDate value of the .trashinfo file
+        qint64 size = -1; // size in bytes of the trashed file or directory, -1 if unknown
+    };
+
+    /**
+     * Creates an index object for the trash directory @p path.
+     */
+    explicit TrashIndex(const QString &path);
+
+    /**
+     * Returns the modification time of the "info" directory, in ns since the epoch.
+     * Call this before changing the "info" directory, and pass the result to
+     * add(), remove() or rename() afterwards.
+     */
+    qint64 infoDirModificationTime() const;
+
+    /**
+     * Returns the entries of all the trashed items, bringing the index up to date first if needed.
+     */
+    QList<Entry> entries();
+
+    /**
+     * Adds the entry of a newly created .trashinfo file.
+     * @param infoDirMTime the result of infoDirModificationTime() before creating the file
+     */
+    void add(const Entry &entry, qint64 infoDirMTime);
+
+    /**
+     * Removes the entry of a deleted .trashinfo file.
+     * @param infoDirMTime the result of infoDirModificationTime() before deleting the file
+     */
+    void remove(const QString &fileId, qint64 infoDirMTime);
+
+    /**
+     * Removes the entries of several deleted .trashinfo files at once.
+     * @param infoDirMTime the result of infoDirModificationTime() before deleting the first file
+     */
+    void remove(const QStringList &fileIds, qint64 infoDirMTime);
+
+    /**
+     * Renames an entry, after renaming its .trashinfo file.
+     * @param infoDirMTime the result of infoDirModificationTime() before renaming the file
+     */
+    void rename(const QString &oldFileId, const QString &newFileId, qint64 infoDirMTime);
+
+    /**
+     * Sets the size of the trashed item @p fileId, once it's in the "files" directory.
+     */
+    void setSize(const QString &fileId, qint64 size);
+
+    /**
+     * Sets the sizes of several trashed items at once, by file ID.
+     */
+    void setSizes(const QHash<QString, qint64> &sizes);
+
+    /**
+     * Forgets the whole index, e.g. after emptying the trash.
+     */
+    void clear();
+
+    /**
+     * Parses the .trashinfo file @p infoPath into the path and the deletion date of @p entry.
+     * This is the one parser of .trashinfo files, for the index and for reading single items.
+     * @return false if it's not a valid .trashinfo file
+     */
+    static bool parseInfoFile(const QString &infoPath, Entry &entry);
+
+private:
+    struct Index {
+        qint64 infoDirMTime = -1;
+        QList<Entry> entries;
+        qsizetype invalidInfoFiles = 0; // .trashinfo files without an entry, as they couldn't be parsed
+        qsizetype journalRecords = 0; // records to fold into the next snapshot
+    };
+    Index read() const;
+    // Writes @p index as a new snapshot, without journal
+    void write(const Index &index);
+    // Appends the journal records @p records. Each record changing the "info" directory holds
+    // its time before the change, @p infoDirMTime, and after it: the index stays up to date only
+    // if it was up to date before the change
+    void append(const QByteArray &records);
+    // Brings @p index up to date with the "info" directory, whose time is @p infoDirMTime
+    // and whose .trashinfo files are @p infoFiles
+    void synchronize(Index &index, qint64 infoDirMTime, const QStringList &infoFiles) const;
+
+    QString mTrashPath;
+    QString mIndexPath;
+};
+
+#endif
@@ -15,7 +15,9 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
+#include <QFileInfo>
 #include <QSaveFile>
+#include <QSet>
 #include <qplatformdefs.h> // QT_LSTAT, QT_STAT, QT_STATBUF
 
 TrashSizeCache::TrashSizeCache(const QString &path)
@@ -62,14 +64,22 @@ void TrashSizeCache::add(const QString &directoryName, qint64 directorySize)
 
 void TrashSizeCache::remove(const QString &directoryName)
 {
-    // qCDebug(KIO_TRASH) << directoryName;
-    const QByteArray spaceAndDirAndNewline = spaceAndDirectoryAndNewline(directoryName);
+    remove(QStringList{directoryName});
+}
+
+void TrashSizeCache::remove(const QStringList &directoryNames)
+{
+    // qCDebug(KIO_TRASH) << directoryNames;
+    QSet<QByteArray> spaceAndDirsAndNewline;
+    for (const QString &directoryName : directoryNames) {
+        spaceAndDirsAndNewline.insert(spaceAndDirectoryAndNewline(directoryName));
+    }
     QFile file(mTrashSizeCachePath);
     QSaveFile out(mTrashSizeCachePath);
     if (file.open(QIODevice::ReadOnly) && out.open(QIODevice::WriteOnly)) {
         while (!file.atEnd()) {
             const QByteArray line = file.readLine();
-            if (line.endsWith(spaceAndDirAndNewline)) {
+            if (spaceAndDirsAndNewline.contains(line.mid(line.lastIndexOf(' ')))) {
                 // Found it -> skip it
                 continue;
             }
@@ -130,6 +140,38 @@ QHash<QByteArray, TrashSizeCache::SizeAndModTime> TrashSizeCache::readDirCache()
     return dirCache;
 }
 
+qint64 TrashSizeCache::calculateSize(QList<TrashIndex::Entry> &entries, TrashIndex &index)
+{
+    QHash<QByteArray, SizeAndModTime> dirCache;
+    bool dirCacheRead = false;
+    QHash<QString, qint64> newSizes;
+    qint64 sum = 0;
+    for (TrashIndex::Entry &entry : entries) {
+        if (entry.size < 0) {
+            const QString filePath = mTrashPath + QLatin1String("/files/") + entry.fileId;
+            if (QFileInfo(filePath).isDir()) {
+                if (!dirCacheRead) {
+                    dirCache = readDirCache();
+                    dirCacheRead = true;
+                }
+                const auto it = dirCache.constFind(QFile::encodeName(entry.fileId).toPercentEncoding());
+                if (it != dirCache.cend()) {
+                    entry.size = it->size;
+                } else {
+                    entry.size = DiscSpaceUtil::sizeOfPath(filePath);
+                    add(entry.fileId, entry.size);
+                }
+            } else {
+                entry.size = DiscSpaceUtil::sizeOfPath(filePath);
+            }
+            newSizes.insert(entry.fileId, entry.size);
+        }
+        sum += entry.size;
+    }
+    index.setSizes(newSizes);
+    return sum;
+}
+
 qint64 TrashSizeCache::calculateSize()
 {
     return scanFilesInTrash(ScanFilesInTrashOption::DonTcheckModificationTime).size;
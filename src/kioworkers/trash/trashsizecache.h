@@ -10,9 +10,12 @@
 #define TRASHSIZECACHE_H
 
 #include <QString>
+#include <QStringList>
 
 #include <KConfig>
 
+#include "trashindex.h"
+
 class QFileInfo;
 
 /**
@@ -49,6 +52,11 @@ public:
      */
     void remove(const QString &directoryName);
 
+    /**
+     * Removes several directories from the cache at once.
+     */
+    void remove(const QStringList &directoryNames);
+
     /**
      * Renames a directory in the cache.
      */
@@ -69,6 +77,14 @@ public:
      */
     SizeAndModTime calculateSizeAndLatestModDate();
 
+    /**
+     * Fills in the unknown sizes of the trashed items @p entries, from the directory
+     * size cache or by computing them, and returns the total size of @p entries.
+     * This is much cheaper than calculateSize() when the index knows most sizes already.
+     * @p index gets the sizes that were computed.
+     */
+    qint64 calculateSize(QList<TrashIndex::Entry> &entries, TrashIndex &index);
+
     /**
      * Returns the space occupied by directories in trash and their latest modification dates
      */
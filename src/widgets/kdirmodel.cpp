@@ -19,22 +19,24 @@
 #include <kio/statjob.h>
 
 #include <QBitArray>
+#include <QCache>
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
+#include <QFuture>
 #include <QIcon>
 #include <QLocale>
 #include <QLoggingCategory>
 #include <QMimeData>
-#include <qplatformdefs.h>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentRun>
 
 #include <algorithm>
-
-#ifdef Q_OS_WIN
-#include <qt_windows.h>
-#endif
+#include <limits>
 
 Q_LOGGING_CATEGORY(category, "kf.kio.widgets.kdirmodel", QtInfoMsg)
 
@@ -53,6 +55,61 @@ static QUrl cleanupUrl(const QUrl &url)
     return u;
 }
 
+// What a local directory holds, found out by probeDirectory()
+struct DirectoryProbe {
+    QDateTime mtime; // modification time of the directory item when probed
+    int count = KDirModel::ChildCountUnknown; // all the entries
+    bool hasVisibleEntries = false; // not hidden
+    bool hasDirs = false; // real directories, not symlinks to one
+    bool hasVisibleDirs = false;
+
+    // Whether a listing of the directory with these settings would show anything
+    bool hasChildren(bool dirOnlyMode, bool showHiddenFiles) const
+    {
+        if (dirOnlyMode) {
+            return showHiddenFiles ? hasDirs : hasVisibleDirs;
+        }
+        return showHiddenFiles ? count > 0 : hasVisibleEntries;
+    }
+};
+
+// Runs in a thread of directoryProbePool(): reading a directory can block
+// for a long time on a slow disk or an automount
+static DirectoryProbe probeDirectory(const QString &path)
+{
+    DirectoryProbe probe;
+    if (!QFileInfo(path).isReadable()) {
+        return probe;
+    }
+
+    probe.count = 0;
+    QDirIterator it(path, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System | QDir::Hidden);
+    while (it.hasNext()) {
+        it.next();
+        // The type and hidden state come with the directory entry, no stat() needed
+        const QFileInfo info = it.fileInfo();
+        const bool isVisible = !info.isHidden();
+        const bool isDir = !info.isSymLink() && info.isDir();
+        ++probe.count;
+        probe.hasVisibleEntries |= isVisible;
+        probe.hasDirs |= isDir;
+        probe.hasVisibleDirs |= isDir && isVisible;
+    }
+    return probe;
+}
+
+// Shared by all the models, and only used from the main thread.
+// A probe is valid as long as the modification time of its directory item doesn't change.
+Q_GLOBAL_STATIC(QCache<QString, DirectoryProbe>, s_directoryProbes, 10000)
+
+// Deliberately leaked: destroying a pool waits for its threads, and a probe stuck
+// on a dead network mount would then hang the application on exit
+static QThreadPool *directoryProbePool()
+{
+    static QThreadPool *const pool = new QThreadPool;
+    return pool;
+}
+
 // We create our own tree behind the scenes to have fast lookup from an item to its parent,
 // and also to get the children of an item fast.
 class KDirModelNode
@@ -82,8 +139,8 @@ public:
         return m_parent;
     }
 
-    // linear search
-    int rowNumber() const; // O(n)
+    // O(1), except right after rows were removed before this node: then O(n) once
+    int rowNumber() const;
 
     QIcon preview() const
     {
@@ -102,9 +159,13 @@ public:
     }
 
 private:
+    friend class KDirModelDirNode;
+
     KFileItem m_item;
     KDirModelDirNode *const m_parent;
     QIcon m_preview;
+    // Row of the node in its parent, maintained by the parent
+    mutable int m_rowNumber = 0;
 };
 
 // Specialization for directory nodes
@@ -113,7 +174,6 @@ class KDirModelDirNode : public KDirModelNode
 public:
     KDirModelDirNode(KDirModelDirNode *parent, const KFileItem &item)
         : KDirModelNode(parent, item)
-        , m_childCount(KDirModel::ChildCountUnknown)
         , m_populated(false)
         , m_fsType(FsTypeUnknown)
     {
@@ -126,7 +186,46 @@ public:
     {
         qDeleteAll(m_childNodes);
     }
-    QList<KDirModelNode *> m_childNodes; // owns the nodes
+    // owns the nodes; only modify it with the methods below, they keep the row numbers right
+    QList<KDirModelNode *> m_childNodes;
+
+    void appendChild(KDirModelNode *node)
+    {
+        node->m_rowNumber = m_childNodes.count();
+        m_childNodes.append(node);
+    }
+
+    // Deletes the child at @p row and puts @p node there instead
+    void replaceChild(int row, KDirModelNode *node)
+    {
+        delete m_childNodes.at(row);
+        node->m_rowNumber = row;
+        m_childNodes[row] = node;
+    }
+
+    // Deletes the children from row @p first to row @p last
+    void removeChildren(int first, int last)
+    {
+        qDeleteAll(m_childNodes.cbegin() + first, m_childNodes.cbegin() + last + 1);
+        m_childNodes.remove(first, last - first + 1);
+        // The children after them have moved up, renumber them when needed only. Removing
+        // several ranges in a row still moves the tail of the list once per range (a memmove
+        // of pointers, as the views may look at the rows between two ranges), but no longer
+        // renumbers it each time too
+        m_firstStaleRow = std::min(m_firstStaleRow, first);
+    }
+
+    int rowNumberOf(const KDirModelNode *node) const
+    {
+        if (node->m_rowNumber >= m_firstStaleRow) {
+            const int count = m_childNodes.count();
+            for (int row = m_firstStaleRow; row < count; ++row) {
+                m_childNodes.at(row)->m_rowNumber = row;
+            }
+            m_firstStaleRow = std::numeric_limits<int>::max();
+        }
+        return node->m_rowNumber;
+    }
 
     void setItem(const KFileItem &item) override
     {
@@ -138,15 +237,10 @@ public:
         }
     }
 
-    // If we listed the directory, the child count is known. Otherwise it can be set via setChildCount.
+    // If we listed the directory, the child count is known. Otherwise see KDirModelPrivate::directoryProbe.
     int childCount() const
     {
-        return m_childNodes.isEmpty() ? m_childCount : m_childNodes.count();
-    }
-
-    void setChildCount(int count)
-    {
-        m_childCount = count;
+        return m_childNodes.isEmpty() ? KDirModel::ChildCountUnknown : m_childNodes.count();
     }
 
     bool isPopulated() const
@@ -183,7 +277,8 @@ public:
     }
 
 private:
-    int m_childCount : 31;
+    // The row numbers of the children from this row on may be out of date
+    mutable int m_firstStaleRow = std::numeric_limits<int>::max();
     bool m_populated : 1;
     // Network file system? (nfs/smb/ssh)
     mutable enum {
@@ -198,7 +293,7 @@ int KDirModelNode::rowNumber() const
     if (!m_parent) {
         return 0;
     }
-    return m_parent->m_childNodes.indexOf(const_cast<KDirModelNode *>(this));
+    return m_parent->rowNumberOf(this);
 }
 
 ////
@@ -210,6 +305,11 @@ public:
         : q(qq)
         , m_rootNode(new KDirModelDirNode(nullptr, KFileItem()))
     {
+        m_probeTimer.setSingleShot(true);
+        m_probeTimer.setInterval(100);
+        QObject::connect(&m_probeTimer, &QTimer::timeout, q, [this]() {
+            emitProbedDirectoriesChanged();
+        });
     }
     ~KDirModelPrivate()
     {
@@ -283,6 +383,12 @@ public:
 
     void removeFromNodeHash(KDirModelNode *node, const QUrl &url);
     void clearAllPreviews(KDirModelDirNode *node);
+    // Returns what the local directory of @p node holds, if known.
+    // Otherwise returns nullptr, and probes the directory in a thread;
+    // dataChanged is emitted for the node once the probe is done.
+    // Directories that aren't local or have no modification time are never probed
+    const DirectoryProbe *directoryProbe(const KDirModelDirNode *node);
+    void emitProbedDirectoriesChanged();
 #ifndef NDEBUG
     void dump();
 #endif
@@ -299,6 +405,9 @@ public:
     QMap<KDirModelNode *, QList<QUrl>> m_urlsBeingFetched;
     QHash<QUrl, KDirModelNode *> m_nodeHash; // global node hash: url -> node
     QStringList m_allCurrentDestUrls; // list of all dest urls that have jobs on them (e.g. copy, download)
+    QSet<QString> m_pendingProbes; // paths of the directories being probed
+    QList<QUrl> m_probedUrls; // urls of the directories probed since the last emitProbedDirectoriesChanged
+    QTimer m_probeTimer; // to emit dataChanged for many probed directories at once
 };
 
 KDirModelNode *KDirModelPrivate::nodeForUrl(const QUrl &_url) const // O(1), well, O(length of url as a string)
@@ -400,7 +509,7 @@ void KDirModelPrivate::dump()
 }
 #endif
 
-// node -> index. If rowNumber is set (or node is root): O(1). Otherwise: O(n).
+// node -> index. O(1), see KDirModelNode::rowNumber()
 QModelIndex KDirModelPrivate::indexForNode(KDirModelNode *node, int rowNumber) const
 {
     if (node == m_rootNode) {
@@ -540,7 +649,7 @@ void KDirModelPrivate::_k_slotNewItems(const QUrl &directoryUrl, const KFileItem
     Q_ASSERT(isDir(result));
     KDirModelDirNode *dirNode = static_cast<KDirModelDirNode *>(result);
 
-    const QModelIndex index = indexForNode(dirNode); // O(n)
+    const QModelIndex index = indexForNode(dirNode); // O(1)
     const int newItemsCount = items.count();
     const int newRowCount = dirNode->m_childNodes.count() + newItemsCount;
 
@@ -569,7 +678,7 @@ void KDirModelPrivate::_k_slotNewItems(const QUrl &directoryUrl, const KFileItem
         //    abort();
         //}
 #endif
-        dirNode->m_childNodes.append(node);
+        dirNode->appendChild(node);
         const QUrl url = item.url();
         m_nodeHash.insert(cleanupUrl(url), node);
 
@@ -640,14 +749,14 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
         return;
     }
 
-    QModelIndex parentIndex = indexForNode(dirNode); // O(n)
+    QModelIndex parentIndex = indexForNode(dirNode); // O(1)
 
     // Short path for deleting a single item
     if (items.count() == 1) {
         const int r = node->rowNumber();
         q->beginRemoveRows(parentIndex, r, r);
         removeFromNodeHash(node, url);
-        delete dirNode->m_childNodes.takeAt(r);
+        dirNode->removeChildren(r, r);
         q->endRemoveRows();
         return;
     }
@@ -668,7 +777,7 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
             // see https://bugs.kde.org/show_bug.cgi?id=196695
             return;
         }
-        rowNumbers.setBit(node->rowNumber(), 1); // O(n)
+        rowNumbers.setBit(node->rowNumber(), 1); // O(1)
         removeFromNodeHash(node, url);
     }
 
@@ -686,10 +795,7 @@ void KDirModelPrivate::_k_slotDeleteItems(const KFileItemList &items)
             start = val ? i : i + 1;
             // qDebug() << "beginRemoveRows" << start << end;
             q->beginRemoveRows(parentIndex, start, end);
-            for (int r = end; r >= start; --r) { // reverse because takeAt changes indexes ;)
-                // qDebug() << "Removing from m_childNodes at" << r;
-                delete dirNode->m_childNodes.takeAt(r);
-            }
+            dirNode->removeChildren(start, end);
             q->endRemoveRows();
         }
         lastVal = val;
@@ -708,7 +814,7 @@ void KDirModelPrivate::_k_slotRefreshItems(const QList<QPair<KFileItem, KFileIte
         Q_ASSERT(!newItem.isNull());
         const QUrl oldUrl = oldItem.url();
         const QUrl newUrl = newItem.url();
-        KDirModelNode *node = nodeForUrl(oldUrl); // O(n); maybe we could look up to the parent only once
+        KDirModelNode *node = nodeForUrl(oldUrl); // O(depth)
         // qDebug() << "in model for" << m_dirLister->url() << ":" << oldUrl << "->" << newUrl << "node=" << node;
         if (!node) { // not found [can happen when renaming a dir, redirection was emitted already]
             continue;
@@ -721,9 +827,8 @@ void KDirModelPrivate::_k_slotRefreshItems(const QList<QPair<KFileItem, KFileIte
                 const int r = node->rowNumber();
                 removeFromNodeHash(node, oldUrl);
                 KDirModelDirNode *dirNode = node->parent();
-                delete dirNode->m_childNodes.takeAt(r); // i.e. "delete node"
                 node = newItem.isDir() ? new KDirModelDirNode(dirNode, newItem) : new KDirModelNode(dirNode, newItem);
-                dirNode->m_childNodes.insert(r, node); // same position!
+                dirNode->replaceChild(r, node); // same position! (deletes the old node)
                 hasNewNode = true;
             } else {
                 node->setItem(newItem);
@@ -830,6 +935,53 @@ void KDirModelPrivate::clearAllPreviews(KDirModelDirNode *dirNode)
     }
 }
 
+const DirectoryProbe *KDirModelPrivate::directoryProbe(const KDirModelDirNode *node)
+{
+    const KFileItem &item = node->item();
+    const QString path = item.localPath();
+    if (path.isEmpty()) {
+        return nullptr;
+    }
+    const QDateTime mtime = item.time(KFileItem::ModificationTime);
+    if (!mtime.isValid()) {
+        // Nothing would tell us when a probe gets out of date, treat it like a remote directory
+        return nullptr;
+    }
+    if (const DirectoryProbe *probe = s_directoryProbes()->object(path); probe && probe->mtime == mtime) {
+        return probe;
+    }
+
+    if (!m_pendingProbes.contains(path)) {
+        m_pendingProbes.insert(path);
+        const QUrl url = item.url();
+        QtConcurrent::run(directoryProbePool(), probeDirectory, path).then(q, [this, path, url, mtime](DirectoryProbe probe) {
+            m_pendingProbes.remove(path);
+            probe.mtime = mtime;
+            s_directoryProbes()->insert(path, new DirectoryProbe(probe));
+            m_probedUrls.append(url);
+            if (!m_probeTimer.isActive()) {
+                m_probeTimer.start();
+            }
+        });
+    }
+    return nullptr;
+}
+
+void KDirModelPrivate::emitProbedDirectoriesChanged()
+{
+    // One dataChanged per row: QTreeView only looks at hasChildren() again for a single row
+    // starting at column 0. The timer already gathered the probes that ended close together.
+    for (const QUrl &url : std::as_const(m_probedUrls)) {
+        KDirModelNode *node = nodeForUrl(url); // O(depth)
+        if (!node || node == m_rootNode) {
+            continue; // gone in the meantime
+        }
+        const QModelIndex index = indexForNode(node); // O(1)
+        Q_EMIT q->dataChanged(index, index.siblingAtColumn(KDirModel::ColumnCount - 1)); // both ChildCountRole and hasChildren() changed
+    }
+    m_probedUrls.clear();
+}
+
 void KDirModel::clearAllPreviews()
 {
     d->clearAllPreviews(d->m_rootNode);
@@ -933,47 +1085,8 @@ QVariant KDirModel::data(const QModelIndex &index, int role) const
                 KDirModelDirNode *dirNode = static_cast<KDirModelDirNode *>(node);
                 int count = dirNode->childCount();
                 if (count == ChildCountUnknown && !dirNode->isOnNetwork() && item.isReadable()) {
-                    const QString path = item.localPath();
-                    if (!path.isEmpty()) {
-//                        slow
-//                        QDir dir(path);
-//                        count = dir.entryList(QDir::AllEntries|QDir::NoDotAndDotDot|QDir::System).count();
-#ifdef Q_OS_WIN
-                        QString s = path + QLatin1String("\\*.*");
-                        s.replace(QLatin1Char('/'), QLatin1Char('\\'));
-                        count = 0;
-                        WIN32_FIND_DATA findData;
-                        HANDLE hFile = FindFirstFile((LPWSTR)s.utf16(), &findData);
-                        if (hFile != INVALID_HANDLE_VALUE) {
-                            do {
-                                if (!(findData.cFileName[0] == '.' && findData.cFileName[1] == '\0')
-                                    && !(findData.cFileName[0] == '.' && findData.cFileName[1] == '.' && findData.cFileName[2] == '\0')) {
-                                    ++count;
-                                }
-                            } while (FindNextFile(hFile, &findData) != 0);
-                            FindClose(hFile);
-                        }
-#else
-                        DIR *dir = QT_OPENDIR(QFile::encodeName(path).constData());
-                        if (dir) {
-                            count = 0;
-                            QT_DIRENT *dirEntry = nullptr;
-                            while ((dirEntry = QT_READDIR(dir))) {
-                                if (dirEntry->d_name[0] == '.') {
-                                    if (dirEntry->d_name[1] == '\0') { // skip "."
-                                        continue;
-                                    }
-                                    if (dirEntry->d_name[1] == '.' && dirEntry->d_name[2] == '\0') { // skip ".."
-                                        continue;
-                                    }
-                                }
-                                ++count;
-                            }
-                            QT_CLOSEDIR(dir);
-                        }
-#endif
-                        // qDebug() << "child count for " << path << ":" << count;
-                        dirNode->setChildCount(count);
+                    if (const DirectoryProbe *probe = d->directoryProbe(dirNode)) {
+                        count = probe->count;
                     }
                 }
                 return count;
@@ -1072,7 +1185,7 @@ QModelIndex KDirModel::parent(const QModelIndex &index) const
     Q_ASSERT(childNode);
     KDirModelNode *parentNode = childNode->parent();
     Q_ASSERT(parentNode);
-    return d->indexForNode(parentNode); // O(n)
+    return d->indexForNode(parentNode); // O(1)
 }
 
 // Reimplemented to avoid the default implementation which calls parent
@@ -1200,10 +1313,10 @@ KFileItem KDirModel::itemForIndex(const QModelIndex &index) const
 
 QModelIndex KDirModel::indexForItem(const KFileItem &item) const
 {
-    return indexForUrl(item.url()); // O(n)
+    return indexForUrl(item.url()); // O(depth)
 }
 
-// url -> index. O(n)
+// url -> index. O(depth)
 QModelIndex KDirModel::indexForUrl(const QUrl &url) const
 {
     KDirModelNode *node = d->nodeForUrl(url); // O(depth)
@@ -1211,7 +1324,7 @@ QModelIndex KDirModel::indexForUrl(const QUrl &url) const
         // qDebug() << url << "not found";
         return QModelIndex();
     }
-    return d->indexForNode(node); // O(n)
+    return d->indexForNode(node); // O(1)
 }
 
 QModelIndex KDirModel::index(int row, int column, const QModelIndex &parent) const
@@ -1269,20 +1382,11 @@ bool KDirModel::hasChildren(const QModelIndex &parent) const
         return !static_cast<const KDirModelDirNode *>(parentNode)->m_childNodes.isEmpty();
     }
     if (parentItem.isLocalFile() && !static_cast<const KDirModelDirNode *>(parentNode)->isOnNetwork()) {
-        QDir::Filters filters = QDir::Dirs | QDir::NoDotAndDotDot;
-
-        if (d->m_dirLister->dirOnlyMode()) {
-            filters |= QDir::NoSymLinks;
-        } else {
-            filters |= QDir::Files | QDir::System;
+        if (const DirectoryProbe *probe = d->directoryProbe(static_cast<const KDirModelDirNode *>(parentNode))) {
+            return probe->hasChildren(d->m_dirLister->dirOnlyMode(), d->m_dirLister->showHiddenFiles());
         }
-
-        if (d->m_dirLister->showHiddenFiles()) {
-            filters |= QDir::Hidden;
-        }
-
-        QDirIterator it(parentItem.localPath(), filters, QDirIterator::Subdirectories);
-        return it.hasNext();
+        // Not probed yet, we'll know soon
+        return true;
     }
     // Remote and not listed yet, we can't know; let the user click on it so we'll find out
     return true;
@@ -1416,7 +1520,7 @@ void KDirModel::expandToUrl(const QUrl &url)
     qCDebug(category) << "Remembering to emit expand after listing" << result->item().url();
 
     // start a new fetch to look for the next level down the URL
-    const QModelIndex parentIndex = d->indexForNode(result); // O(n)
+    const QModelIndex parentIndex = d->indexForNode(result); // O(1)
     Q_ASSERT(parentIndex.isValid());
     fetchMore(parentIndex);
 }
@@ -159,6 +159,8 @@ public:
         // to define additional roles.
         FileItemRole = 0x07A263FF, ///< returns the KFileItem for a given index. roleName is "fileItem".
         ChildCountRole = 0x2C4D0A40, ///< returns the number of items in a directory, or ChildCountUnknown. roleName is "childCount".
+                                     ///< A local directory that isn't listed is counted in a thread: dataChanged is emitted
+                                     ///< once the count is known (since 6.10)
         HasJobRole = 0x01E555A5, ///< returns whether or not there is a job on an item (file/directory). roleName is "hasJob".
     };
 
@@ -194,6 +196,8 @@ public:
     /// Reimplemented from QAbstractItemModel.
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     /// Reimplemented from QAbstractItemModel. Returns true for directories.
+    /// A local directory that isn't listed is looked into in a thread, returning true until
+    /// it's done and dataChanged is emitted (since 6.10)
     bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
     /// Reimplemented from QAbstractItemModel. Returns the column titles.
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;